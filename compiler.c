@@ -3,9 +3,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "emit.h"
 #include "ir.h"
+#include "ir_interp.h"
+#include "ir_opt.h"
 #include "x86.h"
+#include "x86_elf.h"
+#include "x86_jit.h"
+#include "x86_peephole.h"
 #include "parser.h"
 #include "tokenizer.h"
 
@@ -69,14 +76,90 @@ int compile(Compiler *compiler) {
         print_ast(&compiler->nm);
 
     IR_Module *module = ir_gen_translation_unit(&compiler->nm.nodes[0]);
+    if (compiler->flags & COMP_FLAG_OPT) {
+        ir_optimize_module(module);
+    }
     if (compiler->flags & COMP_FLAG_IR) {
         print_ir_module(module);
     }
 
     if (compiler->flags & COMP_FLAG_ASM) {
-        FILE *fp = fopen(compiler->output_file, "w");
-        x86_gen_module(fp, module);
-        fclose(fp);
+        static Emitter e;
+        // Anything printed so far goes out before assembly streamed to stdout
+        fflush(stdout);
+        if (!emit_open(&e, compiler->output_file)) {
+            printf("Failed to open %s\n", compiler->output_file);
+            exit(1);
+        }
+        x86_gen_module(&e, module, compiler->flags & COMP_FLAG_OPT);
+        if (!emit_close(&e)) {
+            printf("Failed to write %s\n", compiler->output_file);
+            exit(1);
+        }
+        if (compiler->flags & COMP_FLAG_PEEPHOLE) {
+            x86_peephole_print_stats();
+        }
+    }
+
+    if (compiler->flags & COMP_FLAG_OBJ) {
+        static Emitter e;
+        X86_Object obj = x86_encode_module(module, compiler->flags & COMP_FLAG_OPT);
+        if (!emit_open(&e, compiler->output_file)) {
+            printf("Failed to open %s\n", compiler->output_file);
+            exit(1);
+        }
+        elf_write_object(&e, &obj);
+        if (!emit_close(&e)) {
+            printf("Failed to write %s\n", compiler->output_file);
+            exit(1);
+        }
+        x86_free_object(&obj);
+    }
+
+    if (compiler->flags & COMP_FLAG_EXE) {
+        static Emitter e;
+        X86_Object obj = x86_encode_module(module, compiler->flags & COMP_FLAG_OPT);
+        x86_encode_start(&obj);
+        if (!emit_open_mode(&e, compiler->output_file, 0755)) {
+            printf("Failed to open %s\n", compiler->output_file);
+            exit(1);
+        }
+        elf_write_executable(&e, &obj, X86_START);
+        if (!emit_close(&e)) {
+            printf("Failed to write %s\n", compiler->output_file);
+            exit(1);
+        }
+        x86_free_object(&obj);
+    }
+
+    if (compiler->flags & COMP_FLAG_RUN) {
+        X86_Object obj = x86_encode_module(module, compiler->flags & COMP_FLAG_OPT);
+        // The program's own output must follow the compiler's
+        fflush(stdout);
+        compiler->exit_code = x86_jit_run(&obj, "main");
+        x86_free_object(&obj);
+    }
+
+    if (compiler->flags & COMP_FLAG_INTERP) {
+        struct timespec start;
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        const IR_InterpResult result = ir_interp_module(module, "main");
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (compiler->flags & COMP_FLAG_INTERP_STATS) {
+            const double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+            printf("Interpreted %lld instructions in %.3f ms, %.1f million per second\n", result.executed,
+                   seconds * 1e3, seconds > 0 ? (double)result.executed / seconds / 1e6 : 0.0);
+        }
+        if (result.status == IR_INTERP_TRAP) {
+            printf("Division by zero in interpreted program\n");
+            exit(1);
+        }
+        if (result.status == IR_INTERP_DEPTH) {
+            printf("Call depth exceeded in interpreted program\n");
+            exit(1);
+        }
+        compiler->exit_code = result.value;
     }
     ir_free_module(module);
     return 1;
@@ -90,20 +173,29 @@ Compiler init_compiler(const int argc, char *argv[]) {
 
     if (argc == 2 && strcmp(argv[1], "-h") == 0) {
         printf("compiler [input]\n");
-        printf("\t-o [output] : Set output file path\n");
+        printf("\t-o [output] : Set output file path, - for stdout\n");
         printf("\t-d          : Compile in debug mode\n");
         printf("\t-t          : Print parse tree\n");
+        printf("\t-c          : Write an ELF object file instead of assembly\n");
+        printf("\t--exe       : Write a static executable, no assembler or linker needed\n");
+        printf("\t--run       : Run main in memory and exit with its result, nothing is written\n");
+        printf("\t--interp    : Interpret main from the IR and exit with its result\n");
+        printf("\t-is         : Print how many instructions --interp ran and how fast\n");
+        printf("\t-O1         : Optimize the IR before code generation\n");
+        printf("\t-ph         : Print how often each peephole rule applied\n");
         printf("\t-h          : Get help\n");
         exit(0);
     }
 
     Compiler compiler;
     compiler.flags = 0;
+    compiler.exit_code = 0;
     compiler.input_file = argv[1];
     compiler.output_file = strdup(argv[1]);
     compiler.output_file[strlen(argv[1]) - 1] = 's';
 
     // Loop and try find compile flags: [-o, -t, -d]
+    bool output_named = false;
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-o") == 0) {
             if (argv[i + 1] != NULL) {
@@ -113,6 +205,7 @@ Compiler init_compiler(const int argc, char *argv[]) {
                 }
                 free(compiler.output_file);
                 compiler.output_file = argv[++i];
+                output_named = true;
             } else {
                 printf("Improper Usage,\n  compiler [input] -o [output]\n");
                 exit(1);
@@ -129,8 +222,28 @@ Compiler init_compiler(const int argc, char *argv[]) {
             compiler.flags |= COMP_FLAG_IR;
         } else if (strcmp(argv[i], "-a") == 0) {
             compiler.flags |= COMP_FLAG_ASM;
+        } else if (strcmp(argv[i], "-O1") == 0) {
+            compiler.flags |= COMP_FLAG_OPT;
+        } else if (strcmp(argv[i], "-ph") == 0) {
+            compiler.flags |= COMP_FLAG_PEEPHOLE;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            compiler.flags |= COMP_FLAG_OBJ;
+        } else if (strcmp(argv[i], "--exe") == 0) {
+            compiler.flags |= COMP_FLAG_EXE;
+        } else if (strcmp(argv[i], "--run") == 0) {
+            compiler.flags |= COMP_FLAG_RUN;
+        } else if (strcmp(argv[i], "--interp") == 0) {
+            compiler.flags |= COMP_FLAG_INTERP;
+        } else if (strcmp(argv[i], "-is") == 0) {
+            compiler.flags |= COMP_FLAG_INTERP_STATS;
         }
     }
+    if ((compiler.flags & COMP_FLAG_OBJ) && !output_named) {
+        compiler.output_file[strlen(compiler.output_file) - 1] = 'o';
+    } else if ((compiler.flags & COMP_FLAG_EXE) && !output_named) {
+        // test.c becomes test
+        compiler.output_file[strlen(compiler.output_file) - 2] = '\0';
+    }
 
     load_src_file(&compiler);
 
@@ -138,6 +251,10 @@ Compiler init_compiler(const int argc, char *argv[]) {
     compiler.nm = new_node_manager();
     compiler.p = new_parser();
 
+    // Assembly streamed to stdout, or a program run in process, must not be mixed with status output
+    if (strcmp(compiler.output_file, "-") == 0 || (compiler.flags & (COMP_FLAG_RUN | COMP_FLAG_INTERP))) {
+        return compiler;
+    }
     printf("Compiling %s to %s ", compiler.input_file, compiler.output_file);
     if (compiler.flags != 0) {
         printf("with flags: ");
@@ -159,6 +276,18 @@ Compiler init_compiler(const int argc, char *argv[]) {
         if (compiler.flags & COMP_FLAG_ASM) {
             printf("-a ");
         }
+        if (compiler.flags & COMP_FLAG_OPT) {
+            printf("-O1 ");
+        }
+        if (compiler.flags & COMP_FLAG_PEEPHOLE) {
+            printf("-ph ");
+        }
+        if (compiler.flags & COMP_FLAG_OBJ) {
+            printf("-c ");
+        }
+        if (compiler.flags & COMP_FLAG_EXE) {
+            printf("--exe ");
+        }
     }
     printf("\n");
 
@@ -8,6 +8,7 @@ typedef struct {
     char *input_file;
     char *output_file;
     unsigned int flags;
+    int exit_code; // Result of main with --run
     char *src;
     int src_size;
     Tokenizer tk;
@@ -21,6 +22,13 @@ typedef struct {
 #define COMP_FLAG_NODES (1u << 3)  // -n
 #define COMP_FLAG_IR (1u << 4)     // -ir
 #define COMP_FLAG_ASM (1u << 5)    // -a
+#define COMP_FLAG_OPT (1u << 6)    // -O1
+#define COMP_FLAG_PEEPHOLE (1u << 7) // -ph
+#define COMP_FLAG_OBJ (1u << 8)      // -c
+#define COMP_FLAG_EXE (1u << 9)      // --exe
+#define COMP_FLAG_RUN (1u << 10)     // --run
+#define COMP_FLAG_INTERP (1u << 11)  // --interp
+#define COMP_FLAG_INTERP_STATS (1u << 12) // -is
 
 int compile(Compiler *compiler);
 Compiler init_compiler(int argc, char *argv[]);
@@ -0,0 +1,91 @@
+#include "emit.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+bool emit_open(Emitter *e, const char *path) { return emit_open_mode(e, path, 0644); }
+
+bool emit_open_mode(Emitter *e, const char *path, const int mode) {
+    if (strcmp(path, "-") == 0) {
+        emit_open_fd(e, STDOUT_FILENO);
+        return true;
+    }
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, mode);
+    if (fd < 0) {
+        return false;
+    }
+    emit_open_fd(e, fd);
+    e->close_fd = true;
+    return true;
+}
+
+void emit_open_fd(Emitter *e, const int fd) {
+    e->fd = fd;
+    e->close_fd = false;
+    e->failed = false;
+    e->size = 0;
+}
+
+void emit_flush(Emitter *e) {
+    int written = 0;
+    while (written < e->size && !e->failed) {
+        const ssize_t n = write(e->fd, e->buffer + written, e->size - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            e->failed = true;
+            break;
+        }
+        written += (int)n;
+    }
+    e->size = 0;
+}
+
+bool emit_close(Emitter *e) {
+    emit_flush(e);
+    if (e->close_fd && close(e->fd) != 0) {
+        e->failed = true;
+    }
+    return !e->failed;
+}
+
+void emit_bytes(Emitter *e, const char *bytes, int length) {
+    while (length > 0) {
+        if (e->size == EMIT_BUFFER_SIZE) {
+            emit_flush(e);
+        }
+        const int space = EMIT_BUFFER_SIZE - e->size;
+        const int n = length < space ? length : space;
+        memcpy(e->buffer + e->size, bytes, n);
+        e->size += n;
+        bytes += n;
+        length -= n;
+    }
+}
+
+void emit_str(Emitter *e, const char *str) { emit_bytes(e, str, (int)strlen(str)); }
+
+void emit_char(Emitter *e, const char c) {
+    if (e->size == EMIT_BUFFER_SIZE) {
+        emit_flush(e);
+    }
+    e->buffer[e->size++] = c;
+}
+
+void emit_int(Emitter *e, const int value) {
+    // Digits are written backwards from the end, working on the magnitude as unsigned so INT_MIN negates
+    char digits[12];
+    int start = sizeof(digits);
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    do {
+        digits[--start] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) {
+        digits[--start] = '-';
+    }
+    emit_bytes(e, digits + start, (int)sizeof(digits) - start);
+}
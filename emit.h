@@ -0,0 +1,44 @@
+#ifndef COMPILER_C_EMIT_H
+#define COMPILER_C_EMIT_H
+
+#include <stdbool.h>
+
+/*
+    Buffered output for generated assembly.
+
+    Text is appended to a fixed buffer inside the Emitter and written out with one write() each time it fills,
+    So emitting never allocates, formats through stdio or takes the stdio lock.
+    Output path "-" streams to stdout.
+*/
+
+#define EMIT_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+    int fd;
+    bool close_fd; // False for stdout
+    bool failed;   // A write failed, later output is dropped
+    int size;
+    char buffer[EMIT_BUFFER_SIZE];
+} Emitter;
+
+/*
+    Opens `path` for writing, returns false if it could not be created.
+*/
+bool emit_open(Emitter *e, const char *path);
+/*
+    Like emit_open(), creating the file with permission bits `mode`, 0755 for executables.
+*/
+bool emit_open_mode(Emitter *e, const char *path, int mode);
+void emit_open_fd(Emitter *e, int fd);
+/*
+    Flushes and closes, returns false if any write failed.
+*/
+bool emit_close(Emitter *e);
+void emit_flush(Emitter *e);
+
+void emit_bytes(Emitter *e, const char *bytes, int length);
+void emit_str(Emitter *e, const char *str);
+void emit_char(Emitter *e, char c);
+void emit_int(Emitter *e, int value);
+
+#endif // COMPILER_C_EMIT_H
@@ -16,6 +16,20 @@ IR_OP token_to_ir_op(const TokenType type) {
         return IR_MUL;
     case TK_DIVIDE:
         return IR_DIV;
+    case TK_EXP:
+        return IR_POW;
+    case TK_EQ_EQ:
+        return IR_CMP_EQ;
+    case TK_NOT_EQ:
+        return IR_CMP_NE;
+    case TK_LT:
+        return IR_CMP_LT;
+    case TK_LT_EQ:
+        return IR_CMP_LE;
+    case TK_GT:
+        return IR_CMP_GT;
+    case TK_GT_EQ:
+        return IR_CMP_GE;
     default:
         printf("Given an unsupported token to convert to IR_Op: ");
         print_token_type(type);
@@ -24,6 +38,28 @@ IR_OP token_to_ir_op(const TokenType type) {
     }
 }
 
+int ir_pow(const int base, int exponent) {
+    if (exponent < 0) {
+        if (base == 1) {
+            return 1;
+        }
+        if (base == -1) {
+            return exponent & 1 ? -1 : 1;
+        }
+        return 0;
+    }
+    unsigned result = 1;
+    unsigned square = (unsigned)base;
+    while (exponent != 0) {
+        if (exponent & 1) {
+            result *= square;
+        }
+        square *= square;
+        exponent >>= 1;
+    }
+    return (int)result;
+}
+
 /*
     Begin an IR Scope,
     Tracks any variables added afterwards, and pops them from the IR virtual stack when `ir_end_scope()` is called.
@@ -104,8 +140,12 @@ IR_Function *ir_new_function(const char *name) {
     func->block_capacity = 4;
     func->block_count = 0;
     func->blocks = malloc(sizeof(IR_Block) * func->block_capacity);
-    if (!func->blocks) {
+    func->placement = malloc(sizeof(int) * func->block_capacity);
+    if (!func->blocks || !func->placement) {
         printf("Failed to allocate IR_Blocks\n");
+        free(func->blocks);
+        free(func->placement);
+        free(func->callees);
         free(func);
         exit(1);
     }
@@ -130,7 +170,13 @@ IR_Function *ir_new_function(const char *name) {
         free(func);
         exit(1);
     }
-    ir_append_block(func, ir_new_block());
+    func->param_count = 0;
+    func->callees = NULL;
+    func->callee_count = 0;
+    func->callee_capacity = 0;
+    func->current = ir_append_block(func, ir_new_block());
+    func->placement[0] = func->current;
+    func->placed_count = 1;
 
     return func;
 }
@@ -143,12 +189,79 @@ int ir_append_block(IR_Function *func, IR_Block *block) {
             printf("Failed to reallocate for new Ir block");
             exit(1);
         }
+        if (func->placement != NULL) {
+            func->placement = realloc(func->placement, sizeof(int) * func->block_capacity);
+            if (func->placement == NULL) {
+                printf("Failed to reallocate for block placement");
+                exit(1);
+            }
+        }
     }
     func->blocks[func->block_count++] = *block;
     free(block);
     return func->block_count - 1;
 }
 
+/*
+    Reserves an empty block to be used as a branch target before its code exists,
+    Instructions only go into it once `ir_place_block()` makes it the current block.
+*/
+int ir_new_label(IR_Function *func) { return ir_append_block(func, ir_new_block()); }
+
+/*
+    Makes `block` the current block and lays it out after the previously placed one,
+    So a current block without a terminator falls through into it.
+*/
+void ir_place_block(IR_Function *func, const int block) {
+    func->placement[func->placed_count++] = block;
+    func->current = block;
+}
+
+/*
+    Reorders the blocks into the order they were placed in and renumbers branch targets to match.
+*/
+void ir_layout_blocks(IR_Function *func) {
+    int *new_id = malloc(sizeof(int) * func->block_count);
+    IR_Block *blocks = malloc(sizeof(IR_Block) * func->block_capacity);
+    if (new_id == NULL || blocks == NULL) {
+        printf("Failed to allocate for block layout\n");
+        exit(1);
+    }
+    for (int b = 0; b < func->block_count; b++) {
+        new_id[b] = -1;
+    }
+    int count = 0;
+    for (int i = 0; i < func->placed_count; i++) {
+        new_id[func->placement[i]] = count;
+        blocks[count++] = func->blocks[func->placement[i]];
+    }
+    // Labels that were never placed keep their relative order at the end
+    for (int b = 0; b < func->block_count; b++) {
+        if (new_id[b] == -1) {
+            new_id[b] = count;
+            blocks[count++] = func->blocks[b];
+        }
+    }
+    for (int b = 0; b < count; b++) {
+        for (int i = 0; i < blocks[b].count; i++) {
+            IR_Instruction *instr = &blocks[b].instructions[i];
+            if (instr->op == IR_BR) {
+                instr->dst = new_id[instr->dst];
+            } else if (instr->op == IR_BR_EQ) {
+                instr->a = new_id[instr->a];
+                instr->b = new_id[instr->b];
+            }
+        }
+    }
+    free(func->blocks);
+    func->blocks = blocks;
+    func->current = new_id[func->current];
+    free(func->placement);
+    func->placement = NULL;
+    func->placed_count = 0;
+    free(new_id);
+}
+
 void ir_append_instruction(IR_Block *block, IR_Instruction *instruction) {
     if (block->count >= block->capacity) {
         block->capacity *= 2;
@@ -161,6 +274,150 @@ void ir_append_instruction(IR_Block *block, IR_Instruction *instruction) {
     block->instructions[block->count++] = *instruction;
 }
 
+void ir_insert_instruction(IR_Block *block, const int index, const IR_Instruction *instruction) {
+    ir_append_instruction(block, (IR_Instruction *)instruction);
+    memmove(&block->instructions[index + 1], &block->instructions[index],
+            sizeof(IR_Instruction) * (block->count - 1 - index));
+    block->instructions[index] = *instruction;
+}
+
+void ir_remove_instruction(IR_Block *block, const int index) {
+    memmove(&block->instructions[index], &block->instructions[index + 1],
+            sizeof(IR_Instruction) * (block->count - 1 - index));
+    block->count--;
+}
+
+int ir_instruction_def(const IR_Instruction *instr) {
+    switch (instr->op) {
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_DIV:
+    case IR_SHL:
+    case IR_SAR:
+    case IR_SHR:
+    case IR_LEA:
+    case IR_MULH:
+    case IR_POW:
+    case IR_CMP_EQ:
+    case IR_CMP_NE:
+    case IR_CMP_LT:
+    case IR_CMP_LE:
+    case IR_CMP_GT:
+    case IR_CMP_GE:
+    case IR_LOAD:
+    case IR_STORE:
+    case IR_SELECT:
+    case IR_PARAM:
+    case IR_CALL:
+        return instr->dst;
+    default:
+        return -1;
+    }
+}
+
+int ir_instruction_uses(const IR_Instruction *instr, int uses[IR_MAX_USES]) {
+    switch (instr->op) {
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_DIV:
+    case IR_MULH:
+    case IR_POW:
+    case IR_CMP_EQ:
+    case IR_CMP_NE:
+    case IR_CMP_LT:
+    case IR_CMP_LE:
+    case IR_CMP_GT:
+    case IR_CMP_GE:
+        uses[0] = instr->a;
+        uses[1] = instr->b;
+        return 2;
+    case IR_SHL:
+    case IR_SAR:
+    case IR_SHR:
+    case IR_LEA:
+    case IR_STORE:
+    case IR_ARG:
+        uses[0] = instr->a;
+        return 1;
+    case IR_SELECT:
+        uses[0] = instr->a;
+        uses[1] = instr->b;
+        uses[2] = instr->dst;
+        return 3;
+    case IR_RET:
+    case IR_BR_EQ:
+        uses[0] = instr->dst;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+bool ir_is_terminator(const IR_OP op) {
+    return op == IR_RET || op == IR_BR || op == IR_BR_EQ || op == IR_TAIL_CALL;
+}
+
+bool ir_is_compare(const IR_OP op) { return op >= IR_CMP_EQ && op <= IR_CMP_GE; }
+
+IR_OP ir_compare_negate(const IR_OP op) {
+    switch (op) {
+    case IR_CMP_EQ:
+        return IR_CMP_NE;
+    case IR_CMP_NE:
+        return IR_CMP_EQ;
+    case IR_CMP_LT:
+        return IR_CMP_GE;
+    case IR_CMP_LE:
+        return IR_CMP_GT;
+    case IR_CMP_GT:
+        return IR_CMP_LE;
+    case IR_CMP_GE:
+        return IR_CMP_LT;
+    default:
+        printf("Tried to negate a non comparison IR op\n");
+        exit(1);
+    }
+}
+
+IR_OP ir_compare_swap(const IR_OP op) {
+    switch (op) {
+    case IR_CMP_EQ:
+    case IR_CMP_NE:
+        return op;
+    case IR_CMP_LT:
+        return IR_CMP_GT;
+    case IR_CMP_LE:
+        return IR_CMP_GE;
+    case IR_CMP_GT:
+        return IR_CMP_LT;
+    case IR_CMP_GE:
+        return IR_CMP_LE;
+    default:
+        printf("Tried to swap a non comparison IR op\n");
+        exit(1);
+    }
+}
+
+bool ir_reg_const_at(const IR_Block *block, const int index, const int reg, int *value) {
+    for (int i = index - 1; i >= 0; i--) {
+        const IR_Instruction *instr = &block->instructions[i];
+        if (ir_instruction_def(instr) != reg) {
+            continue;
+        }
+        if (instr->op == IR_STORE) {
+            return ir_reg_const_at(block, i, instr->a, value);
+        }
+        if (instr->op != IR_LOAD) {
+            return false;
+        }
+        *value = instr->a;
+        return true;
+    }
+    return false;
+}
+
 int ir_new_var(IR_Function *func, const char *name) {
     if (func->local_count >= func->local_capacity) {
         func->local_capacity *= 2;
@@ -195,6 +452,24 @@ int ir_get_var_reg(IR_Function *func, const char *name) {
     return -1;
 }
 
+int ir_add_callee(IR_Function *func, const char *name) {
+    for (int i = 0; i < func->callee_count; i++) {
+        if (strcmp(func->callees[i], name) == 0) {
+            return i;
+        }
+    }
+    if (func->callee_count >= func->callee_capacity) {
+        func->callee_capacity = func->callee_capacity == 0 ? 4 : func->callee_capacity * 2;
+        func->callees = realloc(func->callees, sizeof(const char *) * func->callee_capacity);
+        if (func->callees == NULL) {
+            printf("Failed to allocate for new callee");
+            exit(1);
+        }
+    }
+    func->callees[func->callee_count] = name;
+    return func->callee_count++;
+}
+
 void ir_append_function(IR_Module *module, IR_Function *func) {
     if (module->count >= module->capacity) {
         module->capacity *= 2;
@@ -216,21 +491,144 @@ void ir_free_module(IR_Module *module) {
         free(func->locals);
         free(func->scopes);
         free(func->blocks);
+        free(func->placement);
         free(func);
     }
     free(module->functions);
     free(module);
 }
 
-IR_Block *current_block(const IR_Function *func) { return &func->blocks[func->block_count - 1]; }
+IR_Block *current_block(const IR_Function *func) { return &func->blocks[func->current]; }
 
-int ir_gen_expression(IR_Function *func, Node *expr) {
+/*
+    `&&` and `||` used as values, the result is written on both paths so it gets a register of its own like a variable.
+*/
+static int ir_gen_logical_value(IR_Function *func, Node *expr) {
+    const int dst = func->next_reg++;
+    const int true_id = ir_new_label(func);
+    const int false_id = ir_new_label(func);
+    const int end_id = ir_new_label(func);
+    ir_gen_condition(func, expr, true_id, false_id);
+
+    ir_place_block(func, true_id);
+    const int one = func->next_reg++;
+    ir_append_instruction(current_block(func), &(IR_Instruction){IR_LOAD, one, 1, 0});
+    ir_append_instruction(current_block(func), &(IR_Instruction){IR_STORE, dst, one, 0});
+    ir_append_instruction(current_block(func), &(IR_Instruction){IR_BR, end_id, 0, 0});
+
+    ir_place_block(func, false_id);
+    const int zero = func->next_reg++;
+    ir_append_instruction(current_block(func), &(IR_Instruction){IR_LOAD, zero, 0, 0});
+    ir_append_instruction(current_block(func), &(IR_Instruction){IR_STORE, dst, zero, 0});
+
+    ir_place_block(func, end_id);
+    return dst;
+}
+
+
+/*
+    Temporaries whose value has been consumed, handed out again before new registers are made.
+    A pool only lives for one expression tree so recycled temporaries never stay live across statements.
+*/
+typedef struct {
+    int *regs;
+    int count;
+    int capacity;
+} IR_TempPool;
+
+static int ir_take_temp(IR_Function *func, IR_TempPool *pool) {
+    if (pool->count > 0) {
+        return pool->regs[--pool->count];
+    }
+    return func->next_reg++;
+}
+
+static void ir_release_temp(IR_TempPool *pool, const int reg) {
+    if (pool->count >= pool->capacity) {
+        pool->capacity = pool->capacity == 0 ? 8 : pool->capacity * 2;
+        pool->regs = realloc(pool->regs, sizeof(int) * pool->capacity);
+        if (pool->regs == NULL) {
+            printf("Failed to allocate temporary pool\n");
+            exit(1);
+        }
+    }
+    pool->regs[pool->count++] = reg;
+}
+
+/*
+    Variables and the results of `&&` and `||` are written in more than one place, everything else is a temporary.
+*/
+static bool ir_is_temp_node(const Node *expr) {
+    if (expr->type == N_IDENTIFIER) {
+        return false;
+    }
+    return !(expr->type == N_BINARY && (expr->binary.op == TK_AND_AND || expr->binary.op == TK_OR_OR));
+}
+
+/*
+    Ershov number, how many temporaries evaluating the tree needs at once.
+    Variables already have a register, so reading one needs none.
+*/
+static int ir_ershov(const Node *expr) {
+    switch (expr->type) {
+    case N_IDENTIFIER:
+        return 0;
+    case N_UNARY: {
+        const int n = ir_ershov(expr->unary.expr);
+        return n > 1 ? n : 1;
+    }
+    case N_BINARY: {
+        const int lhs = ir_ershov(expr->binary.lhs);
+        const int rhs = ir_ershov(expr->binary.rhs);
+        if (lhs == rhs) {
+            return lhs + 1;
+        }
+        return lhs > rhs ? lhs : rhs;
+    }
+    default:
+        return 1;
+    }
+}
+
+static int ir_gen_tree(IR_Function *func, Node *expr, IR_TempPool *pool, bool root);
+
+/*
+    Arguments are all evaluated before the first IR_ARG, so a call nested in an argument never ends up between them.
+*/
+static int ir_gen_call(IR_Function *func, Node *call, IR_TempPool *pool, const bool root) {
+    int *args = malloc(sizeof(int) * (call->call.arg_count + 1));
+    if (args == NULL) {
+        printf("Failed to allocate call arguments\n");
+        exit(1);
+    }
+    for (int i = 0; i < call->call.arg_count; i++) {
+        args[i] = ir_gen_tree(func, call->call.args[i], pool, false);
+    }
+    for (int i = 0; i < call->call.arg_count; i++) {
+        ir_append_instruction(current_block(func), &(IR_Instruction){IR_ARG, 0, args[i], i});
+    }
+    for (int i = 0; i < call->call.arg_count; i++) {
+        if (ir_is_temp_node(call->call.args[i])) {
+            ir_release_temp(pool, args[i]);
+        }
+    }
+    free(args);
+    const int callee = ir_add_callee(func, call->call.name);
+    const int dst = root ? func->next_reg++ : ir_take_temp(func, pool);
+    ir_append_instruction(current_block(func), &(IR_Instruction){IR_CALL, dst, callee, call->call.arg_count});
+    return dst;
+}
+
+/*
+    `root` results get a register of their own, so a comparison feeding a branch is read exactly once.
+*/
+static int ir_gen_tree(IR_Function *func, Node *expr, IR_TempPool *pool, const bool root) {
     switch (expr->type) {
     case N_LITERAL:
         switch (expr->literal.type) {
         case TK_INT_LITERAL:
-            const int dst = func->next_reg++;
-            ir_append_instruction(&func->blocks[func->block_count - 1], &(IR_Instruction){IR_LOAD, dst, expr->literal.i, 0});
+            const int dst = root ? func->next_reg++ : ir_take_temp(func, pool);
+            ir_append_instruction(current_block(func), &(IR_Instruction){IR_LOAD, dst, expr->literal.i, 0});
             return dst;
         case TK_FLT_LITERAL:
             printf("Cannot handle floats yet soz");
@@ -246,13 +644,46 @@ int ir_gen_expression(IR_Function *func, Node *expr) {
             exit(1);
         }
         return var_reg;
+    case N_UNARY: {
+        // `!x` as a value is `x == 0`
+        const int a = ir_gen_tree(func, expr->unary.expr, pool, false);
+        const int zero = ir_take_temp(func, pool);
+        ir_append_instruction(current_block(func), &(IR_Instruction){IR_LOAD, zero, 0, 0});
+        if (ir_is_temp_node(expr->unary.expr)) {
+            ir_release_temp(pool, a);
+        }
+        ir_release_temp(pool, zero);
+        const int dst = root ? func->next_reg++ : ir_take_temp(func, pool);
+        ir_append_instruction(current_block(func), &(IR_Instruction){IR_CMP_EQ, dst, a, zero});
+        return dst;
+    }
     case N_BINARY:
-        const int a = ir_gen_expression(func, expr->binary.lhs);
-        const int b = ir_gen_expression(func, expr->binary.rhs);
-        const int dst = func->next_reg++;
+        if (expr->binary.op == TK_AND_AND || expr->binary.op == TK_OR_OR) {
+            return ir_gen_logical_value(func, expr);
+        }
+        // The operand needing more temporaries goes first, so the other one's temporaries can reuse its leftovers.
+        // Only the evaluation order changes, `a` and `b` keep their places for `-`, `/` and the ordered compares
+        int a;
+        int b;
+        if (ir_ershov(expr->binary.rhs) > ir_ershov(expr->binary.lhs)) {
+            b = ir_gen_tree(func, expr->binary.rhs, pool, false);
+            a = ir_gen_tree(func, expr->binary.lhs, pool, false);
+        } else {
+            a = ir_gen_tree(func, expr->binary.lhs, pool, false);
+            b = ir_gen_tree(func, expr->binary.rhs, pool, false);
+        }
+        if (ir_is_temp_node(expr->binary.lhs)) {
+            ir_release_temp(pool, a);
+        }
+        if (ir_is_temp_node(expr->binary.rhs)) {
+            ir_release_temp(pool, b);
+        }
+        const int dst = root ? func->next_reg++ : ir_take_temp(func, pool);
         IR_OP op = token_to_ir_op(expr->binary.op);
         ir_append_instruction(current_block(func), &(IR_Instruction){op, dst, a, b});
         return dst;
+    case N_CALL:
+        return ir_gen_call(func, expr, pool, root);
     default:
         break;
     }
@@ -260,6 +691,13 @@ int ir_gen_expression(IR_Function *func, Node *expr) {
     exit(1);
 }
 
+int ir_gen_expression(IR_Function *func, Node *expr) {
+    IR_TempPool pool = {NULL, 0, 0};
+    const int dst = ir_gen_tree(func, expr, &pool, true);
+    free(pool.regs);
+    return dst;
+}
+
 void ir_gen_compound(IR_Function *func, const Node *comp) {
     ir_begin_scope(func);
     for (int i = 0; i < comp->compound.count; i++) {
@@ -268,51 +706,70 @@ void ir_gen_compound(IR_Function *func, const Node *comp) {
     ir_end_scope(func);
 }
 
-void ir_gen_while_statement(IR_Function *func, Node *_while) {
-    const int cond_id = ir_append_block(func, ir_new_block()); // cond:
-    const int cond_reg = ir_gen_expression(func, _while->_while.cond);
-    const int block_id = cond_id + 1;
-    const int end_id = cond_id + 2;
-    IR_Instruction br_eq_instr = {IR_BR_EQ, cond_reg, block_id, end_id};
+void ir_gen_condition(IR_Function *func, Node *expr, const int true_block, const int false_block) {
+    if (expr->type == N_UNARY && expr->unary.op == TK_NOT) {
+        ir_gen_condition(func, expr->unary.expr, false_block, true_block);
+        return;
+    }
+    if (expr->type == N_BINARY && (expr->binary.op == TK_AND_AND || expr->binary.op == TK_OR_OR)) {
+        // The right hand side is only reached when the left hand side did not decide the result
+        const int rhs_id = ir_new_label(func);
+        if (expr->binary.op == TK_AND_AND) {
+            ir_gen_condition(func, expr->binary.lhs, rhs_id, false_block);
+        } else {
+            ir_gen_condition(func, expr->binary.lhs, true_block, rhs_id);
+        }
+        ir_place_block(func, rhs_id);
+        ir_gen_condition(func, expr->binary.rhs, true_block, false_block);
+        return;
+    }
+    const int cond_reg = ir_gen_expression(func, expr);
+    IR_Instruction br_eq_instr = {IR_BR_EQ, cond_reg, true_block, false_block};
     ir_append_instruction(current_block(func), &br_eq_instr);
-    ir_append_block(func, ir_new_block()); // block:
+}
+
+void ir_gen_while_statement(IR_Function *func, Node *_while) {
+    const int cond_id = ir_new_label(func);
+    const int body_id = ir_new_label(func);
+    const int end_id = ir_new_label(func);
+    ir_place_block(func, cond_id); // cond:
+    ir_gen_condition(func, _while->_while.cond, body_id, end_id);
+    ir_place_block(func, body_id); // block:
     ir_gen_compound(func, _while->_while.block);
     IR_Instruction br_instr = {IR_BR, cond_id, 0, 0};
     ir_append_instruction(current_block(func), &br_instr);
-    ir_append_block(func, ir_new_block()); // end:
+    ir_place_block(func, end_id); // end:
 }
 
-void ir_gen_if_statement(IR_Function *func, const Node *_if) {
-    const int cond_reg = ir_gen_expression(func, _if->_if.cond);
-    const int if_true_id = func->block_count;
-    const int if_false_id = if_true_id + 1; // if no else, then this is the end block
-    IR_Instruction br_eq_instr = {IR_BR_EQ, cond_reg, if_true_id, if_false_id};
-    ir_append_instruction(current_block(func), &br_eq_instr);
-    ir_append_block(func, ir_new_block()); // IF true block
+/*
+    Generates an if and its else-if chain, every arm finishes on the shared `end_id`.
+*/
+static void ir_gen_if_arm(IR_Function *func, const Node *_if, const int end_id) {
+    const int if_true_id = ir_new_label(func);
+    // No else, means the false block is the end
+    const int if_false_id = _if->_if.if_false == NULL ? end_id : ir_new_label(func);
+    ir_gen_condition(func, _if->_if.cond, if_true_id, if_false_id);
+    ir_place_block(func, if_true_id); // IF true block
     ir_gen_compound(func, _if->_if.if_true);
-    if (_if->_if.if_false == NULL) { // No else, means branch to the end after compound
-        IR_Instruction br_instr = {IR_BR, if_false_id, 0, 0};
-        ir_append_instruction(current_block(func), &br_instr);
-        ir_append_block(func, ir_new_block()); // IF else or endblock
+    IR_Instruction br_instr = {IR_BR, end_id, 0, 0};
+    ir_append_instruction(current_block(func), &br_instr);
+    if (_if->_if.if_false == NULL) {
+        return;
+    }
+    ir_place_block(func, if_false_id); // IF else
+    if (_if->_if.if_false->type == N_IF) {
+        ir_gen_if_arm(func, _if->_if.if_false, end_id);
     } else {
-        if (_if->_if.if_false->type == N_IF) {
-            IR_Instruction br_instr = {IR_BR, if_false_id, 0, 0};
-            ir_append_instruction(current_block(func), &br_instr);
-            ir_append_block(func, ir_new_block()); // IF else or endblock
-            ir_gen_if_statement(func, _if->_if.if_false);
-        } else {
-            const int end_id = if_false_id + 1;
-            IR_Instruction br_instr = {IR_BR, end_id, 0, 0};
-            ir_append_instruction(current_block(func), &br_instr);
-            ir_append_block(func, ir_new_block()); // IF else or endblock
-            ir_gen_compound(func, _if->_if.if_false);
-            IR_Instruction br_end_instr = {IR_BR, end_id, 0, 0};
-            ir_append_instruction(current_block(func), &br_end_instr);
-            ir_append_block(func, ir_new_block()); // end
-        }
+        ir_gen_compound(func, _if->_if.if_false); // Falls through to the end
     }
 }
 
+void ir_gen_if_statement(IR_Function *func, const Node *_if) {
+    const int end_id = ir_new_label(func);
+    ir_gen_if_arm(func, _if, end_id);
+    ir_place_block(func, end_id); // end
+}
+
 void ir_gen_statement(IR_Function *func, Node *stmt) {
     switch (stmt->type) {
     case N_VAR_DECL: {
@@ -352,6 +809,10 @@ void ir_gen_statement(IR_Function *func, Node *stmt) {
     case N_WHILE:
         ir_gen_while_statement(func, stmt);
         return;
+    case N_CALL:
+        // The result is never read
+        ir_gen_expression(func, stmt);
+        return;
     default:
         // given invalid statement? probably an expression
         printf("Dont know what to do with the given statemnet: ir_gen_statement\n");
@@ -366,6 +827,18 @@ IR_Function *ir_gen_function(const Node *func) {
     }
 
     IR_Function *fn = ir_new_function(func->function.name);
+    // Parameters are variables of a scope around the body
+    ir_begin_scope(fn);
+    for (int i = 0; i < func->function.param_count; i++) {
+        const Node *param = func->function.params[i];
+        if (param->var_decl.type == TK_FLOAT) {
+            printf("Soz cant handle floats yet, only integers\n");
+            exit(1);
+        }
+        const int param_reg = ir_new_var(fn, param->var_decl.name);
+        ir_append_instruction(current_block(fn), &(IR_Instruction){IR_PARAM, param_reg, i, 0});
+    }
+    fn->param_count = func->function.param_count;
     switch (func->function.body->type) {
     case N_COMPOUND:
         ir_gen_compound(fn, func->function.body);
@@ -374,6 +847,8 @@ IR_Function *ir_gen_function(const Node *func) {
         printf("Function body is not a compound, gg\n");
         exit(1);
     }
+    ir_end_scope(fn);
+    ir_layout_blocks(fn);
 
     return fn;
 }
@@ -406,12 +881,51 @@ void print_ir_op(const IR_OP op) {
     case IR_DIV:
         printf("DIV   ");
         return;
+    case IR_SHL:
+        printf("SHL   ");
+        return;
+    case IR_SAR:
+        printf("SAR   ");
+        return;
+    case IR_SHR:
+        printf("SHR   ");
+        return;
+    case IR_LEA:
+        printf("LEA   ");
+        return;
+    case IR_MULH:
+        printf("MULH  ");
+        return;
+    case IR_POW:
+        printf("POW   ");
+        return;
+    case IR_CMP_EQ:
+        printf("CMPEQ ");
+        return;
+    case IR_CMP_NE:
+        printf("CMPNE ");
+        return;
+    case IR_CMP_LT:
+        printf("CMPLT ");
+        return;
+    case IR_CMP_LE:
+        printf("CMPLE ");
+        return;
+    case IR_CMP_GT:
+        printf("CMPGT ");
+        return;
+    case IR_CMP_GE:
+        printf("CMPGE ");
+        return;
     case IR_LOAD:
         printf("LOAD  ");
         return;
     case IR_STORE:
         printf("STORE ");
         return;
+    case IR_SELECT:
+        printf("SELECT");
+        return;
     case IR_RET:
         printf("RET   ");
         return;
@@ -421,6 +935,18 @@ void print_ir_op(const IR_OP op) {
     case IR_BR_EQ:
         printf("BREQ  ");
         return;
+    case IR_PARAM:
+        printf("PARAM ");
+        return;
+    case IR_ARG:
+        printf("ARG   ");
+        return;
+    case IR_CALL:
+        printf("CALL  ");
+        return;
+    case IR_TAIL_CALL:
+        printf("TCALL ");
+        return;
     default:
         printf("!!!   ");
     }
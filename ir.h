@@ -1,9 +1,50 @@
 #ifndef COMPILER_C_IR_H
 #define COMPILER_C_IR_H
 
+#include <stdbool.h>
+
 #include "node.h"
 
-typedef enum { IR_ADD, IR_SUB, IR_MUL, IR_DIV, IR_LOAD, IR_STORE, IR_RET, IR_BR, IR_BR_EQ } IR_OP;
+/*
+    IR_SHL, IR_SAR and IR_SHR shift `a` by the constant count in `b`.
+    IR_LEA computes `a + (a << b)` for a constant `b` of 1 to 3.
+    IR_MULH keeps the high 32 bits of the signed 64 bit product of `a` and `b`.
+    IR_POW raises `a` to the power `b`, see `ir_pow()`.
+    IR_CMP_* set `dst` to 1 if the signed comparison `a op b` holds and 0 otherwise.
+    IR_SELECT copies `b` into `dst` if `a` is non-zero and leaves `dst` as it was otherwise, so it also reads `dst`.
+    IR_PARAM copies parameter number `a` into `dst`, they come first in the entry block.
+    IR_ARG passes `a` as argument number `b`, one for each argument directly before their IR_CALL.
+    IR_CALL calls entry `a` of the function's callee table with `b` arguments and writes the result to `dst`.
+    IR_TAIL_CALL calls like IR_CALL and returns what the callee returns, the caller's frame is gone by then.
+*/
+typedef enum {
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_SHL,
+    IR_SAR,
+    IR_SHR,
+    IR_LEA,
+    IR_MULH,
+    IR_POW,
+    IR_CMP_EQ,
+    IR_CMP_NE,
+    IR_CMP_LT,
+    IR_CMP_LE,
+    IR_CMP_GT,
+    IR_CMP_GE,
+    IR_LOAD,
+    IR_STORE,
+    IR_SELECT,
+    IR_RET,
+    IR_BR,
+    IR_BR_EQ,
+    IR_PARAM,
+    IR_ARG,
+    IR_CALL,
+    IR_TAIL_CALL
+} IR_OP;
 
 typedef struct {
     const char *name;
@@ -32,6 +73,9 @@ typedef struct {
     IR_Block *blocks;
     int block_count;
     int block_capacity;
+    int current;    // Block instructions are generated into
+    int *placement; // Block ids in the order they were placed, only kept during generation
+    int placed_count;
     int next_reg;
     IR_Var *locals;
     int local_count;
@@ -39,6 +83,10 @@ typedef struct {
     IR_Scope *scopes;
     int scope_count;
     int scope_capacity;
+    int param_count;
+    const char **callees; // Names of the functions called, indexed by IR_CALL
+    int callee_count;
+    int callee_capacity;
 } IR_Function;
 
 typedef struct {
@@ -49,6 +97,12 @@ typedef struct {
 
 IR_OP token_to_ir_op(TokenType type);
 
+/*
+    Integer exponentiation with wrapping multiplies,
+    A negative exponent truncates `1 / base^-exponent`, giving 0 unless the base is 1 or -1.
+*/
+int ir_pow(int base, int exponent);
+
 /*
     Begin an IR Scope,
     Tracks any variables added afterwards, and pops them from the IR virtual stack when `ir_end_scope()` is called.
@@ -72,17 +126,80 @@ IR_Block *ir_new_block();
 IR_Function *ir_new_function(const char *name);
 int ir_new_var(IR_Function *func, const char *name);
 
+/*
+    Index of `name` in the function's callee table, adding it if it is not there yet.
+*/
+int ir_add_callee(IR_Function *func, const char *name);
+
 void ir_free_module(IR_Module *module);
 
 void ir_append_function(IR_Module *module, IR_Function *func);
 int ir_append_block(IR_Function *func, IR_Block *block);
+
+/*
+    Reserves an empty block to be used as a branch target before its code exists,
+    Instructions only go into it once `ir_place_block()` makes it the current block.
+*/
+int ir_new_label(IR_Function *func);
+
+/*
+    Makes `block` the current block and lays it out after the previously placed one,
+    So a current block without a terminator falls through into it.
+*/
+void ir_place_block(IR_Function *func, int block);
+
+/*
+    Reorders the blocks into the order they were placed in and renumbers branch targets to match.
+*/
+void ir_layout_blocks(IR_Function *func);
 void ir_append_instruction(IR_Block *block, IR_Instruction *instruction);
+void ir_insert_instruction(IR_Block *block, int index, const IR_Instruction *instruction);
+void ir_remove_instruction(IR_Block *block, int index);
+
+/*
+    Returns the register written by the instruction, or -1 if it writes none.
+*/
+int ir_instruction_def(const IR_Instruction *instr);
+
+// Most registers one instruction reads
+#define IR_MAX_USES 3
+
+/*
+    Writes the registers read by the instruction into `uses`,
+    Returns how many were written (at most IR_MAX_USES).
+*/
+int ir_instruction_uses(const IR_Instruction *instr, int uses[IR_MAX_USES]);
+
+bool ir_is_terminator(IR_OP op);
+bool ir_is_compare(IR_OP op);
+
+/*
+    The comparison that holds when `a op b` does not, and the one that holds for `b op a`.
+*/
+IR_OP ir_compare_negate(IR_OP op);
+IR_OP ir_compare_swap(IR_OP op);
+
+/*
+    Walks backwards from `index` (exclusive) looking for the last write to `reg` within the block,
+    Returns true and sets `value` if that write was an IR_LOAD of a constant, or a copy of one.
+*/
+bool ir_reg_const_at(const IR_Block *block, int index, int reg, int *value);
 
 int ir_get_var_reg(IR_Function *func, const char *name);
 
 IR_Block *current_block(const IR_Function *func);
 
+/*
+    Evaluates operands in Sethi-Ullman order and recycles temporaries within the expression,
+    Returns the register holding the result.
+*/
 int ir_gen_expression(IR_Function *func, Node *expr);
+
+/*
+    Branches to `true_block` if `expr` is nonzero and to `false_block` otherwise,
+    `&&`, `||` and `!` become branch chains, their operands are never materialised as 0 or 1.
+*/
+void ir_gen_condition(IR_Function *func, Node *expr, int true_block, int false_block);
 void ir_gen_compound(IR_Function *func, const Node *comp);
 void ir_gen_while_statement(IR_Function *func, Node *_while);
 void ir_gen_if_statement(IR_Function *func, const Node *_if);
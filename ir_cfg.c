@@ -0,0 +1,592 @@
+#include "ir_cfg.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int ir_block_terminator(const IR_Block *block) {
+    for (int i = 0; i < block->count; i++) {
+        if (ir_is_terminator(block->instructions[i].op)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void cfg_add_pred(IR_CFG_Block *block, const int pred) {
+    if (block->pred_count >= block->pred_capacity) {
+        block->pred_capacity = block->pred_capacity == 0 ? 2 : block->pred_capacity * 2;
+        block->preds = realloc(block->preds, sizeof(int) * block->pred_capacity);
+        if (block->preds == NULL) {
+            printf("Failed to allocate CFG predecessors\n");
+            exit(1);
+        }
+    }
+    block->preds[block->pred_count++] = pred;
+}
+
+static void cfg_add_edge(IR_CFG *cfg, const int from, const int to) {
+    IR_CFG_Block *block = &cfg->blocks[from];
+    for (int i = 0; i < block->succ_count; i++) {
+        if (block->succs[i] == to) {
+            return;
+        }
+    }
+    block->succs[block->succ_count++] = to;
+    cfg_add_pred(&cfg->blocks[to], from);
+}
+
+static void cfg_post_order(IR_CFG *cfg, const int block, bool *visited, int *order, int *count) {
+    visited[block] = true;
+    for (int i = 0; i < cfg->blocks[block].succ_count; i++) {
+        const int succ = cfg->blocks[block].succs[i];
+        if (!visited[succ]) {
+            cfg_post_order(cfg, succ, visited, order, count);
+        }
+    }
+    order[(*count)++] = block;
+}
+
+static int cfg_intersect(const IR_CFG *cfg, int a, int b) {
+    while (a != b) {
+        while (cfg->blocks[a].rpo > cfg->blocks[b].rpo) {
+            a = cfg->blocks[a].idom;
+        }
+        while (cfg->blocks[b].rpo > cfg->blocks[a].rpo) {
+            b = cfg->blocks[b].idom;
+        }
+    }
+    return a;
+}
+
+/*
+    Cooper, Harvey and Kennedy's iterative dominator algorithm over reverse post-order.
+*/
+static void cfg_build_dominators(IR_CFG *cfg) {
+    if (cfg->rpo_count == 0) {
+        return;
+    }
+    const int entry = cfg->rpo_order[0];
+    cfg->blocks[entry].idom = entry;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 1; i < cfg->rpo_count; i++) {
+            const int b = cfg->rpo_order[i];
+            int new_idom = -1;
+            for (int j = 0; j < cfg->blocks[b].pred_count; j++) {
+                const int p = cfg->blocks[b].preds[j];
+                if (cfg->blocks[p].idom == -1) {
+                    continue;
+                }
+                new_idom = new_idom == -1 ? p : cfg_intersect(cfg, p, new_idom);
+            }
+            if (new_idom != cfg->blocks[b].idom) {
+                cfg->blocks[b].idom = new_idom;
+                changed = true;
+            }
+        }
+    }
+    cfg->blocks[entry].idom = -1;
+}
+
+bool ir_cfg_dominates(const IR_CFG *cfg, const int a, int b) {
+    if (cfg->blocks[a].rpo == -1 || cfg->blocks[b].rpo == -1) {
+        return false;
+    }
+    while (b != -1) {
+        if (a == b) {
+            return true;
+        }
+        b = cfg->blocks[b].idom;
+    }
+    return false;
+}
+
+int ir_cfg_common_dominator(const IR_CFG *cfg, const int a, const int b) { return cfg_intersect(cfg, a, b); }
+
+/*
+    Post-order of the reversed CFG from the virtual exit, numbered `block_count`,
+    Whose predecessors are the returning blocks.
+*/
+static void cfg_exit_post_order(const IR_CFG *cfg, const int block, bool *visited, int *order, int *count) {
+    visited[block] = true;
+    if (block == cfg->block_count) {
+        for (int b = 0; b < cfg->block_count; b++) {
+            if (cfg->blocks[b].succ_count == 0 && cfg->blocks[b].rpo != -1 && !visited[b]) {
+                cfg_exit_post_order(cfg, b, visited, order, count);
+            }
+        }
+    } else {
+        for (int i = 0; i < cfg->blocks[block].pred_count; i++) {
+            const int pred = cfg->blocks[block].preds[i];
+            if (cfg->blocks[pred].rpo != -1 && !visited[pred]) {
+                cfg_exit_post_order(cfg, pred, visited, order, count);
+            }
+        }
+    }
+    order[(*count)++] = block;
+}
+
+static int cfg_post_intersect(const int *ipdom, const int *position, int a, int b) {
+    while (a != b) {
+        while (position[a] > position[b]) {
+            a = ipdom[a];
+        }
+        while (position[b] > position[a]) {
+            b = ipdom[b];
+        }
+    }
+    return a;
+}
+
+/*
+    The same algorithm as cfg_build_dominators() run backwards from the virtual exit.
+*/
+static void cfg_build_post_dominators(IR_CFG *cfg) {
+    const int exit_block = cfg->block_count;
+    bool *visited = calloc(exit_block + 1, sizeof(bool));
+    int *post = malloc(sizeof(int) * (exit_block + 1));
+    int *position = malloc(sizeof(int) * (exit_block + 1));
+    int *ipdom = malloc(sizeof(int) * (exit_block + 1));
+    if (visited == NULL || post == NULL || position == NULL || ipdom == NULL) {
+        printf("Failed to allocate post-dominators\n");
+        exit(1);
+    }
+    int count = 0;
+    cfg_exit_post_order(cfg, exit_block, visited, post, &count);
+    for (int i = 0; i < count; i++) {
+        position[post[count - 1 - i]] = i;
+        ipdom[post[count - 1 - i]] = -1;
+    }
+    ipdom[exit_block] = exit_block;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 1; i < count; i++) {
+            const int b = post[count - 1 - i];
+            const IR_CFG_Block *block = &cfg->blocks[b];
+            int new_ipdom = block->succ_count == 0 ? exit_block : -1;
+            for (int j = 0; j < block->succ_count; j++) {
+                const int s = block->succs[j];
+                if (!visited[s] || ipdom[s] == -1) {
+                    continue;
+                }
+                new_ipdom = new_ipdom == -1 ? s : cfg_post_intersect(ipdom, position, s, new_ipdom);
+            }
+            if (new_ipdom != ipdom[b]) {
+                ipdom[b] = new_ipdom;
+                changed = true;
+            }
+        }
+    }
+    for (int i = 1; i < count; i++) {
+        const int b = post[count - 1 - i];
+        cfg->blocks[b].post_rpo = i;
+        cfg->blocks[b].ipdom = ipdom[b] == exit_block ? -1 : ipdom[b];
+    }
+    free(visited);
+    free(post);
+    free(position);
+    free(ipdom);
+}
+
+bool ir_cfg_post_dominates(const IR_CFG *cfg, const int a, int b) {
+    if (cfg->blocks[a].post_rpo == -1 || cfg->blocks[b].post_rpo == -1) {
+        return false;
+    }
+    while (b != -1) {
+        if (a == b) {
+            return true;
+        }
+        b = cfg->blocks[b].ipdom;
+    }
+    return false;
+}
+
+int ir_cfg_common_post_dominator(const IR_CFG *cfg, int a, int b) {
+    if (a == -1 || b == -1 || cfg->blocks[a].post_rpo == -1 || cfg->blocks[b].post_rpo == -1) {
+        return -1;
+    }
+    while (a != b) {
+        while (a != -1 && b != -1 && cfg->blocks[a].post_rpo > cfg->blocks[b].post_rpo) {
+            a = cfg->blocks[a].ipdom;
+        }
+        while (a != -1 && b != -1 && cfg->blocks[b].post_rpo > cfg->blocks[a].post_rpo) {
+            b = cfg->blocks[b].ipdom;
+        }
+        if (a == -1 || b == -1) {
+            return -1;
+        }
+    }
+    return a;
+}
+
+static int cfg_find_loop(const IR_CFG *cfg, const int header) {
+    for (int i = 0; i < cfg->loop_count; i++) {
+        if (cfg->loops[i].header == header) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int loop_size(const IR_Loop *loop, const int block_count) {
+    int size = 0;
+    for (int i = 0; i < block_count; i++) {
+        size += loop->contains[i];
+    }
+    return size;
+}
+
+/*
+    Natural loops from back edges, loops sharing a header are merged.
+*/
+static void cfg_build_loops(IR_CFG *cfg) {
+    int *stack = malloc(sizeof(int) * (cfg->block_count + 1));
+    for (int t = 0; t < cfg->block_count; t++) {
+        for (int s = 0; s < cfg->blocks[t].succ_count; s++) {
+            const int h = cfg->blocks[t].succs[s];
+            if (!ir_cfg_dominates(cfg, h, t)) {
+                continue;
+            }
+            int index = cfg_find_loop(cfg, h);
+            if (index == -1) {
+                cfg->loops = realloc(cfg->loops, sizeof(IR_Loop) * (cfg->loop_count + 1));
+                if (cfg->loops == NULL) {
+                    printf("Failed to allocate IR loops\n");
+                    exit(1);
+                }
+                index = cfg->loop_count++;
+                IR_Loop *new_loop = &cfg->loops[index];
+                *new_loop = (IR_Loop){h, -1, -1, 0, NULL, 0, calloc(cfg->block_count, sizeof(bool))};
+                new_loop->latches = malloc(sizeof(int) * cfg->block_count);
+                new_loop->contains[h] = true;
+            }
+            IR_Loop *loop = &cfg->loops[index];
+            loop->latches[loop->latch_count++] = t;
+            // Everything that reaches the latch without passing the header is in the loop
+            int top = 0;
+            if (!loop->contains[t]) {
+                loop->contains[t] = true;
+                stack[top++] = t;
+            }
+            while (top > 0) {
+                const int b = stack[--top];
+                for (int p = 0; p < cfg->blocks[b].pred_count; p++) {
+                    const int pred = cfg->blocks[b].preds[p];
+                    if (!loop->contains[pred] && cfg->blocks[pred].rpo != -1) {
+                        loop->contains[pred] = true;
+                        stack[top++] = pred;
+                    }
+                }
+            }
+        }
+    }
+    free(stack);
+
+    // Inner loops are strictly smaller than the loops enclosing them
+    for (int i = 1; i < cfg->loop_count; i++) {
+        const IR_Loop loop = cfg->loops[i];
+        const int size = loop_size(&loop, cfg->block_count);
+        int j = i - 1;
+        while (j >= 0 && loop_size(&cfg->loops[j], cfg->block_count) > size) {
+            cfg->loops[j + 1] = cfg->loops[j];
+            j--;
+        }
+        cfg->loops[j + 1] = loop;
+    }
+    for (int i = 0; i < cfg->loop_count; i++) {
+        for (int j = i + 1; j < cfg->loop_count; j++) {
+            if (cfg->loops[j].contains[cfg->loops[i].header]) {
+                cfg->loops[i].parent = j;
+                break;
+            }
+        }
+    }
+    for (int i = cfg->loop_count - 1; i >= 0; i--) {
+        IR_Loop *loop = &cfg->loops[i];
+        loop->depth = loop->parent == -1 ? 1 : cfg->loops[loop->parent].depth + 1;
+    }
+    for (int b = 0; b < cfg->block_count; b++) {
+        for (int i = 0; i < cfg->loop_count; i++) {
+            if (cfg->loops[i].contains[b]) {
+                cfg->blocks[b].loop = i;
+                break;
+            }
+        }
+    }
+
+    for (int i = 0; i < cfg->loop_count; i++) {
+        IR_Loop *loop = &cfg->loops[i];
+        const IR_CFG_Block *header = &cfg->blocks[loop->header];
+        for (int p = 0; p < header->pred_count; p++) {
+            const int pred = header->preds[p];
+            if (loop->contains[pred]) {
+                continue;
+            }
+            if (loop->preheader != -1 || cfg->blocks[pred].succ_count != 1) {
+                loop->preheader = -1;
+                break;
+            }
+            loop->preheader = pred;
+        }
+    }
+}
+
+IR_CFG *ir_cfg_build(const IR_Function *func) {
+    IR_CFG *cfg = malloc(sizeof(IR_CFG));
+    if (cfg == NULL) {
+        printf("Failed to allocate IR CFG\n");
+        exit(1);
+    }
+    cfg->func = func;
+    cfg->block_count = func->block_count;
+    cfg->blocks = calloc(func->block_count, sizeof(IR_CFG_Block));
+    cfg->rpo_order = malloc(sizeof(int) * func->block_count);
+    cfg->rpo_count = 0;
+    cfg->loops = NULL;
+    cfg->loop_count = 0;
+    if (cfg->blocks == NULL || cfg->rpo_order == NULL) {
+        printf("Failed to allocate IR CFG blocks\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < func->block_count; i++) {
+        cfg->blocks[i].idom = -1;
+        cfg->blocks[i].rpo = -1;
+        cfg->blocks[i].ipdom = -1;
+        cfg->blocks[i].post_rpo = -1;
+        cfg->blocks[i].loop = -1;
+    }
+    for (int i = 0; i < func->block_count; i++) {
+        const IR_Block *block = &func->blocks[i];
+        const int term = ir_block_terminator(block);
+        if (term == -1) {
+            if (i + 1 < func->block_count) {
+                cfg_add_edge(cfg, i, i + 1);
+            }
+            continue;
+        }
+        const IR_Instruction *instr = &block->instructions[term];
+        switch (instr->op) {
+        case IR_BR:
+            cfg_add_edge(cfg, i, instr->dst);
+            break;
+        case IR_BR_EQ:
+            cfg_add_edge(cfg, i, instr->a);
+            cfg_add_edge(cfg, i, instr->b);
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (func->block_count > 0) {
+        bool *visited = calloc(func->block_count, sizeof(bool));
+        int *post = malloc(sizeof(int) * func->block_count);
+        int count = 0;
+        cfg_post_order(cfg, 0, visited, post, &count);
+        for (int i = 0; i < count; i++) {
+            const int block = post[count - 1 - i];
+            cfg->rpo_order[i] = block;
+            cfg->blocks[block].rpo = i;
+        }
+        cfg->rpo_count = count;
+        free(visited);
+        free(post);
+    }
+
+    cfg_build_dominators(cfg);
+    cfg_build_post_dominators(cfg);
+    cfg_build_loops(cfg);
+    return cfg;
+}
+
+void ir_cfg_free(IR_CFG *cfg) {
+    for (int i = 0; i < cfg->block_count; i++) {
+        free(cfg->blocks[i].preds);
+    }
+    for (int i = 0; i < cfg->loop_count; i++) {
+        free(cfg->loops[i].latches);
+        free(cfg->loops[i].contains);
+    }
+    free(cfg->loops);
+    free(cfg->rpo_order);
+    free(cfg->blocks);
+    free(cfg);
+}
+
+static void retarget_edge(IR_Block *block, const int from, const int to) {
+    const int term = ir_block_terminator(block);
+    if (term == -1) {
+        IR_Instruction br_instr = {IR_BR, to, 0, 0};
+        ir_append_instruction(block, &br_instr);
+        return;
+    }
+    IR_Instruction *instr = &block->instructions[term];
+    if (instr->op == IR_BR && instr->dst == from) {
+        instr->dst = to;
+    } else if (instr->op == IR_BR_EQ) {
+        if (instr->a == from) {
+            instr->a = to;
+        }
+        if (instr->b == from) {
+            instr->b = to;
+        }
+    }
+}
+
+bool ir_cfg_insert_preheaders(IR_Function *func) {
+    bool changed = false;
+    bool inserted = true;
+    while (inserted) {
+        inserted = false;
+        IR_CFG *cfg = ir_cfg_build(func);
+        for (int i = 0; i < cfg->loop_count && !inserted; i++) {
+            const IR_Loop *loop = &cfg->loops[i];
+            if (loop->preheader != -1 || loop->header == 0) {
+                continue;
+            }
+            const int preheader = ir_append_block(func, ir_new_block());
+            IR_Instruction br_instr = {IR_BR, loop->header, 0, 0};
+            ir_append_instruction(&func->blocks[preheader], &br_instr);
+            const IR_CFG_Block *header = &cfg->blocks[loop->header];
+            for (int p = 0; p < header->pred_count; p++) {
+                if (!loop->contains[header->preds[p]]) {
+                    retarget_edge(&func->blocks[header->preds[p]], loop->header, preheader);
+                }
+            }
+            inserted = true;
+            changed = true;
+        }
+        ir_cfg_free(cfg);
+    }
+    return changed;
+}
+
+bool ir_cfg_remove_unreachable(IR_Function *func) {
+    IR_CFG *cfg = ir_cfg_build(func);
+    int *new_id = malloc(sizeof(int) * (func->block_count + 1));
+    if (new_id == NULL) {
+        printf("Failed to allocate block numbers\n");
+        exit(1);
+    }
+    // A block falls through into a reachable block, so keeping the order keeps every fallthrough
+    int count = 0;
+    for (int b = 0; b < func->block_count; b++) {
+        if (cfg->blocks[b].rpo == -1) {
+            new_id[b] = -1;
+            free(func->blocks[b].instructions);
+            continue;
+        }
+        new_id[b] = count;
+        func->blocks[count++] = func->blocks[b];
+    }
+    ir_cfg_free(cfg);
+    const bool changed = count < func->block_count;
+    func->block_count = count;
+    for (int b = 0; b < count && changed; b++) {
+        IR_Block *block = &func->blocks[b];
+        const int term = ir_block_terminator(block);
+        // Branches after the terminator may name deleted blocks, they are unreachable too
+        while (term != -1 && block->count > term + 1) {
+            ir_remove_instruction(block, block->count - 1);
+        }
+        IR_Instruction *instr = term == -1 ? NULL : &block->instructions[term];
+        if (instr != NULL && instr->op == IR_BR) {
+            instr->dst = new_id[instr->dst];
+        } else if (instr != NULL && instr->op == IR_BR_EQ) {
+            instr->a = new_id[instr->a];
+            instr->b = new_id[instr->b];
+        }
+    }
+    free(new_id);
+    return changed;
+}
+
+static void bits_set(uint64_t *bits, const int reg) { bits[reg / 64] |= 1ull << (reg % 64); }
+static bool bits_test(const uint64_t *bits, const int reg) { return (bits[reg / 64] >> (reg % 64)) & 1; }
+
+IR_Liveness *ir_liveness_build(const IR_Function *func, const IR_CFG *cfg) {
+    IR_Liveness *live = malloc(sizeof(IR_Liveness));
+    if (live == NULL) {
+        printf("Failed to allocate IR liveness\n");
+        exit(1);
+    }
+    const int words = func->next_reg / 64 + 1;
+    const int n = func->block_count;
+    live->block_count = n;
+    live->words = words;
+    live->live_in = calloc((size_t)n * words, sizeof(uint64_t));
+    live->live_out = calloc((size_t)n * words, sizeof(uint64_t));
+    uint64_t *use = calloc((size_t)n * words, sizeof(uint64_t));
+    uint64_t *def = calloc((size_t)n * words, sizeof(uint64_t));
+    if (live->live_in == NULL || live->live_out == NULL || use == NULL || def == NULL) {
+        printf("Failed to allocate IR liveness sets\n");
+        exit(1);
+    }
+
+    // Upward exposed uses and definitions of each block
+    for (int b = 0; b < n; b++) {
+        const IR_Block *block = &func->blocks[b];
+        const int term = ir_block_terminator(block);
+        const int end = term == -1 ? block->count : term + 1;
+        uint64_t *block_use = &use[b * words];
+        uint64_t *block_def = &def[b * words];
+        for (int i = 0; i < end; i++) {
+            int uses[IR_MAX_USES];
+            const int use_count = ir_instruction_uses(&block->instructions[i], uses);
+            for (int u = 0; u < use_count; u++) {
+                if (!bits_test(block_def, uses[u])) {
+                    bits_set(block_use, uses[u]);
+                }
+            }
+            const int d = ir_instruction_def(&block->instructions[i]);
+            if (d != -1) {
+                bits_set(block_def, d);
+            }
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = cfg->rpo_count - 1; i >= 0; i--) {
+            const int b = cfg->rpo_order[i];
+            uint64_t *out = &live->live_out[b * words];
+            uint64_t *in = &live->live_in[b * words];
+            for (int s = 0; s < cfg->blocks[b].succ_count; s++) {
+                const uint64_t *succ_in = &live->live_in[cfg->blocks[b].succs[s] * words];
+                for (int w = 0; w < words; w++) {
+                    out[w] |= succ_in[w];
+                }
+            }
+            for (int w = 0; w < words; w++) {
+                const uint64_t new_in = use[b * words + w] | (out[w] & ~def[b * words + w]);
+                if (new_in != in[w]) {
+                    in[w] = new_in;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    free(use);
+    free(def);
+    return live;
+}
+
+void ir_liveness_free(IR_Liveness *live) {
+    free(live->live_in);
+    free(live->live_out);
+    free(live);
+}
+
+bool ir_live_in(const IR_Liveness *live, const int block, const int reg) {
+    return bits_test(&live->live_in[block * live->words], reg);
+}
+
+bool ir_live_out(const IR_Liveness *live, const int block, const int reg) {
+    return bits_test(&live->live_out[block * live->words], reg);
+}
@@ -0,0 +1,103 @@
+#ifndef COMPILER_C_IR_CFG_H
+#define COMPILER_C_IR_CFG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ir.h"
+
+/*
+    Control flow analysis over an IR_Function.
+
+    A block's successors come from its first terminator, anything after it is unreachable.
+    A block without a terminator falls through to the next block.
+*/
+
+typedef struct {
+    int succs[2];
+    int succ_count;
+    int *preds;
+    int pred_count;
+    int pred_capacity;
+    int idom;     // Immediate dominator, -1 for the entry and unreachable blocks
+    int rpo;      // Position in reverse post-order, -1 if unreachable
+    int ipdom;    // Immediate post-dominator, -1 if only the function's exit post-dominates the block
+    int post_rpo; // Position in reverse post-order of the reversed CFG from the exit, -1 if the block never returns
+    int loop; // Innermost loop containing this block, -1 if none
+} IR_CFG_Block;
+
+typedef struct {
+    int header;
+    int preheader; // Only predecessor from outside the loop, -1 if there is no such block
+    int parent;    // Enclosing loop, -1 for outermost loops
+    int depth;     // 1 for outermost loops
+    int *latches;
+    int latch_count;
+    bool *contains; // Indexed by block id
+} IR_Loop;
+
+typedef struct {
+    const IR_Function *func;
+    IR_CFG_Block *blocks;
+    int block_count;
+    int *rpo_order;
+    int rpo_count;
+    IR_Loop *loops; // Sorted innermost first
+    int loop_count;
+} IR_CFG;
+
+typedef struct {
+    int block_count;
+    int words;
+    uint64_t *live_in;
+    uint64_t *live_out;
+} IR_Liveness;
+
+/*
+    Returns the index of the first terminator in the block, or -1 if it falls through.
+*/
+int ir_block_terminator(const IR_Block *block);
+
+/*
+    Builds predecessors, successors, the dominator and post-dominator trees and the loop forest.
+    Post-dominance is relative to a virtual exit all returning blocks lead to.
+*/
+IR_CFG *ir_cfg_build(const IR_Function *func);
+void ir_cfg_free(IR_CFG *cfg);
+
+bool ir_cfg_dominates(const IR_CFG *cfg, int a, int b);
+bool ir_cfg_post_dominates(const IR_CFG *cfg, int a, int b);
+
+/*
+    The nearest block dominating both reachable blocks `a` and `b`.
+*/
+int ir_cfg_common_dominator(const IR_CFG *cfg, int a, int b);
+
+/*
+    The nearest block post-dominating both `a` and `b`, -1 if that is only the exit.
+*/
+int ir_cfg_common_post_dominator(const IR_CFG *cfg, int a, int b);
+
+/*
+    Gives every loop header a single predecessor from outside the loop,
+    Appending a new block which takes over the outside edges where one is missing.
+    Returns true if the function changed, in which case any IR_CFG built before is stale.
+*/
+bool ir_cfg_insert_preheaders(IR_Function *func);
+
+/*
+    Deletes the blocks the entry block can not reach, renumbering branch targets.
+    Returns true if the function changed, in which case any IR_CFG built before is stale.
+*/
+bool ir_cfg_remove_unreachable(IR_Function *func);
+
+/*
+    Computes which registers are live on entry and exit of every block.
+*/
+IR_Liveness *ir_liveness_build(const IR_Function *func, const IR_CFG *cfg);
+void ir_liveness_free(IR_Liveness *live);
+
+bool ir_live_in(const IR_Liveness *live, int block, int reg);
+bool ir_live_out(const IR_Liveness *live, int block, int reg);
+
+#endif // COMPILER_C_IR_CFG_H
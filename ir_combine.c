@@ -0,0 +1,436 @@
+#include "ir_combine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+    Multiplying by a constant is planned as a short chain over the running product `m * x`.
+*/
+typedef enum { MUL_SHL, MUL_LEA, MUL_ADD_X, MUL_SUB_X, MUL_X_SUB, MUL_NEG } MulStepKind;
+
+typedef struct {
+    MulStepKind kind;
+    int amount; // Shift for MUL_SHL and MUL_LEA
+} MulStep;
+
+// Two dependent single cycle operations beat the 3 cycle imul
+#define MAX_MUL_STEPS 2
+
+static unsigned apply_step(const unsigned m, const MulStep step) {
+    switch (step.kind) {
+    case MUL_SHL:
+        return m << step.amount;
+    case MUL_LEA:
+        return m + (m << step.amount);
+    case MUL_ADD_X:
+        return m + 1;
+    case MUL_SUB_X:
+        return m - 1;
+    case MUL_X_SUB:
+        return 1 - m;
+    case MUL_NEG:
+        return 0 - m;
+    default:
+        return m;
+    }
+}
+
+static int candidate_steps(MulStep *steps) {
+    int count = 0;
+    for (int k = 1; k < 32; k++) {
+        steps[count++] = (MulStep){MUL_SHL, k};
+    }
+    for (int k = 1; k <= 3; k++) {
+        steps[count++] = (MulStep){MUL_LEA, k};
+    }
+    steps[count++] = (MulStep){MUL_ADD_X, 0};
+    steps[count++] = (MulStep){MUL_SUB_X, 0};
+    steps[count++] = (MulStep){MUL_X_SUB, 0};
+    steps[count++] = (MulStep){MUL_NEG, 0};
+    return count;
+}
+
+static bool plan_search(const unsigned m, const unsigned target, const int depth, const MulStep *candidates,
+                        const int candidate_count, MulStep *plan) {
+    if (depth == 0) {
+        return m == target;
+    }
+    for (int i = 0; i < candidate_count; i++) {
+        plan[0] = candidates[i];
+        if (plan_search(apply_step(m, candidates[i]), target, depth - 1, candidates, candidate_count, plan + 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+    Finds the shortest chain of at most MAX_MUL_STEPS steps that multiplies by `c`,
+    Returns its length or -1 if there is none.
+*/
+static int plan_multiply(const int c, MulStep *plan) {
+    MulStep candidates[40];
+    const int candidate_count = candidate_steps(candidates);
+    for (int depth = 1; depth <= MAX_MUL_STEPS; depth++) {
+        if (plan_search(1, (unsigned)c, depth, candidates, candidate_count, plan)) {
+            return depth;
+        }
+    }
+    return -1;
+}
+
+IR_DivMagic ir_div_magic(const int d) {
+    const unsigned two31 = 0x80000000u;
+    const unsigned ad = d < 0 ? 0u - (unsigned)d : (unsigned)d;
+    const unsigned t = two31 + ((unsigned)d >> 31);
+    const unsigned anc = t - 1 - t % ad;
+    int p = 31;
+    unsigned q1 = two31 / anc;
+    unsigned r1 = two31 - q1 * anc;
+    unsigned q2 = two31 / ad;
+    unsigned r2 = two31 - q2 * ad;
+    unsigned delta;
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    IR_DivMagic magic;
+    magic.multiplier = (int)(q2 + 1);
+    if (d < 0) {
+        magic.multiplier = (int)(0u - (unsigned)magic.multiplier);
+    }
+    magic.shift = p - 32;
+    return magic;
+}
+
+static int emit(IR_Function *func, IR_Block *block, int *at, const IR_OP op, int dst, const int a, const int b) {
+    if (dst == -1) {
+        dst = func->next_reg++;
+    }
+    ir_insert_instruction(block, (*at)++, &(IR_Instruction){op, dst, a, b});
+    return dst;
+}
+
+static int emit_neg(IR_Function *func, IR_Block *block, int *at, const int dst, const int a) {
+    const int zero = emit(func, block, at, IR_LOAD, -1, 0, 0);
+    return emit(func, block, at, IR_SUB, dst, zero, a);
+}
+
+static void emit_multiply(IR_Function *func, IR_Block *block, int at, const int dst, const int x, const MulStep *plan,
+                          const int steps) {
+    int cur = x;
+    for (int i = 0; i < steps; i++) {
+        const int out = i == steps - 1 ? dst : -1;
+        switch (plan[i].kind) {
+        case MUL_SHL:
+            cur = emit(func, block, &at, IR_SHL, out, cur, plan[i].amount);
+            break;
+        case MUL_LEA:
+            cur = emit(func, block, &at, IR_LEA, out, cur, plan[i].amount);
+            break;
+        case MUL_ADD_X:
+            cur = emit(func, block, &at, IR_ADD, out, cur, x);
+            break;
+        case MUL_SUB_X:
+            cur = emit(func, block, &at, IR_SUB, out, cur, x);
+            break;
+        case MUL_X_SUB:
+            cur = emit(func, block, &at, IR_SUB, out, x, cur);
+            break;
+        case MUL_NEG:
+            cur = emit_neg(func, block, &at, out, cur);
+            break;
+        }
+    }
+}
+
+// Exponents up to this get a shortest addition chain, larger ones use binary square-and-multiply
+#define MAX_SEARCHED_EXPONENT 256
+#define MAX_CHAIN_LENGTH 64
+
+/*
+    An addition chain for raising to a constant power, step i computes
+    `chain[i] = chain[left[i]] + chain[right[i]]` as one multiply.
+*/
+typedef struct {
+    int chain[MAX_CHAIN_LENGTH];
+    int left[MAX_CHAIN_LENGTH];
+    int right[MAX_CHAIN_LENGTH];
+    int length;
+} PowChain;
+
+static bool chain_search(PowChain *c, const int limit, const int n) {
+    const int last = c->chain[c->length - 1];
+    if (last == n) {
+        return true;
+    }
+    const int steps = c->length - 1;
+    if (steps == limit || ((long long)last << (limit - steps)) < n) {
+        return false;
+    }
+    for (int i = c->length - 1; i >= 0; i--) {
+        for (int j = i; j >= 0; j--) {
+            const int v = c->chain[i] + c->chain[j];
+            if (v <= last || v > n) {
+                continue;
+            }
+            c->chain[c->length] = v;
+            c->left[c->length] = i;
+            c->right[c->length] = j;
+            c->length++;
+            if (chain_search(c, limit, n)) {
+                return true;
+            }
+            c->length--;
+        }
+    }
+    return false;
+}
+
+/*
+    Shortest addition chain by iterative deepening for small exponents,
+    Left to right binary exponentiation otherwise.
+*/
+static void plan_power(const int n, PowChain *c) {
+    c->chain[0] = 1;
+    c->length = 1;
+    if (n <= MAX_SEARCHED_EXPONENT) {
+        for (int limit = 0; !chain_search(c, limit, n); limit++) {
+            c->length = 1;
+        }
+        return;
+    }
+    int top = 30;
+    while (!((n >> top) & 1)) {
+        top--;
+    }
+    for (int bit = top - 1; bit >= 0; bit--) {
+        const int prev = c->length - 1;
+        c->chain[c->length] = c->chain[prev] * 2;
+        c->left[c->length] = prev;
+        c->right[c->length] = prev;
+        c->length++;
+        if ((n >> bit) & 1) {
+            c->chain[c->length] = c->chain[c->length - 1] + 1;
+            c->left[c->length] = c->length - 1;
+            c->right[c->length] = 0;
+            c->length++;
+        }
+    }
+}
+
+static void emit_power(IR_Function *func, IR_Block *block, int at, const int dst, const int base, const int exponent) {
+    PowChain c;
+    plan_power(exponent, &c);
+    int regs[MAX_CHAIN_LENGTH];
+    regs[0] = base;
+    for (int i = 1; i < c.length; i++) {
+        regs[i] = emit(func, block, &at, IR_MUL, i == c.length - 1 ? dst : -1, regs[c.left[i]], regs[c.right[i]]);
+    }
+}
+
+static int log2_exact(const unsigned v) {
+    if (v == 0 || (v & (v - 1)) != 0) {
+        return -1;
+    }
+    int k = 0;
+    while ((1u << k) != v) {
+        k++;
+    }
+    return k;
+}
+
+/*
+    Replaces `dst = n / d` at `at` with shifts or a multiply-high sequence, the division is removed first.
+*/
+static void emit_divide(IR_Function *func, IR_Block *block, int at, const int dst, const int n, const int d) {
+    const unsigned ad = d < 0 ? 0u - (unsigned)d : (unsigned)d;
+    const int k = log2_exact(ad);
+    int q;
+    if (k != -1) {
+        // Bias negative dividends by 2^k - 1 so the arithmetic shift truncates towards zero
+        const int sign = k == 1 ? n : emit(func, block, &at, IR_SAR, -1, n, 31);
+        const int bias = emit(func, block, &at, IR_SHR, -1, sign, 32 - k);
+        const int biased = emit(func, block, &at, IR_ADD, -1, n, bias);
+        q = emit(func, block, &at, IR_SAR, d < 0 ? -1 : dst, biased, k);
+        if (d < 0) {
+            emit_neg(func, block, &at, dst, q);
+        }
+        return;
+    }
+
+    const IR_DivMagic magic = ir_div_magic(d);
+    const int multiplier = emit(func, block, &at, IR_LOAD, -1, magic.multiplier, 0);
+    q = emit(func, block, &at, IR_MULH, -1, n, multiplier);
+    if (d > 0 && magic.multiplier < 0) {
+        q = emit(func, block, &at, IR_ADD, -1, q, n);
+    } else if (d < 0 && magic.multiplier > 0) {
+        q = emit(func, block, &at, IR_SUB, -1, q, n);
+    }
+    if (magic.shift > 0) {
+        q = emit(func, block, &at, IR_SAR, -1, q, magic.shift);
+    }
+    const int sign = emit(func, block, &at, IR_SHR, -1, q, 31);
+    emit(func, block, &at, IR_ADD, dst, q, sign);
+}
+
+/*
+    Evaluates an operation whose operands are both known, returns false for division traps.
+*/
+static bool fold_constants(const IR_Block *block, const int index, int *value) {
+    const IR_Instruction *instr = &block->instructions[index];
+    int a;
+    int b;
+    const int def = ir_instruction_def(instr);
+    if (def == -1 || instr->op == IR_LOAD || !ir_reg_const_at(block, index, instr->a, &a)) {
+        return false;
+    }
+    switch (instr->op) {
+    case IR_STORE:
+        *value = a;
+        return true;
+    case IR_SHL:
+        *value = (int)((unsigned)a << instr->b);
+        return true;
+    case IR_SAR:
+        *value = a >> instr->b;
+        return true;
+    case IR_SHR:
+        *value = (int)((unsigned)a >> instr->b);
+        return true;
+    case IR_LEA:
+        *value = (int)((unsigned)a + ((unsigned)a << instr->b));
+        return true;
+    default:
+        break;
+    }
+    if (!ir_reg_const_at(block, index, instr->b, &b)) {
+        return false;
+    }
+    switch (instr->op) {
+    case IR_ADD:
+        *value = (int)((unsigned)a + (unsigned)b);
+        return true;
+    case IR_SUB:
+        *value = (int)((unsigned)a - (unsigned)b);
+        return true;
+    case IR_MUL:
+        *value = (int)((unsigned)a * (unsigned)b);
+        return true;
+    case IR_DIV:
+        if (b == 0 || (a == -2147483647 - 1 && b == -1)) {
+            return false;
+        }
+        *value = a / b;
+        return true;
+    case IR_MULH:
+        *value = (int)(((long long)a * b) >> 32);
+        return true;
+    case IR_POW:
+        *value = ir_pow(a, b);
+        return true;
+    case IR_CMP_EQ:
+        *value = a == b;
+        return true;
+    case IR_CMP_NE:
+        *value = a != b;
+        return true;
+    case IR_CMP_LT:
+        *value = a < b;
+        return true;
+    case IR_CMP_LE:
+        *value = a <= b;
+        return true;
+    case IR_CMP_GT:
+        *value = a > b;
+        return true;
+    case IR_CMP_GE:
+        *value = a >= b;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool combine_instruction(IR_Function *func, IR_Block *block, const int index) {
+    const IR_Instruction instr = block->instructions[index];
+    int c;
+    if (fold_constants(block, index, &c)) {
+        block->instructions[index] = (IR_Instruction){IR_LOAD, instr.dst, c, 0};
+        return true;
+    }
+    if (instr.op == IR_MUL) {
+        int x;
+        if (ir_reg_const_at(block, index, instr.b, &c)) {
+            x = instr.a;
+        } else if (ir_reg_const_at(block, index, instr.a, &c)) {
+            x = instr.b;
+        } else {
+            return false;
+        }
+        if (c == 0 || c == 1) {
+            block->instructions[index] = c == 0 ? (IR_Instruction){IR_LOAD, instr.dst, 0, 0}
+                                                : (IR_Instruction){IR_STORE, instr.dst, x, 0};
+            return true;
+        }
+        MulStep plan[MAX_MUL_STEPS];
+        const int steps = plan_multiply(c, plan);
+        if (steps == -1) {
+            return false;
+        }
+        ir_remove_instruction(block, index);
+        emit_multiply(func, block, index, instr.dst, x, plan, steps);
+        return true;
+    }
+    if (instr.op == IR_POW && ir_reg_const_at(block, index, instr.b, &c) && c >= 0) {
+        if (c == 0 || c == 1) {
+            block->instructions[index] = c == 0 ? (IR_Instruction){IR_LOAD, instr.dst, 1, 0}
+                                                : (IR_Instruction){IR_STORE, instr.dst, instr.a, 0};
+            return true;
+        }
+        ir_remove_instruction(block, index);
+        emit_power(func, block, index, instr.dst, instr.a, c);
+        return true;
+    }
+    if (instr.op == IR_DIV && ir_reg_const_at(block, index, instr.b, &c)) {
+        if (c == 0) {
+            return false;
+        }
+        ir_remove_instruction(block, index);
+        if (c == 1) {
+            ir_insert_instruction(block, index, &(IR_Instruction){IR_STORE, instr.dst, instr.a, 0});
+        } else if (c == -1) {
+            int at = index;
+            emit_neg(func, block, &at, instr.dst, instr.a);
+        } else {
+            emit_divide(func, block, index, instr.dst, instr.a, c);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool ir_combine(IR_Function *func) {
+    bool changed = false;
+    for (int b = 0; b < func->block_count; b++) {
+        IR_Block *block = &func->blocks[b];
+        // Replacements never contain another multiply or divide by a constant, so rescanning them is harmless
+        for (int i = 0; i < block->count; i++) {
+            changed |= combine_instruction(func, block, i);
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,28 @@
+#ifndef COMPILER_C_IR_COMBINE_H
+#define COMPILER_C_IR_COMBINE_H
+
+#include "ir.h"
+
+/*
+    Magic number for signed division by a constant (Granlund and Montgomery, as in Hacker's Delight 10-1),
+    `n / d` is `(mulh(n, multiplier) [+/- n]) >> shift`, rounded towards zero by adding the sign bit.
+*/
+typedef struct {
+    int multiplier;
+    int shift;
+} IR_DivMagic;
+
+/*
+    Only valid for 2 <= |d|, powers of two are better served by shifts.
+*/
+IR_DivMagic ir_div_magic(int d);
+
+/*
+    Folds operations on constants, expands constant powers into addition chains of multiplies,
+    and rewrites multiplications and divisions by constants into shifts, lea/shift-add chains
+    and multiply-high sequences.
+    Returns true if the function changed.
+*/
+bool ir_combine(IR_Function *func);
+
+#endif // COMPILER_C_IR_COMBINE_H
@@ -0,0 +1,75 @@
+#include "ir_eval.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ir_interp.h"
+
+static bool is_closed(const IR_Function *func) {
+    for (int b = 0; b < func->block_count; b++) {
+        for (int i = 0; i < func->blocks[b].count; i++) {
+            switch (func->blocks[b].instructions[i].op) {
+            case IR_ADD:
+            case IR_SUB:
+            case IR_MUL:
+            case IR_DIV:
+            case IR_SHL:
+            case IR_SAR:
+            case IR_SHR:
+            case IR_LEA:
+            case IR_MULH:
+            case IR_POW:
+            case IR_CMP_EQ:
+            case IR_CMP_NE:
+            case IR_CMP_LT:
+            case IR_CMP_LE:
+            case IR_CMP_GT:
+            case IR_CMP_GE:
+            case IR_LOAD:
+            case IR_STORE:
+            case IR_SELECT:
+            case IR_RET:
+            case IR_BR:
+            case IR_BR_EQ:
+                break;
+            default:
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+    Already nothing more than a constant return.
+*/
+static bool is_constant(const IR_Function *func) {
+    const IR_Block *block = &func->blocks[0];
+    return func->block_count == 1 && block->count == 2 && block->instructions[0].op == IR_LOAD &&
+           block->instructions[1].op == IR_RET && block->instructions[1].dst == block->instructions[0].dst;
+}
+
+bool ir_evaluate_function(IR_Function *func, const long long budget) {
+    if (budget <= 0 || func->block_count == 0 || is_constant(func) || !is_closed(func)) {
+        return false;
+    }
+    IR_Program *program = ir_interp_compile(func);
+    const IR_InterpResult result = ir_interp_run(program, budget);
+    ir_interp_free(program);
+    if (result.status != IR_INTERP_OK) {
+        return false;
+    }
+
+    for (int b = 1; b < func->block_count; b++) {
+        free(func->blocks[b].instructions);
+    }
+    func->block_count = 1;
+    func->next_reg = 1;
+    IR_Block *block = &func->blocks[0];
+    block->count = 0;
+    IR_Instruction load = {IR_LOAD, 0, result.value, 0};
+    IR_Instruction ret = {IR_RET, 0, 0, 0};
+    ir_append_instruction(block, &load);
+    ir_append_instruction(block, &ret);
+    return true;
+}
@@ -0,0 +1,25 @@
+#ifndef COMPILER_C_IR_EVAL_H
+#define COMPILER_C_IR_EVAL_H
+
+#include "ir.h"
+
+/*
+    Compile-time evaluation of closed functions.
+
+    A function is closed when its result depends on nothing outside it,
+    It only computes with constants, arithmetic, comparisons and branches.
+    Such a function is run by the IR interpreter, and if it returns within the budget its body becomes that constant.
+    Functions that trap or run out of budget are left alone, the compiled program has to behave the same at run time.
+*/
+
+// Instructions a single function may execute at compile time, 0 turns evaluation off
+#ifndef IR_EVAL_BUDGET
+#define IR_EVAL_BUDGET 1000000
+#endif
+
+/*
+    Returns true if the body was replaced by its result.
+*/
+bool ir_evaluate_function(IR_Function *func, long long budget);
+
+#endif // COMPILER_C_IR_EVAL_H
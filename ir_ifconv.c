@@ -0,0 +1,237 @@
+#include "ir_ifconv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ir_cfg.h"
+#include "ir_layout.h"
+
+static bool can_speculate(const IR_OP op) {
+    switch (op) {
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_SHL:
+    case IR_SAR:
+    case IR_SHR:
+    case IR_LEA:
+    case IR_MULH:
+    case IR_CMP_EQ:
+    case IR_CMP_NE:
+    case IR_CMP_LT:
+    case IR_CMP_LE:
+    case IR_CMP_GT:
+    case IR_CMP_GE:
+    case IR_LOAD:
+    case IR_STORE:
+    case IR_SELECT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*
+    Instructions block `arm` adds when run ahead of block `b`'s branch, -1 if it can not be an arm of that branch.
+    An arm's only predecessor is the branching block and it always goes on to the same block, written to `join`.
+*/
+static int arm_size(const IR_Function *func, const IR_CFG *cfg, const int b, const int arm, int *join) {
+    if (arm == b || cfg->blocks[arm].pred_count != 1 || cfg->blocks[arm].succ_count != 1) {
+        return -1;
+    }
+    const IR_Block *block = &func->blocks[arm];
+    const int term = ir_block_terminator(block);
+    if (term != -1 && block->instructions[term].op != IR_BR) {
+        return -1;
+    }
+    const int end = term == -1 ? block->count : term;
+    if (end > IR_IFCONV_MAX_ARM) {
+        return -1;
+    }
+    int size = 0;
+    for (int i = 0; i < end; i++) {
+        if (!can_speculate(block->instructions[i].op)) {
+            return -1;
+        }
+        // A select gets a copy of the value it keeps
+        size += block->instructions[i].op == IR_SELECT ? 2 : 1;
+    }
+    *join = cfg->blocks[arm].succs[0];
+    return size;
+}
+
+static bool arm_writes(const IR_Function *func, const int arm, const int reg) {
+    if (arm == -1) {
+        return false;
+    }
+    const IR_Block *block = &func->blocks[arm];
+    for (int i = 0; i < block->count; i++) {
+        if (ir_instruction_def(&block->instructions[i]) == reg) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int current(const int *renamed, const int reg) { return renamed[reg] != -1 ? renamed[reg] : reg; }
+
+/*
+    Appends the arm's instructions to `block` with every write going to a fresh register,
+    `renamed` maps each register the arm wrote to the one holding its value.
+*/
+static void hoist_arm(IR_Function *func, IR_Block *block, const IR_Block *arm, int *renamed) {
+    const int term = ir_block_terminator(arm);
+    const int end = term == -1 ? arm->count : term;
+    for (int i = 0; i < end; i++) {
+        IR_Instruction instr = arm->instructions[i];
+        int uses[IR_MAX_USES];
+        const int use_count = ir_instruction_uses(&instr, uses);
+        if (use_count > 0) {
+            instr.a = current(renamed, instr.a);
+        }
+        if (use_count > 1) {
+            instr.b = current(renamed, instr.b);
+        }
+        const int fresh = func->next_reg++;
+        if (instr.op == IR_SELECT) {
+            ir_append_instruction(block, &(IR_Instruction){IR_STORE, fresh, current(renamed, instr.dst), 0});
+        }
+        renamed[instr.dst] = fresh;
+        instr.dst = fresh;
+        ir_append_instruction(block, &instr);
+    }
+}
+
+/*
+    Flattens the branch ending block `b` if it heads a diamond or triangle worth converting.
+*/
+static bool convert_branch(IR_Function *func, const IR_CFG *cfg, const IR_Liveness *live, const IR_Profile *profile,
+                           const int b) {
+    if (cfg->blocks[b].rpo == -1 || cfg->blocks[b].succ_count != 2) {
+        return false;
+    }
+    if (profile->taken[b] >= IR_IFCONV_BIASED || profile->taken[b] <= 1 - IR_IFCONV_BIASED) {
+        return false;
+    }
+    // Arm taken when the condition holds and when it does not, -1 where the branch goes straight to the join
+    const int *succs = cfg->blocks[b].succs;
+    int arms[2] = {-1, -1};
+    int sizes[2];
+    int joins[2] = {-1, -1};
+    for (int s = 0; s < 2; s++) {
+        sizes[s] = arm_size(func, cfg, b, succs[s], &joins[s]);
+    }
+    int join;
+    if (sizes[0] != -1 && sizes[1] != -1 && joins[0] == joins[1]) {
+        arms[0] = succs[0];
+        arms[1] = succs[1];
+        join = joins[0];
+    } else if (sizes[0] != -1 && joins[0] == succs[1]) {
+        arms[0] = succs[0];
+        sizes[1] = 0;
+        join = succs[1];
+    } else if (sizes[1] != -1 && joins[1] == succs[0]) {
+        arms[1] = succs[1];
+        sizes[0] = 0;
+        join = succs[0];
+    } else {
+        return false;
+    }
+    if (join == b) {
+        return false;
+    }
+
+    IR_Block *block = &func->blocks[b];
+    const int term = ir_block_terminator(block);
+    const int cond = block->instructions[term].dst;
+    const int reg_count = func->next_reg;
+    // One select for a register both arms write, a copy in and out of a temporary for the arm taken on false
+    int growth = sizes[0] + sizes[1];
+    bool cond_selected = false;
+    for (int r = 0; r < reg_count; r++) {
+        const bool on_true = arm_writes(func, arms[0], r);
+        const bool on_false = arm_writes(func, arms[1], r);
+        if ((on_true || on_false) && ir_live_in(live, join, r)) {
+            growth += on_true && on_false ? 2 : on_true ? 1 : 3;
+            cond_selected |= r == cond;
+        }
+    }
+    if (growth + cond_selected > IR_IFCONV_MAX_GROWTH) {
+        return false;
+    }
+
+    int *renamed = malloc(sizeof(int) * 2 * (reg_count + 1));
+    if (renamed == NULL) {
+        printf("Failed to allocate if-conversion registers\n");
+        exit(1);
+    }
+    for (int r = 0; r < 2 * (reg_count + 1); r++) {
+        renamed[r] = -1;
+    }
+    int *on_true = renamed;
+    int *on_false = renamed + reg_count + 1;
+    while (block->count > term) {
+        ir_remove_instruction(block, block->count - 1);
+    }
+    for (int s = 0; s < 2; s++) {
+        if (arms[s] != -1) {
+            hoist_arm(func, block, &func->blocks[arms[s]], s == 0 ? on_true : on_false);
+        }
+    }
+    // The selects write registers the condition may be in
+    int select_cond = cond;
+    if (cond_selected) {
+        select_cond = func->next_reg++;
+        ir_append_instruction(block, &(IR_Instruction){IR_STORE, select_cond, cond, 0});
+    }
+    for (int r = 0; r < reg_count; r++) {
+        if ((on_true[r] == -1 && on_false[r] == -1) || !ir_live_in(live, join, r)) {
+            continue;
+        }
+        if (on_true[r] == -1) {
+            const int kept = func->next_reg++;
+            ir_append_instruction(block, &(IR_Instruction){IR_STORE, kept, on_false[r], 0});
+            ir_append_instruction(block, &(IR_Instruction){IR_SELECT, kept, select_cond, r});
+            ir_append_instruction(block, &(IR_Instruction){IR_STORE, r, kept, 0});
+            continue;
+        }
+        if (on_false[r] != -1) {
+            ir_append_instruction(block, &(IR_Instruction){IR_STORE, r, on_false[r], 0});
+        }
+        ir_append_instruction(block, &(IR_Instruction){IR_SELECT, r, select_cond, on_true[r]});
+    }
+    ir_append_instruction(block, &(IR_Instruction){IR_BR, join, 0, 0});
+    free(renamed);
+
+    // Nothing reaches the arms any more
+    for (int s = 0; s < 2; s++) {
+        IR_Block *arm = arms[s] == -1 ? NULL : &func->blocks[arms[s]];
+        while (arm != NULL && arm->count > 0) {
+            ir_remove_instruction(arm, arm->count - 1);
+        }
+    }
+    return true;
+}
+
+bool ir_if_convert(IR_Function *func) {
+    bool changed = false;
+    bool converted = true;
+    // Each conversion deletes blocks, so the analyses are rebuilt after every one
+    while (converted) {
+        converted = false;
+        IR_CFG *cfg = ir_cfg_build(func);
+        IR_Liveness *live = ir_liveness_build(func, cfg);
+        IR_Profile *profile = ir_profile_build(func, cfg);
+        for (int b = 0; b < func->block_count && !converted; b++) {
+            converted = convert_branch(func, cfg, live, profile, b);
+        }
+        ir_profile_free(profile);
+        ir_liveness_free(live);
+        ir_cfg_free(cfg);
+        if (converted) {
+            ir_cfg_remove_unreachable(func);
+            changed = true;
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,34 @@
+#ifndef COMPILER_C_IR_IFCONV_H
+#define COMPILER_C_IR_IFCONV_H
+
+#include "ir.h"
+
+/*
+    If-conversion.
+
+    A branch into two small arms that only compute values and then meet again (a diamond),
+    Or into one such arm and the block it meets at (a triangle), is flattened into straight-line code:
+    Both arms run unconditionally into fresh registers so neither clobbers what the other reads,
+    And each register an arm wrote that is live where they meet takes the arm's value through an IR_SELECT,
+    Which x86 lowers to cmovcc. The arms' blocks are deleted.
+
+    Speculated instructions run on every path, so arms are limited in size and the converted block in growth.
+    Branches the static profile of ir_layout.h finds strongly biased are left alone as they rarely mispredict.
+    Division can trap and powers call a helper, so arms doing either are not converted.
+*/
+
+// Most instructions one arm may have
+#ifndef IR_IFCONV_MAX_ARM
+#define IR_IFCONV_MAX_ARM 4
+#endif
+// Most instructions the branching block may grow by, both arms and the selects together
+#define IR_IFCONV_MAX_GROWTH 10
+// Branches going one way at least this often keep their branch
+#define IR_IFCONV_BIASED 0.9
+
+/*
+    Returns true if any branch was converted.
+*/
+bool ir_if_convert(IR_Function *func);
+
+#endif // COMPILER_C_IR_IFCONV_H
@@ -0,0 +1,354 @@
+#include "ir_inline.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ir_cfg.h"
+
+int ir_find_function(const IR_Module *module, const char *name) {
+    for (int f = 0; f < module->count; f++) {
+        if (strcmp(module->functions[f]->name, name) == 0) {
+            return f;
+        }
+    }
+    return -1;
+}
+
+/*
+    Tarjan's algorithm, a component is finished only after every component it reaches,
+    So the order components are finished in is already bottom-up.
+*/
+typedef struct {
+    IR_CallGraph *graph;
+    const IR_Module *module;
+    int *index; // Visit number of each function, -1 before it is visited
+    int *lowlink;
+    bool *on_stack;
+    int *stack;
+    int stack_count;
+    int next_index;
+    int scc_count;
+    int order_count;
+} IR_Tarjan;
+
+static void strong_connect(IR_Tarjan *t, const int f) {
+    t->index[f] = t->next_index;
+    t->lowlink[f] = t->next_index++;
+    t->stack[t->stack_count++] = f;
+    t->on_stack[f] = true;
+    for (int c = 0; c < t->module->functions[f]->callee_count; c++) {
+        const int g = t->graph->callees[f][c];
+        if (g == -1) {
+            continue;
+        }
+        if (t->index[g] == -1) {
+            strong_connect(t, g);
+            if (t->lowlink[g] < t->lowlink[f]) {
+                t->lowlink[f] = t->lowlink[g];
+            }
+        } else if (t->on_stack[g] && t->index[g] < t->lowlink[f]) {
+            t->lowlink[f] = t->index[g];
+        }
+    }
+    if (t->lowlink[f] != t->index[f]) {
+        return;
+    }
+    int g;
+    do {
+        g = t->stack[--t->stack_count];
+        t->on_stack[g] = false;
+        t->graph->scc[g] = t->scc_count;
+        t->graph->order[t->order_count++] = g;
+    } while (g != f);
+    t->scc_count++;
+}
+
+IR_CallGraph *ir_call_graph_build(const IR_Module *module) {
+    const int count = module->count;
+    IR_CallGraph *graph = malloc(sizeof(IR_CallGraph));
+    IR_Tarjan t = {graph, module, malloc(sizeof(int) * (count + 1)), malloc(sizeof(int) * (count + 1)),
+                   calloc(count + 1, sizeof(bool)), malloc(sizeof(int) * (count + 1)), 0, 0, 0, 0};
+    if (graph == NULL || t.index == NULL || t.lowlink == NULL || t.on_stack == NULL || t.stack == NULL) {
+        printf("Failed to allocate call graph\n");
+        exit(1);
+    }
+    graph->count = count;
+    graph->callees = malloc(sizeof(int *) * (count + 1));
+    graph->scc = malloc(sizeof(int) * (count + 1));
+    graph->order = malloc(sizeof(int) * (count + 1));
+    if (graph->callees == NULL || graph->scc == NULL || graph->order == NULL) {
+        printf("Failed to allocate call graph\n");
+        exit(1);
+    }
+    for (int f = 0; f < count; f++) {
+        const IR_Function *func = module->functions[f];
+        graph->callees[f] = malloc(sizeof(int) * (func->callee_count + 1));
+        if (graph->callees[f] == NULL) {
+            printf("Failed to allocate call graph edges\n");
+            exit(1);
+        }
+        for (int c = 0; c < func->callee_count; c++) {
+            graph->callees[f][c] = ir_find_function(module, func->callees[c]);
+        }
+        t.index[f] = -1;
+    }
+    for (int f = 0; f < count; f++) {
+        if (t.index[f] == -1) {
+            strong_connect(&t, f);
+        }
+    }
+    free(t.index);
+    free(t.lowlink);
+    free(t.on_stack);
+    free(t.stack);
+    return graph;
+}
+
+void ir_call_graph_free(IR_CallGraph *graph) {
+    for (int f = 0; f < graph->count; f++) {
+        free(graph->callees[f]);
+    }
+    free(graph->callees);
+    free(graph->scc);
+    free(graph->order);
+    free(graph);
+}
+
+/*
+    Instructions the function would add to a caller, its parameters become the copies its arguments were.
+*/
+static int ir_function_size(const IR_Function *func) {
+    int size = 0;
+    for (int b = 0; b < func->block_count; b++) {
+        for (int i = 0; i < func->blocks[b].count; i++) {
+            size += func->blocks[b].instructions[i].op != IR_PARAM;
+        }
+    }
+    return size;
+}
+
+/*
+    The call at `index` saves its own cost and that of its arguments, constant arguments are worth a bonus on top.
+*/
+static bool ir_worth_inlining(const IR_Block *block, const int index, const int callee_size, const int threshold) {
+    const IR_Instruction *call = &block->instructions[index];
+    int benefit = IR_INLINE_CALL_COST + call->b;
+    for (int j = 0; j < call->b; j++) {
+        int value;
+        const int arg = index - call->b + j;
+        if (ir_reg_const_at(block, arg, block->instructions[arg].a, &value)) {
+            benefit += IR_INLINE_CONST_BONUS;
+        }
+    }
+    return callee_size - benefit <= threshold;
+}
+
+/*
+    Moves registers of a callee instruction above `base`, the operands ir_instruction_def() and
+    ir_instruction_uses() name are the registers, everything else is a constant, an index or a block.
+*/
+static void ir_rename_registers(IR_Instruction *instr, const int base) {
+    int uses[IR_MAX_USES];
+    const int use_count = ir_instruction_uses(instr, uses);
+    if (instr->op == IR_RET || instr->op == IR_BR_EQ) {
+        instr->dst += base;
+        return;
+    }
+    if (ir_instruction_def(instr) != -1) {
+        instr->dst += base;
+    }
+    if (use_count > 0) {
+        instr->a += base;
+    }
+    if (use_count > 1) {
+        instr->b += base;
+    }
+}
+
+/*
+    Appends a copy of callee block `src` to `copy`, parameters read the caller's `args`.
+    Returns become a copy into the call's result and a branch to `rest`,
+    With `rest` of -1 the copy stops at the return instead, to go on straight into the caller.
+*/
+static void ir_copy_block(IR_Function *caller, IR_Block *copy, const IR_Function *callee, const IR_Block *src,
+                          const IR_Instruction *call, const int *args, const int body, const int rest) {
+    const int reg_base = caller->next_reg - callee->next_reg;
+    for (int i = 0; i < src->count; i++) {
+        IR_Instruction instr = src->instructions[i];
+        switch (instr.op) {
+        case IR_PARAM:
+            instr = (IR_Instruction){IR_STORE, instr.dst + reg_base, args[instr.a], 0};
+            ir_append_instruction(copy, &instr);
+            break;
+        case IR_RET:
+            ir_append_instruction(copy, &(IR_Instruction){IR_STORE, call->dst, instr.dst + reg_base, 0});
+            if (rest != -1) {
+                ir_append_instruction(copy, &(IR_Instruction){IR_BR, rest, 0, 0});
+            }
+            break;
+        case IR_BR:
+            instr.dst += body;
+            ir_append_instruction(copy, &instr);
+            break;
+        case IR_BR_EQ:
+            ir_rename_registers(&instr, reg_base);
+            instr.a += body;
+            instr.b += body;
+            ir_append_instruction(copy, &instr);
+            break;
+        case IR_CALL:
+            ir_rename_registers(&instr, reg_base);
+            instr.a = ir_add_callee(caller, callee->callees[instr.a]);
+            ir_append_instruction(copy, &instr);
+            break;
+        case IR_TAIL_CALL:
+            // The callee returns what this call returns, so the call writes the inlined call's result
+            instr = (IR_Instruction){IR_CALL, call->dst, ir_add_callee(caller, callee->callees[instr.a]), instr.b};
+            ir_append_instruction(copy, &instr);
+            if (rest != -1) {
+                ir_append_instruction(copy, &(IR_Instruction){IR_BR, rest, 0, 0});
+            }
+            break;
+        default:
+            ir_rename_registers(&instr, reg_base);
+            ir_append_instruction(copy, &instr);
+            break;
+        }
+        // The rest of the block is unreachable, and a copied write there would clobber the call's result
+        if (ir_is_terminator(src->instructions[i].op)) {
+            return;
+        }
+    }
+    // Falling off the end of the callee returns 0
+    if (src == &callee->blocks[callee->block_count - 1] && ir_block_terminator(copy) == -1) {
+        ir_append_instruction(copy, &(IR_Instruction){IR_LOAD, call->dst, 0, 0});
+    }
+}
+
+/*
+    Splices a copy of `callee` in place of the call at `index` of block `b`.
+    A callee of one block that does not branch goes straight into the calling block.
+    Otherwise the calling block is split after the call, the callee's blocks go between its two halves,
+    And later blocks move up to make room for them.
+    Sets `b` and `index` to the first instruction after the copy.
+*/
+static void ir_inline_call(IR_Function *caller, int *b, int *index, const IR_Function *callee) {
+    const IR_Instruction call = caller->blocks[*b].instructions[*index];
+    const int body = *b + 1;
+    const int rest = body + callee->block_count;
+    const int shift = callee->block_count + 1;
+    const int args_start = *index - call.b;
+    caller->next_reg += callee->next_reg;
+
+    int *args = malloc(sizeof(int) * (call.b + 1));
+    if (args == NULL) {
+        printf("Failed to allocate for inlining\n");
+        exit(1);
+    }
+    for (int j = 0; j < call.b; j++) {
+        args[j] = caller->blocks[*b].instructions[args_start + j].a;
+    }
+
+    const int terminator = ir_block_terminator(&callee->blocks[0]);
+    if (callee->block_count == 1 && (terminator == -1 || callee->blocks[0].instructions[terminator].op == IR_RET)) {
+        IR_Block *calling = &caller->blocks[*b];
+        IR_Block *merged = ir_new_block();
+        for (int i = 0; i < args_start; i++) {
+            ir_append_instruction(merged, &calling->instructions[i]);
+        }
+        ir_copy_block(caller, merged, callee, &callee->blocks[0], &call, args, body, -1);
+        const int after = merged->count;
+        for (int i = *index + 1; i < calling->count; i++) {
+            ir_append_instruction(merged, &calling->instructions[i]);
+        }
+        free(calling->instructions);
+        *calling = *merged;
+        free(merged);
+        free(args);
+        *index = after;
+        return;
+    }
+
+    IR_Block *blocks = malloc(sizeof(IR_Block) * (caller->block_count + shift));
+    if (blocks == NULL) {
+        printf("Failed to allocate for inlining\n");
+        exit(1);
+    }
+    for (int k = 0; k < caller->block_count; k++) {
+        IR_Block *block = &blocks[k <= *b ? k : k + shift];
+        *block = caller->blocks[k];
+        for (int i = 0; i < block->count; i++) {
+            IR_Instruction *instr = &block->instructions[i];
+            if (instr->op == IR_BR && instr->dst > *b) {
+                instr->dst += shift;
+            } else if (instr->op == IR_BR_EQ) {
+                instr->a += instr->a > *b ? shift : 0;
+                instr->b += instr->b > *b ? shift : 0;
+            }
+        }
+    }
+
+    // Everything after the call continues in a block of its own
+    IR_Block *calling = &blocks[*b];
+    IR_Block *after = ir_new_block();
+    for (int i = *index + 1; i < calling->count; i++) {
+        ir_append_instruction(after, &calling->instructions[i]);
+    }
+    blocks[rest] = *after;
+    free(after);
+    calling->count = args_start;
+
+    for (int k = 0; k < callee->block_count; k++) {
+        IR_Block *copy = ir_new_block();
+        ir_copy_block(caller, copy, callee, &callee->blocks[k], &call, args, body, rest);
+        blocks[body + k] = *copy;
+        free(copy);
+    }
+
+    free(caller->blocks);
+    caller->blocks = blocks;
+    caller->block_count += shift;
+    caller->block_capacity = caller->block_count;
+    free(args);
+    *b = rest;
+    *index = 0;
+}
+
+bool ir_inline_calls(IR_Module *module, const IR_CallGraph *graph, const int func, const int threshold) {
+    if (threshold <= 0) {
+        return false;
+    }
+    IR_Function *caller = module->functions[func];
+    int size = ir_function_size(caller);
+    bool changed = false;
+    int b = 0;
+    int i = 0;
+    while (b < caller->block_count) {
+        const IR_Block *block = &caller->blocks[b];
+        const int terminator = ir_block_terminator(block);
+        if (i >= (terminator == -1 ? block->count : terminator)) {
+            b++;
+            i = 0;
+            continue;
+        }
+        const IR_Instruction *instr = &block->instructions[i];
+        const int g = instr->op == IR_CALL ? ir_find_function(module, caller->callees[instr->a]) : -1;
+        if (g == -1 || graph->scc[g] == graph->scc[func]) {
+            i++;
+            continue;
+        }
+        const IR_Function *callee = module->functions[g];
+        const int callee_size = ir_function_size(callee);
+        if (callee->param_count != instr->b || size + callee_size > IR_INLINE_MAX_CALLER_SIZE ||
+            !ir_worth_inlining(block, i, callee_size, threshold)) {
+            i++;
+            continue;
+        }
+        // Calls left in the copy were already kept by the callee, so the scan carries on after it
+        ir_inline_call(caller, &b, &i, callee);
+        size += callee_size;
+        changed = true;
+    }
+    return changed;
+}
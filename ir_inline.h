@@ -0,0 +1,50 @@
+#ifndef COMPILER_C_IR_INLINE_H
+#define COMPILER_C_IR_INLINE_H
+
+#include "ir.h"
+
+/*
+    Inlining of small functions into their callers.
+
+    ir_optimize_module() visits functions bottom-up over the strongly connected components of the call graph,
+    So a callee is inlined already optimized, and calls within a component (recursion) are kept.
+    A call is inlined when the callee's size less what the call itself costs is at most the threshold,
+    Constant arguments count in favour of inlining as they tend to fold away afterwards.
+    The callee's blocks are spliced in after the calling block and its registers renumbered above the caller's,
+    Each return becomes a copy into the call's result and a branch to the rest of the calling block.
+*/
+
+// Largest net growth in IR instructions a call may be inlined at, 0 turns inlining off
+#ifndef IR_INLINE_THRESHOLD
+#define IR_INLINE_THRESHOLD 16
+#endif
+
+// What a call costs besides its arguments, the call, frame setup and teardown and the return
+#define IR_INLINE_CALL_COST 6
+// Extra benefit of each constant argument
+#define IR_INLINE_CONST_BONUS 2
+// Callers are not grown past this many IR instructions
+#define IR_INLINE_MAX_CALLER_SIZE 2000
+
+typedef struct {
+    int count;      // Functions in the module
+    int **callees;  // Module index of each entry of a function's callee table, -1 if it is not in the module
+    int *scc;       // Strongly connected component of each function
+    int *order;     // Functions bottom-up, every callee before its callers unless they share a component
+} IR_CallGraph;
+
+IR_CallGraph *ir_call_graph_build(const IR_Module *module);
+void ir_call_graph_free(IR_CallGraph *graph);
+
+/*
+    Index of the function named `name` in the module, -1 if there is none.
+*/
+int ir_find_function(const IR_Module *module, const char *name);
+
+/*
+    Inlines the calls made by function `func` of the module, the graph gives the components calls must leave.
+    Returns true if any call was inlined.
+*/
+bool ir_inline_calls(IR_Module *module, const IR_CallGraph *graph, int func, int threshold);
+
+#endif // COMPILER_C_IR_INLINE_H
@@ -0,0 +1,344 @@
+#include "ir_interp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+IR_Program *ir_interp_compile(const IR_Function *func) {
+    IR_Program *program = malloc(sizeof(IR_Program));
+    int *block_start = malloc(sizeof(int) * (func->block_count + 1));
+    IR_Program **callees = calloc(func->callee_count + 1, sizeof(IR_Program *));
+    int count = 1;
+    for (int b = 0; b < func->block_count; b++) {
+        count += func->blocks[b].count;
+    }
+    IR_Code *code = malloc(sizeof(IR_Code) * count);
+    if (program == NULL || block_start == NULL || callees == NULL || code == NULL) {
+        printf("Failed to allocate interpreter program\n");
+        exit(1);
+    }
+
+    int pc = 0;
+    for (int b = 0; b < func->block_count; b++) {
+        block_start[b] = pc;
+        pc += func->blocks[b].count;
+    }
+    block_start[func->block_count] = pc;
+
+    pc = 0;
+    int arg_count = 0;
+    for (int b = 0; b < func->block_count; b++) {
+        for (int i = 0; i < func->blocks[b].count; i++, pc++) {
+            const IR_Instruction *instr = &func->blocks[b].instructions[i];
+            code[pc] = (IR_Code){NULL, instr->op, instr->dst, instr->a, instr->b};
+            if (instr->op == IR_BR) {
+                code[pc].dst = block_start[instr->dst];
+            } else if (instr->op == IR_BR_EQ) {
+                code[pc].a = block_start[instr->a];
+                code[pc].b = block_start[instr->b];
+            } else if ((instr->op == IR_CALL || instr->op == IR_TAIL_CALL) && instr->b > arg_count) {
+                arg_count = instr->b;
+            }
+        }
+    }
+    code[pc] = (IR_Code){NULL, IR_INTERP_END, 0, 0, 0};
+    free(block_start);
+
+    program->code = code;
+    program->count = count;
+    program->reg_count = func->next_reg;
+    program->param_count = func->param_count;
+    program->arg_count = arg_count;
+    program->threaded = false;
+    program->callee_names = func->callees;
+    program->callees = callees;
+    return program;
+}
+
+void ir_interp_free(IR_Program *program) {
+    free(program->code);
+    free(program->callees);
+    free(program);
+}
+
+IR_Program **ir_interp_compile_module(const IR_Module *module) {
+    IR_Program **programs = malloc(sizeof(IR_Program *) * (module->count + 1));
+    if (programs == NULL) {
+        printf("Failed to allocate interpreter programs\n");
+        exit(1);
+    }
+    for (int f = 0; f < module->count; f++) {
+        programs[f] = ir_interp_compile(module->functions[f]);
+    }
+    for (int f = 0; f < module->count; f++) {
+        const IR_Function *func = module->functions[f];
+        for (int c = 0; c < func->callee_count; c++) {
+            for (int g = 0; g < module->count && programs[f]->callees[c] == NULL; g++) {
+                if (strcmp(module->functions[g]->name, func->callees[c]) == 0) {
+                    programs[f]->callees[c] = programs[g];
+                }
+            }
+            if (programs[f]->callees[c] == NULL) {
+                printf("Undefined function %s\n", func->callees[c]);
+                exit(1);
+            }
+        }
+    }
+    return programs;
+}
+
+void ir_interp_free_module(IR_Program **programs, const int count) {
+    for (int f = 0; f < count; f++) {
+        ir_interp_free(programs[f]);
+    }
+    free(programs);
+}
+
+/*
+    A call waiting for its callee to return.
+*/
+typedef struct {
+    IR_Program *program;
+    const IR_Code *pc; // The call, which writes the returned value
+    int *frame;
+} IR_Frame;
+
+IR_InterpResult ir_interp_run(IR_Program *program, const long long budget) {
+    static const void *const HANDLERS[] = {
+        [IR_ADD] = &&op_add,       [IR_SUB] = &&op_sub,       [IR_MUL] = &&op_mul,       [IR_DIV] = &&op_div,
+        [IR_SHL] = &&op_shl,       [IR_SAR] = &&op_sar,       [IR_SHR] = &&op_shr,       [IR_LEA] = &&op_lea,
+        [IR_MULH] = &&op_mulh,     [IR_POW] = &&op_pow,       [IR_CMP_EQ] = &&op_cmp_eq, [IR_CMP_NE] = &&op_cmp_ne,
+        [IR_CMP_LT] = &&op_cmp_lt, [IR_CMP_LE] = &&op_cmp_le, [IR_CMP_GT] = &&op_cmp_gt, [IR_CMP_GE] = &&op_cmp_ge,
+        [IR_LOAD] = &&op_load,     [IR_STORE] = &&op_store,   [IR_SELECT] = &&op_select, [IR_RET] = &&op_ret,
+        [IR_BR] = &&op_br,         [IR_BR_EQ] = &&op_br_eq,   [IR_PARAM] = &&op_param,   [IR_ARG] = &&op_arg,
+        [IR_CALL] = &&op_call,     [IR_TAIL_CALL] = &&op_tail_call,
+    };
+    IR_InterpResult result = {IR_INTERP_OK, 0, 0};
+    long long executed = 0;
+    IR_Frame *calls = NULL; // Callers of the running function, innermost last
+    int depth = 0;
+    int capacity = 0;
+    const int *passed = NULL; // Arguments for the function being entered
+    int passed_count = 0;
+    int *released = NULL; // Frame of a tail call, freed once its arguments are copied
+    int *frame = NULL;
+    int *regs;
+    int *args;
+    const IR_Code *code;
+    const IR_Code *pc;
+
+enter:
+    if (!program->threaded) {
+        for (int i = 0; i < program->count; i++) {
+            IR_Code *instr = &program->code[i];
+            instr->handler = instr->op == IR_INTERP_END ? &&op_end : HANDLERS[instr->op];
+        }
+        program->threaded = true;
+    }
+
+    // A frame holds the parameters, then the registers, then the arguments for the next call
+    frame = calloc(program->param_count + program->reg_count + program->arg_count + 1, sizeof(int));
+    if (frame == NULL) {
+        printf("Failed to allocate interpreter registers\n");
+        exit(1);
+    }
+    const int copied = passed_count < program->param_count ? passed_count : program->param_count;
+    for (int i = 0; i < copied; i++) {
+        frame[i] = passed[i];
+    }
+    free(released);
+    released = NULL;
+    regs = frame + program->param_count;
+    args = regs + program->reg_count + 1;
+    code = program->code;
+    pc = code;
+
+#define DISPATCH()                                                                                                     \
+    do {                                                                                                               \
+        executed++;                                                                                                    \
+        goto *pc->handler;                                                                                             \
+    } while (0)
+#define NEXT()                                                                                                         \
+    do {                                                                                                               \
+        pc++;                                                                                                          \
+        DISPATCH();                                                                                                    \
+    } while (0)
+// Only a branch can start a loop, so the budget needs checking nowhere else
+#define BRANCHED()                                                                                                     \
+    do {                                                                                                               \
+        if (executed >= budget) {                                                                                      \
+            result.status = IR_INTERP_BUDGET;                                                                          \
+            goto done;                                                                                                 \
+        }                                                                                                              \
+        DISPATCH();                                                                                                    \
+    } while (0)
+#define BINARY(expr)                                                                                                   \
+    do {                                                                                                               \
+        const int a = regs[pc->a];                                                                                     \
+        const int b = regs[pc->b];                                                                                     \
+        regs[pc->dst] = (expr);                                                                                        \
+        NEXT();                                                                                                        \
+    } while (0)
+
+    DISPATCH();
+    // Arithmetic wraps like the compiled code, so it is done on unsigned values
+op_add:
+    BINARY((int)((unsigned)a + (unsigned)b));
+op_sub:
+    BINARY((int)((unsigned)a - (unsigned)b));
+op_mul:
+    BINARY((int)((unsigned)a * (unsigned)b));
+op_div: {
+    const int a = regs[pc->a];
+    const int b = regs[pc->b];
+    if (b == 0 || (a == -2147483647 - 1 && b == -1)) {
+        result.status = IR_INTERP_TRAP;
+        goto done;
+    }
+    regs[pc->dst] = a / b;
+    NEXT();
+}
+op_shl:
+    regs[pc->dst] = (int)((unsigned)regs[pc->a] << pc->b);
+    NEXT();
+op_sar:
+    regs[pc->dst] = regs[pc->a] >> pc->b;
+    NEXT();
+op_shr:
+    regs[pc->dst] = (int)((unsigned)regs[pc->a] >> pc->b);
+    NEXT();
+op_lea: {
+    const unsigned a = (unsigned)regs[pc->a];
+    regs[pc->dst] = (int)(a + (a << pc->b));
+    NEXT();
+}
+op_mulh:
+    BINARY((int)(((long long)a * b) >> 32));
+op_pow:
+    BINARY(ir_pow(a, b));
+op_cmp_eq:
+    BINARY(a == b);
+op_cmp_ne:
+    BINARY(a != b);
+op_cmp_lt:
+    BINARY(a < b);
+op_cmp_le:
+    BINARY(a <= b);
+op_cmp_gt:
+    BINARY(a > b);
+op_cmp_ge:
+    BINARY(a >= b);
+op_load:
+    regs[pc->dst] = pc->a;
+    NEXT();
+op_store:
+    regs[pc->dst] = regs[pc->a];
+    NEXT();
+op_select:
+    if (regs[pc->a] != 0) {
+        regs[pc->dst] = regs[pc->b];
+    }
+    NEXT();
+op_br:
+    pc = code + pc->dst;
+    BRANCHED();
+op_br_eq:
+    pc = code + (regs[pc->dst] != 0 ? pc->a : pc->b);
+    BRANCHED();
+op_param:
+    regs[pc->dst] = frame[pc->a];
+    NEXT();
+op_arg:
+    args[pc->b] = regs[pc->a];
+    NEXT();
+op_call: {
+    IR_Program *callee = program->callees[pc->a];
+    if (callee == NULL) {
+        printf("Undefined function %s\n", program->callee_names[pc->a]);
+        exit(1);
+    }
+    if (depth >= IR_INTERP_MAX_DEPTH) {
+        result.status = IR_INTERP_DEPTH;
+        goto done;
+    }
+    if (depth == capacity) {
+        capacity = capacity == 0 ? 16 : capacity * 2;
+        calls = realloc(calls, sizeof(IR_Frame) * capacity);
+        if (calls == NULL) {
+            printf("Failed to allocate interpreter calls\n");
+            exit(1);
+        }
+    }
+    // The caller is resumed from here when the callee returns, so calls take no C stack
+    calls[depth++] = (IR_Frame){program, pc, frame};
+    passed = args;
+    passed_count = pc->b;
+    program = callee;
+    goto enter;
+}
+op_tail_call: {
+    // The callee takes over this frame's place, so tail recursion runs in constant space.
+    // Tail calls can loop like branches, so they check the budget too
+    if (executed >= budget) {
+        result.status = IR_INTERP_BUDGET;
+        goto done;
+    }
+    IR_Program *callee = program->callees[pc->a];
+    if (callee == NULL) {
+        printf("Undefined function %s\n", program->callee_names[pc->a]);
+        exit(1);
+    }
+    passed = args;
+    passed_count = pc->b;
+    released = frame;
+    program = callee;
+    goto enter;
+}
+op_ret:
+    result.value = regs[pc->dst];
+    goto leave;
+op_end:
+    result.value = 0;
+leave:
+    free(frame);
+    frame = NULL;
+    if (depth == 0) {
+        goto done;
+    }
+    depth--;
+    program = calls[depth].program;
+    frame = calls[depth].frame;
+    regs = frame + program->param_count;
+    args = regs + program->reg_count + 1;
+    code = program->code;
+    pc = calls[depth].pc;
+    regs[pc->dst] = result.value;
+    NEXT();
+
+#undef BINARY
+#undef BRANCHED
+#undef NEXT
+#undef DISPATCH
+
+done:
+    result.executed = executed;
+    free(frame);
+    for (int i = 0; i < depth; i++) {
+        free(calls[i].frame);
+    }
+    free(calls);
+    return result;
+}
+
+IR_InterpResult ir_interp_module(const IR_Module *module, const char *name) {
+    for (int f = 0; f < module->count; f++) {
+        if (strcmp(module->functions[f]->name, name) == 0) {
+            IR_Program **programs = ir_interp_compile_module(module);
+            const IR_InterpResult result = ir_interp_run(programs[f], IR_INTERP_NO_BUDGET);
+            ir_interp_free_module(programs, module->count);
+            return result;
+        }
+    }
+    printf("Undefined function %s\n", name);
+    exit(1);
+}
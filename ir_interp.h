@@ -0,0 +1,86 @@
+#ifndef COMPILER_C_IR_INTERP_H
+#define COMPILER_C_IR_INTERP_H
+
+#include <limits.h>
+
+#include "ir.h"
+
+/*
+    Interpreter for IR functions, runs programs without generating any machine code.
+
+    A function is first decoded into flat bytecode, blocks laid end to end so falling through needs no instruction,
+    And branch targets resolved to bytecode indices.
+    The first run replaces each opcode with the address of its handler,
+    Every handler then jumps straight to the next one through computed goto (direct threading).
+    Registers live in a flat array of `next_reg` ints.
+    A call pushes the caller onto a stack of waiting calls and enters the callee in the same dispatch loop,
+    So deep recursion needs no C stack. A tail call replaces the running frame with the callee's instead.
+*/
+
+// Most calls nested at once, deeper recursion would overflow the stack of the compiled program too
+#ifndef IR_INTERP_MAX_DEPTH
+#define IR_INTERP_MAX_DEPTH (1 << 20)
+#endif
+
+// Falling off the end of the last block
+#define IR_INTERP_END (-1)
+
+typedef struct {
+    const void *handler; // Set when the program is threaded
+    int op;              // IR_OP, or IR_INTERP_END after the last block
+    int dst;
+    int a;
+    int b;
+} IR_Code;
+
+typedef struct IR_Program IR_Program;
+
+struct IR_Program {
+    IR_Code *code;
+    int count;
+    int reg_count;
+    int param_count;
+    int arg_count; // Most arguments passed by one call
+    bool threaded;
+    const char **callee_names;
+    IR_Program **callees; // Program of each callee, set by ir_interp_compile_module()
+};
+
+typedef enum {
+    IR_INTERP_OK,
+    IR_INTERP_TRAP,   // Division by zero or INT_MIN / -1, where the compiled program faults
+    IR_INTERP_BUDGET, // Ran out of its instruction budget
+    IR_INTERP_DEPTH,  // Nested more than IR_INTERP_MAX_DEPTH calls
+} IR_InterpStatus;
+
+#define IR_INTERP_NO_BUDGET LLONG_MAX
+
+typedef struct {
+    IR_InterpStatus status;
+    int value;          // Returned value, 0 if the function falls off its end
+    long long executed; // Bytecode instructions executed
+} IR_InterpResult;
+
+IR_Program *ir_interp_compile(const IR_Function *func);
+void ir_interp_free(IR_Program *program);
+
+/*
+    Compiles every function of the module and links each call to the callee's program,
+    Exits with an error if a callee is not in the module.
+*/
+IR_Program **ir_interp_compile_module(const IR_Module *module);
+void ir_interp_free_module(IR_Program **programs, int count);
+
+/*
+    Runs until the function returns or about `budget` instructions have executed,
+    The budget is only checked at branches, straight line code always runs to its end.
+    Parameters of the function are all 0.
+*/
+IR_InterpResult ir_interp_run(IR_Program *program, long long budget);
+
+/*
+    Compiles and runs the function named `name`, exits with an error if the module has none.
+*/
+IR_InterpResult ir_interp_module(const IR_Module *module, const char *name);
+
+#endif // COMPILER_C_IR_INTERP_H
@@ -0,0 +1,537 @@
+#include "ir_iv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+    A recurrence `reg == scale * basic + offset`, times `scale_reg` if it is not -1,
+    Kept up to date beside its basic IV.
+*/
+typedef struct {
+    int base;
+    int scale;
+    int offset;
+    int scale_reg;
+    int reg;
+    bool every_iteration; // Its multiply ran on every iteration, so `scale * basic` never overflows there
+} IV_Recurrence;
+
+/*
+    A compare of the basic IV against a constant, to be moved onto a recurrence.
+*/
+typedef struct {
+    int block;
+    int index;
+    IR_OP op;
+    int bound;
+} IV_Retarget;
+
+typedef struct {
+    int reg;
+    int base;
+    int scale;
+    int offset;
+    int scale_reg; // Invariant register multiplying the value or -1, nothing is derived further from such a value
+} IV_Form;
+
+static bool dominates_latches(const IR_CFG *cfg, const IR_Loop *loop, const int block) {
+    for (int i = 0; i < loop->latch_count; i++) {
+        if (!ir_cfg_dominates(cfg, block, loop->latches[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+    True if the loop can only be left through its header's test.
+*/
+static bool exits_at_header(const IR_Function *func, const IR_CFG *cfg, const IR_Loop *loop) {
+    for (int b = 0; b < func->block_count; b++) {
+        if (!loop->contains[b] || b == loop->header) {
+            continue;
+        }
+        const int term = ir_block_terminator(&func->blocks[b]);
+        if (term != -1 && (func->blocks[b].instructions[term].op == IR_RET ||
+                           func->blocks[b].instructions[term].op == IR_TAIL_CALL)) {
+            return false;
+        }
+        for (int s = 0; s < cfg->blocks[b].succ_count; s++) {
+            if (!loop->contains[cfg->blocks[b].succs[s]]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static int find_basic(const IR_IVInfo *info, const int reg) {
+    for (int i = 0; i < info->basic_count; i++) {
+        if (info->basic[i].reg == reg) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int find_def_before(const IR_Block *block, const int index, const int reg) {
+    for (int i = index - 1; i >= 0; i--) {
+        if (ir_instruction_def(&block->instructions[i]) == reg) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+    Matches `v + c`, `c + v` and `v - c` at `index`, giving the signed step.
+*/
+static bool constant_step(const IR_Block *block, const int index, const int v, int *step) {
+    const IR_Instruction *instr = &block->instructions[index];
+    if (instr->op == IR_ADD && instr->a == v) {
+        return ir_reg_const_at(block, index, instr->b, step);
+    }
+    if (instr->op == IR_ADD && instr->b == v) {
+        return ir_reg_const_at(block, index, instr->a, step);
+    }
+    if (instr->op == IR_SUB && instr->a == v && ir_reg_const_at(block, index, instr->b, step)) {
+        *step = (int)(0u - (unsigned)*step);
+        return true;
+    }
+    return false;
+}
+
+static void find_basic_ivs(const IR_Function *func, const IR_CFG *cfg, const int loop_index, IR_IVInfo *info) {
+    const IR_Loop *loop = &cfg->loops[loop_index];
+    int *defs = calloc(func->next_reg, sizeof(int));
+    if (defs == NULL) {
+        printf("Failed to allocate IV def counts\n");
+        exit(1);
+    }
+    for (int b = 0; b < func->block_count; b++) {
+        if (!loop->contains[b]) {
+            continue;
+        }
+        for (int i = 0; i < func->blocks[b].count; i++) {
+            const int d = ir_instruction_def(&func->blocks[b].instructions[i]);
+            if (d != -1) {
+                defs[d]++;
+            }
+        }
+    }
+
+    info->basic = malloc(sizeof(IR_BasicIV) * (func->next_reg + 1));
+    for (int b = 0; b < func->block_count; b++) {
+        // The update has to run exactly once per iteration
+        if (cfg->blocks[b].loop != loop_index || !dominates_latches(cfg, loop, b)) {
+            continue;
+        }
+        const IR_Block *block = &func->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            const IR_Instruction *store = &block->instructions[i];
+            if (store->op != IR_STORE || defs[store->dst] != 1) {
+                continue;
+            }
+            const int v = store->dst;
+            const int def = find_def_before(block, i, store->a);
+            if (def == -1) {
+                continue;
+            }
+            int k;
+            if (!constant_step(block, def, v, &k)) {
+                continue;
+            }
+            info->basic[info->basic_count++] = (IR_BasicIV){v, k, b, i};
+        }
+    }
+    free(defs);
+}
+
+static IV_Form *find_form(IV_Form *forms, const int count, const int reg) {
+    for (int i = count - 1; i >= 0; i--) {
+        if (forms[i].reg == reg) {
+            return &forms[i];
+        }
+    }
+    return NULL;
+}
+
+static bool operand_form(const IR_IVInfo *info, IV_Form *forms, const int count, const int reg, IV_Form *out) {
+    const int basic = find_basic(info, reg);
+    if (basic != -1) {
+        *out = (IV_Form){reg, basic, 1, 0, -1};
+        return true;
+    }
+    const IV_Form *form = find_form(forms, count, reg);
+    if (form != NULL && form->base != -1 && form->scale_reg == -1) {
+        *out = *form;
+        return true;
+    }
+    return false;
+}
+
+static void find_derived_ivs(const IR_Function *func, const IR_CFG *cfg, const int loop_index, IR_IVInfo *info) {
+    const IR_Loop *loop = &cfg->loops[loop_index];
+    int capacity = 8;
+    info->derived = malloc(sizeof(IR_DerivedIV) * capacity);
+    bool *written = calloc(func->next_reg + 1, sizeof(bool));
+    if (info->derived == NULL || written == NULL) {
+        printf("Failed to allocate derived IVs\n");
+        exit(1);
+    }
+    for (int b = 0; b < func->block_count; b++) {
+        for (int i = 0; i < func->blocks[b].count && loop->contains[b]; i++) {
+            const int d = ir_instruction_def(&func->blocks[b].instructions[i]);
+            if (d != -1) {
+                written[d] = true;
+            }
+        }
+    }
+    for (int b = 0; b < func->block_count; b++) {
+        if (!loop->contains[b]) {
+            continue;
+        }
+        const IR_Block *block = &func->blocks[b];
+        IV_Form *forms = malloc(sizeof(IV_Form) * (block->count + 1));
+        int form_count = 0;
+        for (int i = 0; i < block->count; i++) {
+            const IR_Instruction *instr = &block->instructions[i];
+            const int d = ir_instruction_def(instr);
+            if (d == -1) {
+                continue;
+            }
+            const int updated = instr->op == IR_STORE ? find_basic(info, d) : -1;
+            if (updated != -1) {
+                // Values computed from the old IV no longer match its recurrences
+                for (int f = 0; f < form_count; f++) {
+                    if (forms[f].base == updated) {
+                        forms[f].base = -1;
+                    }
+                }
+                continue;
+            }
+
+            IV_Form form = {d, -1, 0, 0, -1};
+            IV_Form x;
+            int k;
+            const bool is_arith = instr->op == IR_ADD || instr->op == IR_SUB || instr->op == IR_MUL;
+            if (is_arith && operand_form(info, forms, form_count, instr->a, &x) && ir_reg_const_at(block, i, instr->b, &k)) {
+                form.base = x.base;
+                if (instr->op == IR_MUL) {
+                    form.scale = (int)((unsigned)x.scale * (unsigned)k);
+                    form.offset = (int)((unsigned)x.offset * (unsigned)k);
+                } else {
+                    form.scale = x.scale;
+                    form.offset = (int)(instr->op == IR_ADD ? (unsigned)x.offset + (unsigned)k : (unsigned)x.offset - (unsigned)k);
+                }
+            } else if ((instr->op == IR_ADD || instr->op == IR_MUL) && operand_form(info, forms, form_count, instr->b, &x) &&
+                       ir_reg_const_at(block, i, instr->a, &k)) {
+                form.base = x.base;
+                if (instr->op == IR_MUL) {
+                    form.scale = (int)((unsigned)x.scale * (unsigned)k);
+                    form.offset = (int)((unsigned)x.offset * (unsigned)k);
+                } else {
+                    form.scale = x.scale;
+                    form.offset = (int)((unsigned)x.offset + (unsigned)k);
+                }
+            } else if (instr->op == IR_MUL && !written[instr->b] &&
+                       operand_form(info, forms, form_count, instr->a, &x)) {
+                form = (IV_Form){d, x.base, x.scale, x.offset, instr->b};
+            } else if (instr->op == IR_MUL && !written[instr->a] &&
+                       operand_form(info, forms, form_count, instr->b, &x)) {
+                form = (IV_Form){d, x.base, x.scale, x.offset, instr->a};
+            }
+            forms[form_count++] = form;
+
+            if (form.base != -1 && instr->op == IR_MUL) {
+                if (info->derived_count >= capacity) {
+                    capacity *= 2;
+                    info->derived = realloc(info->derived, sizeof(IR_DerivedIV) * capacity);
+                    if (info->derived == NULL) {
+                        printf("Failed to allocate derived IVs\n");
+                        exit(1);
+                    }
+                }
+                info->derived[info->derived_count++] =
+                    (IR_DerivedIV){b, i, form.base, form.scale, form.offset, form.scale_reg};
+            }
+        }
+        free(forms);
+    }
+    free(written);
+}
+
+IR_IVInfo ir_iv_analyze(const IR_Function *func, const IR_CFG *cfg, const int loop) {
+    IR_IVInfo info = {NULL, 0, NULL, 0};
+    find_basic_ivs(func, cfg, loop, &info);
+    find_derived_ivs(func, cfg, loop, &info);
+    return info;
+}
+
+void ir_iv_free(IR_IVInfo *info) {
+    free(info->basic);
+    free(info->derived);
+    info->basic = NULL;
+    info->derived = NULL;
+    info->basic_count = 0;
+    info->derived_count = 0;
+}
+
+static int find_store(const IR_Block *block, const int reg) {
+    for (int i = 0; i < block->count; i++) {
+        if (block->instructions[i].op == IR_STORE && block->instructions[i].dst == reg) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int insertion_point(const IR_Block *block) {
+    const int term = ir_block_terminator(block);
+    return term == -1 ? block->count : term;
+}
+
+/*
+    Emits `reg = scale * basic + offset` at the end of the preheader
+    and `reg = reg + scale * step` straight after the basic IV's update.
+    A register scale multiplies both, the step once in the preheader as the register does not change in the loop.
+*/
+static void emit_recurrence(IR_Function *func, const IR_Loop *loop, const IR_BasicIV *basic, const IV_Recurrence *rec) {
+    IR_Block *preheader = &func->blocks[loop->preheader];
+    int at = insertion_point(preheader);
+    const int scale_reg = func->next_reg++;
+    const int init_reg = func->next_reg++;
+    ir_insert_instruction(preheader, at++, &(IR_Instruction){IR_LOAD, scale_reg, rec->scale, 0});
+    ir_insert_instruction(preheader, at++, &(IR_Instruction){IR_MUL, init_reg, basic->reg, scale_reg});
+    int value_reg = init_reg;
+    if (rec->offset != 0) {
+        const int offset_reg = func->next_reg++;
+        value_reg = func->next_reg++;
+        ir_insert_instruction(preheader, at++, &(IR_Instruction){IR_LOAD, offset_reg, rec->offset, 0});
+        ir_insert_instruction(preheader, at++, &(IR_Instruction){IR_ADD, value_reg, init_reg, offset_reg});
+    }
+    const int step_reg = func->next_reg++;
+    const int step = (int)((unsigned)rec->scale * (unsigned)basic->step);
+    if (rec->scale_reg != -1) {
+        const int scaled_reg = func->next_reg++;
+        const int step_const_reg = func->next_reg++;
+        ir_insert_instruction(preheader, at++, &(IR_Instruction){IR_MUL, scaled_reg, value_reg, rec->scale_reg});
+        ir_insert_instruction(preheader, at++, &(IR_Instruction){IR_LOAD, step_const_reg, step, 0});
+        ir_insert_instruction(preheader, at++, &(IR_Instruction){IR_MUL, step_reg, step_const_reg, rec->scale_reg});
+        value_reg = scaled_reg;
+    }
+    ir_insert_instruction(preheader, at, &(IR_Instruction){IR_STORE, rec->reg, value_reg, 0});
+
+    IR_Block *update = &func->blocks[basic->update_block];
+    at = find_store(update, basic->reg) + 1;
+    const int next_reg = func->next_reg++;
+    if (rec->scale_reg == -1) {
+        ir_insert_instruction(update, at++, &(IR_Instruction){IR_LOAD, step_reg, step, 0});
+    }
+    ir_insert_instruction(update, at++, &(IR_Instruction){IR_ADD, next_reg, rec->reg, step_reg});
+    ir_insert_instruction(update, at, &(IR_Instruction){IR_STORE, rec->reg, next_reg, 0});
+}
+
+static bool fits_int(const long long v) { return v >= -2147483647LL - 1 && v <= 2147483647LL; }
+
+/*
+    Checks whether `cmp`, comparing the basic IV against a constant, can compare the recurrence instead.
+    Equality only needs `scale * bound` to be exact, ordered compares also need every value the IV is
+    tested with to scale without overflow: a known initial value, and an exit taken within one step of the bound.
+*/
+static bool plan_retarget(const IR_Block *block, const int index, const IR_BasicIV *basic, const IV_Recurrence *rec,
+                          const bool initial_known, const int initial, IV_Retarget *out) {
+    const IR_Instruction *cmp = &block->instructions[index];
+    IR_OP op;
+    int k;
+    if (cmp->a == basic->reg && cmp->b != basic->reg && ir_reg_const_at(block, index, cmp->b, &k)) {
+        op = cmp->op;
+    } else if (cmp->b == basic->reg && cmp->a != basic->reg && ir_reg_const_at(block, index, cmp->a, &k)) {
+        op = ir_compare_swap(cmp->op);
+    } else {
+        return false;
+    }
+    const long long scale = rec->scale;
+    if (!fits_int(scale * k)) {
+        return false;
+    }
+    const bool exact = rec->every_iteration || (rec->scale & 1);
+    if (op != IR_CMP_EQ && op != IR_CMP_NE) {
+        const bool increasing = basic->step > 0 && (op == IR_CMP_LT || op == IR_CMP_LE);
+        const bool decreasing = basic->step < 0 && (op == IR_CMP_GT || op == IR_CMP_GE);
+        if (!rec->every_iteration || !initial_known || !fits_int(scale * initial) || !(increasing || decreasing) ||
+            !fits_int(scale * ((long long)k + basic->step))) {
+            return false;
+        }
+        if (rec->scale < 0) {
+            op = ir_compare_swap(op);
+        }
+    } else if (!exact) {
+        return false;
+    }
+    *out = (IV_Retarget){-1, index, op, (int)(scale * k)};
+    return true;
+}
+
+/*
+    Moves the exit tests of a basic IV onto a recurrence and drops the IV's update,
+    Only if nothing else in the loop or after it reads the IV.
+*/
+static bool eliminate_basic_iv(IR_Function *func, const IR_CFG *cfg, const IR_Loop *loop, const IR_BasicIV *basic,
+                               const IV_Recurrence *rec) {
+    IR_Block *update = &func->blocks[basic->update_block];
+    const int store = find_store(update, basic->reg);
+    const int step_reg = update->instructions[store].a;
+
+    const IR_Block *preheader = &func->blocks[loop->preheader];
+    int initial = 0;
+    const bool initial_known = ir_reg_const_at(preheader, insertion_point(preheader), basic->reg, &initial);
+    const bool exact = rec->every_iteration || (rec->scale & 1);
+
+    IV_Retarget *retargets = NULL;
+    int retarget_count = 0;
+    bool ok = true;
+    for (int b = 0; b < func->block_count && ok; b++) {
+        if (!loop->contains[b]) {
+            continue;
+        }
+        const IR_Block *block = &func->blocks[b];
+        for (int i = 0; i < block->count && ok; i++) {
+            const IR_Instruction *instr = &block->instructions[i];
+            int uses[IR_MAX_USES];
+            const int use_count = ir_instruction_uses(instr, uses);
+            bool reads_iv = false;
+            for (int u = 0; u < use_count; u++) {
+                reads_iv |= uses[u] == basic->reg;
+            }
+            if (!reads_iv || (b == basic->update_block && ir_instruction_def(instr) == step_reg)) {
+                continue;
+            }
+            if (instr->op == IR_BR_EQ) {
+                ok = exact;
+                continue;
+            }
+            IV_Retarget retarget;
+            if (!ir_is_compare(instr->op) || !plan_retarget(block, i, basic, rec, initial_known, initial, &retarget)) {
+                ok = false;
+                continue;
+            }
+            retarget.block = b;
+            retargets = realloc(retargets, sizeof(IV_Retarget) * (retarget_count + 1));
+            if (retargets == NULL) {
+                printf("Failed to allocate IV retargets\n");
+                exit(1);
+            }
+            retargets[retarget_count++] = retarget;
+        }
+    }
+
+    if (ok) {
+        IR_Liveness *live = ir_liveness_build(func, cfg);
+        for (int b = 0; b < func->block_count && ok; b++) {
+            if (!loop->contains[b]) {
+                continue;
+            }
+            for (int s = 0; s < cfg->blocks[b].succ_count; s++) {
+                const int succ = cfg->blocks[b].succs[s];
+                if (!loop->contains[succ] && ir_live_in(live, succ, basic->reg)) {
+                    ok = false;
+                }
+            }
+        }
+        ir_liveness_free(live);
+    }
+    if (!ok) {
+        free(retargets);
+        return false;
+    }
+
+    for (int b = 0; b < func->block_count; b++) {
+        if (!loop->contains[b]) {
+            continue;
+        }
+        for (int i = 0; i < func->blocks[b].count; i++) {
+            IR_Instruction *instr = &func->blocks[b].instructions[i];
+            if (instr->op == IR_BR_EQ && instr->dst == basic->reg) {
+                instr->dst = rec->reg;
+            }
+        }
+    }
+    // Later compares in the same block shift down as bound loads are inserted
+    for (int r = retarget_count - 1; r >= 0; r--) {
+        IR_Block *block = &func->blocks[retargets[r].block];
+        const int bound_reg = func->next_reg++;
+        IR_Instruction *cmp = &block->instructions[retargets[r].index];
+        *cmp = (IR_Instruction){retargets[r].op, cmp->dst, rec->reg, bound_reg};
+        ir_insert_instruction(block, retargets[r].index, &(IR_Instruction){IR_LOAD, bound_reg, retargets[r].bound, 0});
+    }
+    free(retargets);
+    ir_remove_instruction(update, find_store(update, basic->reg));
+    return true;
+}
+
+static bool reduce_loop(IR_Function *func, const IR_CFG *cfg, const int loop_index) {
+    const IR_Loop *loop = &cfg->loops[loop_index];
+    if (loop->preheader == -1) {
+        return false;
+    }
+    IR_IVInfo info = ir_iv_analyze(func, cfg, loop_index);
+    if (info.derived_count == 0) {
+        ir_iv_free(&info);
+        return false;
+    }
+
+    const bool single_exit = exits_at_header(func, cfg, loop);
+    IV_Recurrence *recs = malloc(sizeof(IV_Recurrence) * info.derived_count);
+    int rec_count = 0;
+    for (int i = 0; i < info.derived_count; i++) {
+        const IR_DerivedIV *derived = &info.derived[i];
+        IV_Recurrence *rec = NULL;
+        for (int r = 0; r < rec_count; r++) {
+            if (recs[r].base == derived->base && recs[r].scale == derived->scale && recs[r].offset == derived->offset &&
+                recs[r].scale_reg == derived->scale_reg) {
+                rec = &recs[r];
+            }
+        }
+        if (rec == NULL) {
+            rec = &recs[rec_count++];
+            *rec = (IV_Recurrence){derived->base, derived->scale, derived->offset, derived->scale_reg,
+                                   func->next_reg++, false};
+        }
+        // If the multiply runs on every iteration the original program never overflows it,
+        // so the recurrence orders and compares exactly like the basic IV on every tested value.
+        rec->every_iteration = rec->every_iteration || (single_exit && dominates_latches(cfg, loop, derived->block));
+        IR_Instruction *instr = &func->blocks[derived->block].instructions[derived->index];
+        *instr = (IR_Instruction){IR_STORE, instr->dst, rec->reg, 0};
+    }
+
+    for (int r = 0; r < rec_count; r++) {
+        emit_recurrence(func, loop, &info.basic[recs[r].base], &recs[r]);
+    }
+
+    for (int b = 0; b < info.basic_count; b++) {
+        for (int r = 0; r < rec_count; r++) {
+            const IV_Recurrence *rec = &recs[r];
+            // Exit tests can only move onto a recurrence whose scale is known
+            if (rec->base == b && rec->scale != 0 && rec->offset == 0 && rec->scale_reg == -1 &&
+                eliminate_basic_iv(func, cfg, loop, &info.basic[b], rec)) {
+                break;
+            }
+        }
+    }
+
+    free(recs);
+    ir_iv_free(&info);
+    return true;
+}
+
+bool ir_iv_strength_reduce(IR_Function *func) {
+    bool changed = ir_cfg_insert_preheaders(func);
+    // Rewrites only add instructions within blocks, so the loop forest stays valid throughout
+    IR_CFG *cfg = ir_cfg_build(func);
+    for (int i = 0; i < cfg->loop_count; i++) {
+        changed |= reduce_loop(func, cfg, i);
+    }
+    ir_cfg_free(cfg);
+    return changed;
+}
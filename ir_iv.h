@@ -0,0 +1,49 @@
+#ifndef COMPILER_C_IR_IV_H
+#define COMPILER_C_IR_IV_H
+
+#include "ir.h"
+#include "ir_cfg.h"
+
+/*
+    Induction variable analysis over the loop forest.
+
+    A basic IV is a variable whose only write in the loop is `v = v + c` (or `v - c`),
+    executed exactly once per iteration.
+    A derived IV is a value of the form `scale * v + offset` for some basic IV `v`,
+    Or such a value times a register the loop does not write.
+*/
+
+typedef struct {
+    int reg;
+    int step; // Added to reg once per iteration
+    int update_block;
+    int update_index; // The STORE writing reg
+} IR_BasicIV;
+
+typedef struct {
+    int block;
+    int index; // Instruction computing the derived value
+    int base;  // Index into IR_IVInfo.basic
+    int scale;
+    int offset;
+    int scale_reg; // Loop-invariant register the value is multiplied by, -1 if there is none
+} IR_DerivedIV;
+
+typedef struct {
+    IR_BasicIV *basic;
+    int basic_count;
+    IR_DerivedIV *derived;
+    int derived_count;
+} IR_IVInfo;
+
+IR_IVInfo ir_iv_analyze(const IR_Function *func, const IR_CFG *cfg, int loop);
+void ir_iv_free(IR_IVInfo *info);
+
+/*
+    Rewrites multiplications of induction variables by constants or loop-invariant registers into additive recurrences,
+    Then retargets loop exit tests onto the new recurrences so the basic IV can be removed when nothing else needs it.
+    Returns true if the function changed.
+*/
+bool ir_iv_strength_reduce(IR_Function *func);
+
+#endif // COMPILER_C_IR_IV_H
@@ -0,0 +1,337 @@
+#include "ir_layout.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+    Dempster-Shafer combination of two independent predictions of the same outcome.
+*/
+static double combine(const double p, const double q) { return p * q / (p * q + (1 - p) * (1 - q)); }
+
+/*
+    Folds in a heuristic predicting whichever successor it holds for, nothing if it holds for both or neither.
+*/
+static double apply(const double taken, const bool first, const bool second, const double prob) {
+    if (first == second) {
+        return taken;
+    }
+    return combine(taken, first ? prob : 1 - prob);
+}
+
+static bool contains_op(const IR_Block *block, const IR_OP op) {
+    for (int i = 0; i < block->count; i++) {
+        if (block->instructions[i].op == op) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+    Whether the edge from `block` to `succ` goes back to the header of a loop containing `block`.
+*/
+static bool is_back_edge(const IR_CFG *cfg, const int block, const int succ) {
+    for (int l = cfg->blocks[block].loop; l != -1; l = cfg->loops[l].parent) {
+        if (cfg->loops[l].header == succ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+    Whether `succ` is the header or preheader of a loop `block` is outside of.
+*/
+static bool enters_loop(const IR_CFG *cfg, const int block, const int succ) {
+    for (int l = 0; l < cfg->loop_count; l++) {
+        const IR_Loop *loop = &cfg->loops[l];
+        if ((loop->header == succ || loop->preheader == succ) && !loop->contains[block]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+    Index of the last instruction before `before` defining `reg`, -1 if the block has none.
+*/
+static int find_def(const IR_Block *block, const int before, const int reg) {
+    for (int i = before - 1; i >= 0; i--) {
+        if (ir_instruction_def(&block->instructions[i]) == reg) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+    Whether `reg` holds a constant no greater than zero at instruction `before`.
+*/
+static bool is_non_positive(const IR_Block *block, const int before, const int reg) {
+    const int def = find_def(block, before, reg);
+    return def != -1 && block->instructions[def].op == IR_LOAD && block->instructions[def].a <= 0;
+}
+
+/*
+    Probability of the branch ending block `b` going to its first successor.
+*/
+static double predict_branch(const IR_Function *func, const IR_CFG *cfg, const int b) {
+    const IR_Block *block = &func->blocks[b];
+    const int s0 = cfg->blocks[b].succs[0];
+    const int s1 = cfg->blocks[b].succs[1];
+    double taken = 0.5;
+
+    const bool back0 = is_back_edge(cfg, b, s0);
+    const bool back1 = is_back_edge(cfg, b, s1);
+    taken = apply(taken, back0, back1, IR_PROB_LOOP_BRANCH);
+    const int loop = cfg->blocks[b].loop;
+    if (loop != -1 && !back0 && !back1) {
+        const bool *contains = cfg->loops[loop].contains;
+        taken = apply(taken, contains[s0], contains[s1], IR_PROB_LOOP_EXIT);
+    }
+    taken = apply(taken, enters_loop(cfg, b, s0), enters_loop(cfg, b, s1), IR_PROB_LOOP_HEADER);
+
+    const bool calls0 = contains_op(&func->blocks[s0], IR_CALL) && !ir_cfg_post_dominates(cfg, s0, b);
+    const bool calls1 = contains_op(&func->blocks[s1], IR_CALL) && !ir_cfg_post_dominates(cfg, s1, b);
+    taken = apply(taken, !calls0, !calls1, IR_PROB_CALL);
+    const bool returns0 = cfg->blocks[s0].succ_count == 0;
+    const bool returns1 = cfg->blocks[s1].succ_count == 0;
+    taken = apply(taken, !returns0, !returns1, IR_PROB_RETURN);
+
+    // Equality rarely holds and values are rarely negative
+    const int term = ir_block_terminator(block);
+    const int def = find_def(block, term, block->instructions[term].dst);
+    if (def != -1) {
+        const IR_Instruction *cmp = &block->instructions[def];
+        const bool fails = cmp->op == IR_CMP_EQ ||
+                           ((cmp->op == IR_CMP_LT || cmp->op == IR_CMP_LE) && is_non_positive(block, def, cmp->b)) ||
+                           ((cmp->op == IR_CMP_GT || cmp->op == IR_CMP_GE) && is_non_positive(block, def, cmp->a));
+        const bool holds = cmp->op == IR_CMP_NE;
+        taken = apply(taken, holds, fails, IR_PROB_OPCODE);
+    }
+    return taken;
+}
+
+double ir_edge_probability(const IR_Profile *profile, const int block, const int succ) {
+    return succ == 0 ? profile->taken[block] : 1 - profile->taken[block];
+}
+
+static double probability_to(const IR_Profile *profile, const IR_CFG *cfg, const int from, const int to) {
+    return cfg->blocks[from].succs[0] == to ? profile->taken[from] : 1 - profile->taken[from];
+}
+
+/*
+    Frequencies of the blocks `contains` marks (all reachable ones if NULL) relative to one entry of `head`,
+    Inner loops already having their chance of coming back round in `cyclic`.
+    For a loop, its own chance is then worked out from how often its back edges run.
+*/
+static void propagate(IR_Profile *profile, const IR_CFG *cfg, const int head, const bool *contains, double *cyclic) {
+    for (int i = 0; i < cfg->rpo_count; i++) {
+        const int b = cfg->rpo_order[i];
+        if (contains != NULL && !contains[b]) {
+            continue;
+        }
+        double freq = 1;
+        if (b != head) {
+            freq = 0;
+            for (int j = 0; j < cfg->blocks[b].pred_count; j++) {
+                const int p = cfg->blocks[b].preds[j];
+                // Back edges are what the cyclic probability stands for
+                if (cfg->blocks[p].rpo == -1 || (contains != NULL && !contains[p]) || ir_cfg_dominates(cfg, b, p)) {
+                    continue;
+                }
+                freq += profile->freq[p] * probability_to(profile, cfg, p, b);
+            }
+        }
+        profile->freq[b] = freq / (1 - cyclic[b]);
+    }
+    if (contains == NULL) {
+        return;
+    }
+    double back = 0;
+    for (int j = 0; j < cfg->blocks[head].pred_count; j++) {
+        const int p = cfg->blocks[head].preds[j];
+        if (contains[p] && ir_cfg_dominates(cfg, head, p)) {
+            back += profile->freq[p] * probability_to(profile, cfg, p, head);
+        }
+    }
+    cyclic[head] = back < IR_PROB_MAX_CYCLIC ? back : IR_PROB_MAX_CYCLIC;
+}
+
+IR_Profile *ir_profile_build(const IR_Function *func, const IR_CFG *cfg) {
+    IR_Profile *profile = malloc(sizeof(IR_Profile));
+    double *taken = malloc(sizeof(double) * (func->block_count + 1));
+    double *freq = calloc(func->block_count + 1, sizeof(double));
+    double *cyclic = calloc(func->block_count + 1, sizeof(double));
+    if (profile == NULL || taken == NULL || freq == NULL || cyclic == NULL) {
+        printf("Failed to allocate block profile\n");
+        exit(1);
+    }
+    profile->block_count = func->block_count;
+    profile->taken = taken;
+    profile->freq = freq;
+    for (int b = 0; b < func->block_count; b++) {
+        taken[b] = cfg->blocks[b].rpo != -1 && cfg->blocks[b].succ_count == 2 ? predict_branch(func, cfg, b) : 1;
+    }
+    for (int l = 0; l < cfg->loop_count; l++) {
+        propagate(profile, cfg, cfg->loops[l].header, cfg->loops[l].contains, cyclic);
+    }
+    if (cfg->rpo_count > 0) {
+        propagate(profile, cfg, cfg->rpo_order[0], NULL, cyclic);
+    }
+    free(cyclic);
+    return profile;
+}
+
+void ir_profile_free(IR_Profile *profile) {
+    free(profile->taken);
+    free(profile->freq);
+    free(profile);
+}
+
+typedef struct {
+    int from;
+    int to;
+    double weight;
+} IR_LayoutEdge;
+
+static int compare_edges(const void *a, const void *b) {
+    const IR_LayoutEdge *x = a;
+    const IR_LayoutEdge *y = b;
+    if (x->weight != y->weight) {
+        return x->weight > y->weight ? -1 : 1;
+    }
+    // Equally heavy edges keep the fallthroughs of the original order
+    const bool x_next = x->to == x->from + 1;
+    const bool y_next = y->to == y->from + 1;
+    if (x_next != y_next) {
+        return x_next ? -1 : 1;
+    }
+    return x->from != y->from ? x->from - y->from : x->to - y->to;
+}
+
+/*
+    The block order, each chain of fallthroughs kept together and the chain falling off the end of the function last.
+*/
+static int *layout_order(const IR_Function *func, const IR_CFG *cfg, const IR_Profile *profile) {
+    const int count = func->block_count;
+    IR_LayoutEdge *edges = malloc(sizeof(IR_LayoutEdge) * (2 * count + 1));
+    int *next = malloc(sizeof(int) * count);
+    int *prev = malloc(sizeof(int) * count);
+    int *chain = malloc(sizeof(int) * count);
+    double *connection = malloc(sizeof(double) * count);
+    bool *placed = calloc(count, sizeof(bool));
+    int *order = malloc(sizeof(int) * count);
+    if (edges == NULL || next == NULL || prev == NULL || chain == NULL || connection == NULL || placed == NULL ||
+        order == NULL) {
+        printf("Failed to allocate block layout\n");
+        exit(1);
+    }
+    int edge_count = 0;
+    for (int b = 0; b < count; b++) {
+        next[b] = -1;
+        prev[b] = -1;
+        chain[b] = b;
+        for (int s = 0; s < cfg->blocks[b].succ_count; s++) {
+            const double weight = profile->freq[b] * ir_edge_probability(profile, b, s);
+            edges[edge_count++] = (IR_LayoutEdge){b, cfg->blocks[b].succs[s], weight};
+        }
+    }
+    qsort(edges, edge_count, sizeof(IR_LayoutEdge), compare_edges);
+
+    // Heaviest edges first become fallthroughs, joining the chain ending at their source to the one they start
+    for (int e = 0; e < edge_count; e++) {
+        const int from = edges[e].from;
+        const int to = edges[e].to;
+        if (next[from] != -1 || prev[to] != -1 || to == 0 || chain[from] == chain[to]) {
+            continue;
+        }
+        next[from] = to;
+        prev[to] = from;
+        for (int b = to; b != -1; b = next[b]) {
+            chain[b] = chain[from];
+        }
+    }
+
+    // A last block without a terminator returns by falling off the end, so its chain goes last
+    // Unless it is the entry's, when ir_place_blocks() gives it a return
+    const int last = count - 1;
+    const int end_chain = ir_block_terminator(&func->blocks[last]) == -1 ? chain[last] : -1;
+    int placed_count = 0;
+    int pick = chain[0];
+    while (pick != -1) {
+        placed[pick] = true;
+        for (int b = pick; b != -1; b = next[b]) {
+            order[placed_count++] = b;
+        }
+        // Next is the chain most heavily connected to what is already placed, the earliest one if none is
+        for (int b = 0; b < count; b++) {
+            connection[b] = 0;
+        }
+        for (int e = 0; e < edge_count; e++) {
+            const int from = chain[edges[e].from];
+            const int to = chain[edges[e].to];
+            if (placed[from] != placed[to]) {
+                connection[placed[from] ? to : from] += edges[e].weight;
+            }
+        }
+        pick = -1;
+        for (int b = 0; b < count; b++) {
+            if (chain[b] != b || placed[b] || b == end_chain) {
+                continue;
+            }
+            if (pick == -1 || connection[b] > connection[pick]) {
+                pick = b;
+            }
+        }
+        if (pick == -1 && end_chain != -1 && !placed[end_chain]) {
+            pick = end_chain;
+        }
+    }
+    free(edges);
+    free(next);
+    free(prev);
+    free(chain);
+    free(connection);
+    free(placed);
+    return order;
+}
+
+bool ir_place_blocks(IR_Function *func) {
+    if (func->block_count < 2) {
+        return false;
+    }
+    IR_CFG *cfg = ir_cfg_build(func);
+    IR_Profile *profile = ir_profile_build(func, cfg);
+    int *order = layout_order(func, cfg, profile);
+    ir_profile_free(profile);
+    ir_cfg_free(cfg);
+
+    bool changed = false;
+    for (int i = 0; i < func->block_count; i++) {
+        changed |= order[i] != i;
+    }
+    if (!changed) {
+        free(order);
+        return false;
+    }
+    // Chained into the entry's chain, a last block falling off the end can end up before other blocks
+    const int last = func->block_count - 1;
+    if (order[last] != last && ir_block_terminator(&func->blocks[last]) == -1) {
+        const int zero = func->next_reg++;
+        ir_append_instruction(&func->blocks[last], &(IR_Instruction){IR_LOAD, zero, 0, 0});
+        ir_append_instruction(&func->blocks[last], &(IR_Instruction){IR_RET, zero, 0, 0});
+    }
+    for (int i = 0; i < func->block_count; i++) {
+        const int b = order[i];
+        const bool next_follows = i + 1 < func->block_count && order[i + 1] == b + 1;
+        if (b + 1 < func->block_count && !next_follows && ir_block_terminator(&func->blocks[b]) == -1) {
+            ir_append_instruction(&func->blocks[b], &(IR_Instruction){IR_BR, b + 1, 0, 0});
+        }
+    }
+    free(func->placement);
+    func->placement = order;
+    func->placed_count = func->block_count;
+    ir_layout_blocks(func);
+    return true;
+}
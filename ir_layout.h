@@ -0,0 +1,49 @@
+#ifndef COMPILER_C_IR_LAYOUT_H
+#define COMPILER_C_IR_LAYOUT_H
+
+#include "ir_cfg.h"
+
+/*
+    Static branch prediction and block placement.
+
+    Each two way branch gets a probability from Ball and Larus' heuristics, combined Dempster-Shafer style:
+    Back edges are taken, loops are not left, loop headers are entered, and calls and returns are avoided,
+    As are equality tests and tests for negative values.
+    Block frequencies follow from the probabilities innermost loop first, as in Wu and Larus,
+    A loop header runs 1 / (1 - p) times per entry where p is the chance of coming back round.
+    ir_place_blocks() then lays blocks out Pettis-Hansen style,
+    Chaining the heaviest edges into fallthroughs and placing the chains hottest connection first.
+*/
+
+// Probability of the predicted successor under each heuristic
+#define IR_PROB_LOOP_BRANCH 0.88
+#define IR_PROB_LOOP_EXIT 0.80
+#define IR_PROB_LOOP_HEADER 0.75
+#define IR_PROB_CALL 0.78
+#define IR_PROB_RETURN 0.72
+#define IR_PROB_OPCODE 0.84
+// Loops are assumed to come back round at most this often, keeping frequencies finite
+#define IR_PROB_MAX_CYCLIC 0.99
+
+typedef struct {
+    int block_count;
+    double *taken; // Probability of taking each reachable block's first successor, 1 if it has no second
+    double *freq;  // Expected executions of each block per call, 0 for unreachable blocks
+} IR_Profile;
+
+IR_Profile *ir_profile_build(const IR_Function *func, const IR_CFG *cfg);
+void ir_profile_free(IR_Profile *profile);
+
+/*
+    Probability of block `block` going on to its successor number `succ` in the CFG.
+*/
+double ir_edge_probability(const IR_Profile *profile, int block, int succ);
+
+/*
+    Reorders the blocks so likely successors follow their predecessors, keeping the entry block first.
+    A block that fell through to a block now elsewhere branches to it instead.
+    Returns true if the order changed.
+*/
+bool ir_place_blocks(IR_Function *func);
+
+#endif // COMPILER_C_IR_LAYOUT_H
@@ -0,0 +1,208 @@
+#include "ir_opt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ir_cfg.h"
+#include "ir_combine.h"
+#include "ir_eval.h"
+#include "ir_ifconv.h"
+#include "ir_inline.h"
+#include "ir_iv.h"
+#include "ir_layout.h"
+#include "ir_rotate.h"
+#include "ir_tail.h"
+
+static bool is_pure(const IR_OP op) {
+    switch (op) {
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_DIV:
+    case IR_SHL:
+    case IR_SAR:
+    case IR_SHR:
+    case IR_LEA:
+    case IR_MULH:
+    case IR_POW:
+    case IR_CMP_EQ:
+    case IR_CMP_NE:
+    case IR_CMP_LT:
+    case IR_CMP_LE:
+    case IR_CMP_GT:
+    case IR_CMP_GE:
+    case IR_LOAD:
+    case IR_STORE:
+    case IR_SELECT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool ir_eliminate_dead_code(IR_Function *func) {
+    bool changed = false;
+    bool removed = true;
+    bool *live = malloc(sizeof(bool) * (func->next_reg + 1));
+    if (live == NULL) {
+        printf("Failed to allocate live registers\n");
+        exit(1);
+    }
+    while (removed) {
+        removed = false;
+        IR_CFG *cfg = ir_cfg_build(func);
+        IR_Liveness *liveness = ir_liveness_build(func, cfg);
+        // Walk each block backwards from what its successors need, registers are reused so a write is dead when
+        // nothing reads it before the next write rather than when the register is never read at all
+        for (int b = 0; b < func->block_count; b++) {
+            IR_Block *block = &func->blocks[b];
+            for (int r = 0; r < func->next_reg; r++) {
+                live[r] = ir_live_out(liveness, b, r);
+            }
+            // Nothing after the terminator runs, so its writes must not hide the ones before it
+            const int term = ir_block_terminator(block);
+            const int end = term == -1 ? block->count : term + 1;
+            for (int i = end - 1; i >= 0; i--) {
+                const IR_Instruction *instr = &block->instructions[i];
+                const int def = ir_instruction_def(instr);
+                if (is_pure(instr->op) && !live[def]) {
+                    ir_remove_instruction(block, i);
+                    removed = true;
+                    changed = true;
+                    continue;
+                }
+                if (def != -1) {
+                    live[def] = false;
+                }
+                int uses[IR_MAX_USES];
+                const int use_count = ir_instruction_uses(instr, uses);
+                for (int u = 0; u < use_count; u++) {
+                    live[uses[u]] = true;
+                }
+            }
+        }
+        ir_liveness_free(liveness);
+        ir_cfg_free(cfg);
+    }
+    free(live);
+    return changed;
+}
+
+static bool reads_or_writes(const IR_Instruction *instr, const int reg) {
+    int uses[IR_MAX_USES];
+    const int use_count = ir_instruction_uses(instr, uses);
+    bool found = ir_instruction_def(instr) == reg;
+    for (int u = 0; u < use_count; u++) {
+        found |= uses[u] == reg;
+    }
+    return found;
+}
+
+/*
+    The only successor of block `a` the register is live into, provided `a` is that block's only predecessor.
+    -1 if there is no such successor.
+*/
+static int sink_target(const IR_CFG *cfg, const IR_Liveness *liveness, const int a, const int reg) {
+    int target = -1;
+    for (int s = 0; s < cfg->blocks[a].succ_count; s++) {
+        const int succ = cfg->blocks[a].succs[s];
+        if (!ir_live_in(liveness, succ, reg)) {
+            continue;
+        }
+        if (target != -1 || cfg->blocks[succ].pred_count != 1) {
+            return -1;
+        }
+        target = succ;
+    }
+    return target;
+}
+
+/*
+    Whether instruction `i` of the block can move past the rest of the block up to its terminator.
+*/
+static bool can_sink_past(const IR_Block *block, const int i, const int term) {
+    const IR_Instruction *instr = &block->instructions[i];
+    int uses[IR_MAX_USES];
+    const int use_count = ir_instruction_uses(instr, uses);
+    const int def = ir_instruction_def(instr);
+    for (int j = i + 1; j <= term; j++) {
+        const IR_Instruction *later = &block->instructions[j];
+        if (reads_or_writes(later, def)) {
+            return false;
+        }
+        const int later_def = ir_instruction_def(later);
+        for (int u = 0; u < use_count; u++) {
+            if (later_def == uses[u]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool ir_sink_instructions(IR_Function *func) {
+    // Registers from here on carry arguments to where their parameter's copy went
+    const int first_arrived = func->next_reg;
+    bool changed = false;
+    bool sunk = true;
+    while (sunk) {
+        sunk = false;
+        IR_CFG *cfg = ir_cfg_build(func);
+        IR_Liveness *liveness = ir_liveness_build(func, cfg);
+        for (int a = 0; a < func->block_count; a++) {
+            IR_Block *block = &func->blocks[a];
+            const int term = ir_block_terminator(block);
+            if (cfg->blocks[a].rpo == -1 || cfg->blocks[a].succ_count != 2 || term == -1) {
+                continue;
+            }
+            // Liveness goes stale once something moves, so each block gives up at most one instruction per round
+            for (int i = term - 1; i >= 0; i--) {
+                const IR_Instruction instr = block->instructions[i];
+                if (!is_pure(instr.op) && (instr.op != IR_PARAM || instr.dst >= first_arrived)) {
+                    continue;
+                }
+                const int target = sink_target(cfg, liveness, a, instr.dst);
+                if (target == -1 || !can_sink_past(block, i, term)) {
+                    continue;
+                }
+                if (instr.op == IR_PARAM) {
+                    // Parameters have to be read on entry, only the copy out of the argument moves
+                    const int arrived = func->next_reg++;
+                    block->instructions[i].dst = arrived;
+                    ir_insert_instruction(&func->blocks[target], 0, &(IR_Instruction){IR_STORE, instr.dst, arrived, 0});
+                } else {
+                    ir_remove_instruction(block, i);
+                    ir_insert_instruction(&func->blocks[target], 0, &instr);
+                }
+                sunk = true;
+                changed = true;
+                break;
+            }
+        }
+        ir_liveness_free(liveness);
+        ir_cfg_free(cfg);
+    }
+    return changed;
+}
+
+void ir_optimize_module(IR_Module *module) {
+    // Callees are optimized before their callers, so what gets inlined is already optimized
+    IR_CallGraph *graph = ir_call_graph_build(module);
+    for (int i = 0; i < module->count; i++) {
+        IR_Function *func = module->functions[graph->order[i]];
+        ir_inline_calls(module, graph, graph->order[i], IR_INLINE_THRESHOLD);
+        ir_eliminate_tail_calls(func);
+        if (ir_evaluate_function(func, IR_EVAL_BUDGET)) {
+            continue;
+        }
+        ir_iv_strength_reduce(func);
+        ir_combine(func);
+        ir_if_convert(func);
+        ir_eliminate_dead_code(func);
+        ir_sink_instructions(func);
+        // After the loop passes, which expect loops to exit at their header
+        ir_rotate_loops(func);
+        ir_place_blocks(func);
+    }
+    ir_call_graph_free(graph);
+}
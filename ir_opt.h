@@ -0,0 +1,25 @@
+#ifndef COMPILER_C_IR_OPT_H
+#define COMPILER_C_IR_OPT_H
+
+#include "ir.h"
+
+/*
+    Removes instructions without side effects whose result is never read.
+    Returns true if anything was removed.
+*/
+bool ir_eliminate_dead_code(IR_Function *func);
+
+/*
+    Moves instructions without side effects out of a branching block into the one successor that needs their result,
+    So the other paths skip them. Parameters stay on entry but their copies move, a fresh register carries the
+    Argument there. Keeps the entry block clear of work only some paths need, for the x86 frame's shrink-wrapping.
+    Returns true if anything moved.
+*/
+bool ir_sink_instructions(IR_Function *func);
+
+/*
+    Runs the -O1 pass pipeline over every function in the module.
+*/
+void ir_optimize_module(IR_Module *module);
+
+#endif // COMPILER_C_IR_OPT_H
@@ -0,0 +1,69 @@
+#include "ir_rotate.h"
+
+#include "ir_cfg.h"
+
+/*
+    Whether `latch` goes straight back to the header, by branching or by falling through into it.
+*/
+static bool returns_to_header(const IR_Function *func, const int latch, const int header) {
+    const int term = ir_block_terminator(&func->blocks[latch]);
+    if (term == -1) {
+        return latch + 1 == header;
+    }
+    const IR_Instruction *instr = &func->blocks[latch].instructions[term];
+    return instr->op == IR_BR && instr->dst == header;
+}
+
+static bool rotate_loop(IR_Function *func, const IR_Loop *loop) {
+    const IR_Block *header = &func->blocks[loop->header];
+    const int term = ir_block_terminator(header);
+    if (term == -1 || header->instructions[term].op != IR_BR_EQ) {
+        return false;
+    }
+    // The test has to decide between staying in the loop and leaving it
+    const IR_Instruction *test = &header->instructions[term];
+    if (loop->contains[test->a] == loop->contains[test->b]) {
+        return false;
+    }
+    if ((term + 1) * loop->latch_count > IR_ROTATE_MAX_COPY) {
+        return false;
+    }
+    for (int i = 0; i < term; i++) {
+        if (header->instructions[i].op == IR_PARAM) {
+            return false;
+        }
+    }
+    for (int l = 0; l < loop->latch_count; l++) {
+        if (loop->latches[l] == loop->header || !returns_to_header(func, loop->latches[l], loop->header)) {
+            return false;
+        }
+    }
+
+    for (int l = 0; l < loop->latch_count; l++) {
+        IR_Block *latch = &func->blocks[loop->latches[l]];
+        const int latch_term = ir_block_terminator(latch);
+        while (latch_term != -1 && latch->count > latch_term) {
+            ir_remove_instruction(latch, latch->count - 1);
+        }
+        for (int i = 0; i <= term; i++) {
+            ir_append_instruction(latch, &func->blocks[loop->header].instructions[i]);
+        }
+    }
+    return true;
+}
+
+bool ir_rotate_loops(IR_Function *func) {
+    bool changed = false;
+    bool rotated = true;
+    // A rotated loop leaves the CFG stale, innermost loops go first
+    while (rotated) {
+        rotated = false;
+        IR_CFG *cfg = ir_cfg_build(func);
+        for (int l = 0; l < cfg->loop_count && !rotated; l++) {
+            rotated = rotate_loop(func, &cfg->loops[l]);
+        }
+        changed |= rotated;
+        ir_cfg_free(cfg);
+    }
+    return changed;
+}
@@ -0,0 +1,25 @@
+#ifndef COMPILER_C_IR_ROTATE_H
+#define COMPILER_C_IR_ROTATE_H
+
+#include "ir.h"
+
+/*
+    Loop rotation.
+
+    A while loop comes out of the parser testing at the top, each iteration branching back to the test
+    And then branching again on it. Rotation copies the header's test into every latch in place of the branch back,
+    Leaving the header as a guard run once on entry and the loop a do-while testing at the bottom,
+    So each iteration runs one conditional branch. Registers are not in SSA form, so the copies need no renaming.
+*/
+
+// Most instructions copied into the latches of one loop, counted over all its latches
+#ifndef IR_ROTATE_MAX_COPY
+#define IR_ROTATE_MAX_COPY 12
+#endif
+
+/*
+    Returns true if any loop was rotated.
+*/
+bool ir_rotate_loops(IR_Function *func);
+
+#endif // COMPILER_C_IR_ROTATE_H
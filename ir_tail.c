@@ -0,0 +1,111 @@
+#include "ir_tail.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ir_cfg.h"
+
+/*
+    Moves everything after the entry block's IR_PARAMs into a block of its own right after it,
+    Later blocks move up one and branches follow them. Returns the new block.
+*/
+static int ir_split_entry(IR_Function *func) {
+    IR_Block *blocks = malloc(sizeof(IR_Block) * (func->block_count + 1));
+    if (blocks == NULL) {
+        printf("Failed to allocate for tail calls\n");
+        exit(1);
+    }
+    for (int b = 0; b < func->block_count; b++) {
+        IR_Block *block = &blocks[b == 0 ? 0 : b + 1];
+        *block = func->blocks[b];
+        for (int i = 0; i < block->count; i++) {
+            IR_Instruction *instr = &block->instructions[i];
+            if (instr->op == IR_BR) {
+                instr->dst++;
+            } else if (instr->op == IR_BR_EQ) {
+                instr->a++;
+                instr->b++;
+            }
+        }
+    }
+    IR_Block *entry = &blocks[0];
+    IR_Block *body = ir_new_block();
+    int params = 0;
+    while (params < entry->count && entry->instructions[params].op == IR_PARAM) {
+        params++;
+    }
+    for (int i = params; i < entry->count; i++) {
+        ir_append_instruction(body, &entry->instructions[i]);
+    }
+    entry->count = params;
+    ir_append_instruction(entry, &(IR_Instruction){IR_BR, 1, 0, 0});
+    blocks[1] = *body;
+    free(body);
+
+    free(func->blocks);
+    func->blocks = blocks;
+    func->block_count++;
+    func->block_capacity = func->block_count;
+    return 1;
+}
+
+/*
+    Replaces the arguments, call and return ending at `term` of block `b` with copies of the arguments
+    Into the parameters and a branch to `loop`. The arguments are all read before any parameter is written,
+    As an argument may be another parameter.
+*/
+static void ir_loop_self_call(IR_Function *func, const int b, const int term, const int loop) {
+    IR_Block *block = &func->blocks[b];
+    const IR_Instruction call = block->instructions[term - 1];
+    const int args_start = term - 1 - call.b;
+    int *temps = malloc(sizeof(int) * (call.b + 1));
+    IR_Instruction *args = malloc(sizeof(IR_Instruction) * (call.b + 1));
+    if (temps == NULL || args == NULL) {
+        printf("Failed to allocate for tail calls\n");
+        exit(1);
+    }
+    memcpy(args, &block->instructions[args_start], sizeof(IR_Instruction) * call.b);
+    block->count = args_start;
+    for (int j = 0; j < call.b; j++) {
+        temps[args[j].b] = func->next_reg++;
+        ir_append_instruction(block, &(IR_Instruction){IR_STORE, temps[args[j].b], args[j].a, 0});
+    }
+    const IR_Block *entry = &func->blocks[0];
+    for (int i = 0; i < entry->count && entry->instructions[i].op == IR_PARAM; i++) {
+        const IR_Instruction *param = &entry->instructions[i];
+        ir_append_instruction(block, &(IR_Instruction){IR_STORE, param->dst, temps[param->a], 0});
+    }
+    ir_append_instruction(block, &(IR_Instruction){IR_BR, loop, 0, 0});
+    free(args);
+    free(temps);
+}
+
+bool ir_eliminate_tail_calls(IR_Function *func) {
+    bool changed = false;
+    int loop = -1; // Block self calls branch back to, once the entry block is split
+    for (int b = 0; b < func->block_count; b++) {
+        IR_Block *block = &func->blocks[b];
+        const int term = ir_block_terminator(block);
+        if (term < 1 || block->instructions[term].op != IR_RET) {
+            continue;
+        }
+        const IR_Instruction call = block->instructions[term - 1];
+        if (call.op != IR_CALL || call.dst != block->instructions[term].dst) {
+            continue;
+        }
+        changed = true;
+        if (call.b == func->param_count && strcmp(func->callees[call.a], func->name) == 0) {
+            if (loop == -1) {
+                loop = ir_split_entry(func);
+                // Every block moved up one, the entry block's instructions included
+                b++;
+            }
+            ir_loop_self_call(func, b, ir_block_terminator(&func->blocks[b]), loop);
+            continue;
+        }
+        block->count = term - 1;
+        ir_append_instruction(block, &(IR_Instruction){IR_TAIL_CALL, 0, call.a, call.b});
+    }
+    return changed;
+}
@@ -0,0 +1,20 @@
+#ifndef COMPILER_C_IR_TAIL_H
+#define COMPILER_C_IR_TAIL_H
+
+#include "ir.h"
+
+/*
+    Tail call elimination.
+
+    A call is in tail position when the block returns its result straight after it.
+    A function calling itself there becomes a loop, the arguments are copied into the parameters
+    And control branches back to the entry block, which is split after its IR_PARAMs so they are not read again.
+    Any other call there becomes an IR_TAIL_CALL, the callee then returns directly to the caller's caller.
+*/
+
+/*
+    Returns true if any call was rewritten.
+*/
+bool ir_eliminate_tail_calls(IR_Function *func);
+
+#endif // COMPILER_C_IR_TAIL_H
@@ -5,5 +5,5 @@ int main(const int argc, char *argv[]) {
 
     compile(&compiler);
 
-    return 0;
+    return compiler.exit_code;
 }
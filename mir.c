@@ -0,0 +1,290 @@
+#include "mir.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Strings emitted per instruction, with their lengths worked out at compile time
+typedef struct {
+    const char *text;
+    int length;
+} MIR_Text;
+
+#define TEXT(s) {s, sizeof(s) - 1}
+
+static const MIR_Text PREG_NAMES[3][MIR_PREG_COUNT] = {
+    {TEXT("%al"), TEXT("%cl"), TEXT("%dl"), TEXT("%bl"), TEXT("%spl"), TEXT("%bpl"), TEXT("%sil"), TEXT("%dil"),
+     TEXT("%r8b"), TEXT("%r9b"), TEXT("%r10b"), TEXT("%r11b"), TEXT("%r12b"), TEXT("%r13b"), TEXT("%r14b"),
+     TEXT("%r15b")},
+    {TEXT("%eax"), TEXT("%ecx"), TEXT("%edx"), TEXT("%ebx"), TEXT("%esp"), TEXT("%ebp"), TEXT("%esi"), TEXT("%edi"),
+     TEXT("%r8d"), TEXT("%r9d"), TEXT("%r10d"), TEXT("%r11d"), TEXT("%r12d"), TEXT("%r13d"), TEXT("%r14d"),
+     TEXT("%r15d")},
+    {TEXT("%rax"), TEXT("%rcx"), TEXT("%rdx"), TEXT("%rbx"), TEXT("%rsp"), TEXT("%rbp"), TEXT("%rsi"), TEXT("%rdi"),
+     TEXT("%r8"), TEXT("%r9"), TEXT("%r10"), TEXT("%r11"), TEXT("%r12"), TEXT("%r13"), TEXT("%r14"), TEXT("%r15")},
+};
+
+// Indented mnemonics without their size suffix
+static const MIR_Text OP_NAMES[MIR_OP_COUNT] = {
+    TEXT("    nop"),  TEXT("    mov"),  TEXT("    movzb"), TEXT("    add"),  TEXT("    sub"),  TEXT("    imul"),
+    TEXT("    idiv"), TEXT("    cltd"), TEXT("    neg"),   TEXT("    inc"),  TEXT("    dec"),  TEXT("    xor"),
+    TEXT("    shl"),  TEXT("    sar"),  TEXT("    shr"),   TEXT("    lea"),  TEXT("    cmp"),  TEXT("    test"),
+    TEXT("    set"),  TEXT("    cmov"), TEXT("    jmp"),   TEXT("    j"),    TEXT("    call"), TEXT("    push"),
+    TEXT("    pop"),  TEXT("    ret"),  TEXT("    syscall"),
+};
+
+static const MIR_Text COND_NAMES[] = {TEXT("e"), TEXT("ne"), TEXT("l"), TEXT("ge"), TEXT("le"), TEXT("g"), TEXT("s"), TEXT("ns")};
+
+static const MIR_Text *preg_text(const MIR_PReg reg, const int size) {
+    return &PREG_NAMES[size == 1 ? 0 : size == 4 ? 1 : 2][reg];
+}
+
+MIR_Operand mir_vreg(const int reg) { return (MIR_Operand){MIR_VREG, reg, MIR_NO_PREG, 1, 0, NULL}; }
+MIR_Operand mir_preg(const MIR_PReg reg) { return (MIR_Operand){MIR_PREG, reg, MIR_NO_PREG, 1, 0, NULL}; }
+MIR_Operand mir_imm(const int value) { return (MIR_Operand){MIR_IMM, MIR_NO_PREG, MIR_NO_PREG, 1, value, NULL}; }
+
+MIR_Operand mir_mem(const MIR_PReg base, const int displacement) {
+    return (MIR_Operand){MIR_MEM, base, MIR_NO_PREG, 1, displacement, NULL};
+}
+
+MIR_Operand mir_mem_index(const MIR_PReg base, const MIR_PReg index, const int scale, const int displacement) {
+    return (MIR_Operand){MIR_MEM, base, index, scale, displacement, NULL};
+}
+
+MIR_Operand mir_label(const int block) { return (MIR_Operand){MIR_LABEL, MIR_NO_PREG, MIR_NO_PREG, 1, block, NULL}; }
+MIR_Operand mir_symbol(const char *name) { return (MIR_Operand){MIR_SYMBOL, MIR_NO_PREG, MIR_NO_PREG, 1, 0, name}; }
+
+bool mir_same_operand(const MIR_Operand *a, const MIR_Operand *b) {
+    if (a->kind != b->kind) {
+        return false;
+    }
+    switch (a->kind) {
+    case MIR_VREG:
+    case MIR_PREG:
+        return a->reg == b->reg;
+    case MIR_IMM:
+    case MIR_LABEL:
+        return a->value == b->value;
+    case MIR_MEM:
+        return a->reg == b->reg && a->index == b->index && a->scale == b->scale && a->value == b->value;
+    case MIR_SYMBOL:
+        return a->symbol == b->symbol;
+    default:
+        return true;
+    }
+}
+
+MIR_Function *mir_new_function(const char *name, const bool global) {
+    MIR_Function *func = malloc(sizeof(MIR_Function));
+    if (func == NULL) {
+        printf("Failed to allocate MIR function\n");
+        exit(1);
+    }
+    func->global = global;
+    func->blocks = NULL;
+    func->block_count = 0;
+    func->block_capacity = 0;
+    mir_add_block(func, "%s", name);
+    return func;
+}
+
+void mir_free_function(MIR_Function *func) {
+    for (int b = 0; b < func->block_count; b++) {
+        free(func->blocks[b].instructions);
+    }
+    free(func->blocks);
+    free(func);
+}
+
+int mir_add_block(MIR_Function *func, const char *format, ...) {
+    if (func->block_count >= func->block_capacity) {
+        func->block_capacity = func->block_capacity == 0 ? 8 : func->block_capacity * 2;
+        func->blocks = realloc(func->blocks, sizeof(MIR_Block) * func->block_capacity);
+        if (func->blocks == NULL) {
+            printf("Failed to allocate MIR blocks\n");
+            exit(1);
+        }
+    }
+    MIR_Block *block = &func->blocks[func->block_count];
+    va_list args;
+    va_start(args, format);
+    const int length = vsnprintf(block->name, MIR_NAME_SIZE, format, args);
+    va_end(args);
+    if (length >= MIR_NAME_SIZE) {
+        printf("MIR label too long: %s\n", block->name);
+        exit(1);
+    }
+    block->name_length = length;
+    block->aligned = false;
+    block->instructions = NULL;
+    block->count = 0;
+    block->capacity = 0;
+    func->current = func->block_count++;
+    return func->current;
+}
+
+MIR_Instruction *mir_emit(MIR_Function *func, const MIR_Op op, const int size, const int operand_count, ...) {
+    MIR_Block *block = &func->blocks[func->current];
+    if (block->count >= block->capacity) {
+        block->capacity = block->capacity == 0 ? 16 : block->capacity * 2;
+        block->instructions = realloc(block->instructions, sizeof(MIR_Instruction) * block->capacity);
+        if (block->instructions == NULL) {
+            printf("Failed to allocate MIR instructions\n");
+            exit(1);
+        }
+    }
+    MIR_Instruction *instr = &block->instructions[block->count++];
+    instr->op = op;
+    instr->size = size;
+    instr->cond = MIR_COND_E;
+    instr->operand_count = operand_count;
+    va_list args;
+    va_start(args, operand_count);
+    for (int o = 0; o < operand_count; o++) {
+        instr->operands[o] = va_arg(args, MIR_Operand);
+    }
+    va_end(args);
+    return instr;
+}
+
+void mir_emit_jcc(MIR_Function *func, const MIR_Cond cond, const int block) {
+    mir_emit(func, MIR_JCC, 8, 1, mir_label(block))->cond = cond;
+}
+
+void mir_emit_setcc(MIR_Function *func, const MIR_Cond cond, const MIR_Operand dst) {
+    mir_emit(func, MIR_SETCC, 1, 1, dst)->cond = cond;
+}
+
+void mir_emit_cmov(MIR_Function *func, const MIR_Cond cond, const MIR_Operand src, const MIR_Operand dst) {
+    mir_emit(func, MIR_CMOV, 4, 2, src, dst)->cond = cond;
+}
+
+MIR_Cond mir_negate_cond(const MIR_Cond cond) {
+    // Conditions are laid out in pairs
+    return (MIR_Cond)(cond ^ 1);
+}
+
+int mir_next(const MIR_Block *block, int i) {
+    i++;
+    while (i < block->count && block->instructions[i].op == MIR_NOP) {
+        i++;
+    }
+    return i;
+}
+
+int mir_fallthrough(const MIR_Function *func, int block) {
+    for (block++; block < func->block_count; block++) {
+        if (mir_next(&func->blocks[block], -1) < func->blocks[block].count) {
+            return block;
+        }
+    }
+    return func->block_count;
+}
+
+const char *mir_preg_name(const MIR_PReg reg, const int size) { return preg_text(reg, size)->text; }
+
+static void emit_text(Emitter *e, const MIR_Text *text) { emit_bytes(e, text->text, text->length); }
+
+static void print_operand(Emitter *e, const MIR_Function *func, const MIR_Operand *operand, const int size) {
+    switch (operand->kind) {
+    case MIR_VREG:
+        emit_bytes(e, "%v", 2);
+        emit_int(e, operand->reg);
+        break;
+    case MIR_PREG:
+        emit_text(e, preg_text(operand->reg, size));
+        break;
+    case MIR_IMM:
+        emit_char(e, '$');
+        emit_int(e, operand->value);
+        break;
+    case MIR_MEM:
+        if (operand->value != 0 || operand->reg == MIR_NO_PREG) {
+            emit_int(e, operand->value);
+        }
+        emit_char(e, '(');
+        if (operand->reg != MIR_NO_PREG) {
+            emit_text(e, preg_text(operand->reg, 8));
+        }
+        if (operand->index != MIR_NO_PREG) {
+            emit_char(e, ',');
+            emit_text(e, preg_text(operand->index, 8));
+            if (operand->scale != 1) {
+                emit_char(e, ',');
+                emit_int(e, operand->scale);
+            }
+        }
+        emit_char(e, ')');
+        break;
+    case MIR_LABEL: {
+        const MIR_Block *block = &func->blocks[operand->value];
+        emit_bytes(e, block->name, block->name_length);
+        break;
+    }
+    case MIR_SYMBOL:
+        emit_str(e, operand->symbol);
+        break;
+    default:
+        break;
+    }
+}
+
+static void print_instruction(Emitter *e, const MIR_Function *func, const MIR_Instruction *instr) {
+    emit_text(e, &OP_NAMES[instr->op]);
+    switch (instr->op) {
+    case MIR_SETCC:
+    case MIR_JCC:
+        emit_text(e, &COND_NAMES[instr->cond]);
+        break;
+    case MIR_CMOV:
+        emit_text(e, &COND_NAMES[instr->cond]);
+        emit_char(e, instr->size == 8 ? 'q' : 'l');
+        break;
+    case MIR_JMP:
+    case MIR_CLTD:
+    case MIR_CALL:
+    case MIR_PUSH:
+    case MIR_POP:
+    case MIR_RET:
+    case MIR_SYSCALL:
+        break;
+    default:
+        emit_char(e, instr->size == 8 ? 'q' : 'l');
+        break;
+    }
+    for (int o = 0; o < instr->operand_count; o++) {
+        // The source of movzb is a byte register
+        const int size = instr->op == MIR_MOVZB && o == 0 ? 1 : instr->size;
+        if (o == 0) {
+            emit_char(e, ' ');
+        } else {
+            emit_bytes(e, ", ", 2);
+        }
+        print_operand(e, func, &instr->operands[o], size);
+    }
+    emit_char(e, '\n');
+}
+
+void mir_print_function(Emitter *e, const MIR_Function *func) {
+    if (func->global) {
+        emit_str(e, ".global ");
+        emit_bytes(e, func->blocks[0].name, func->blocks[0].name_length);
+        emit_char(e, '\n');
+    }
+    for (int b = 0; b < func->block_count; b++) {
+        const MIR_Block *block = &func->blocks[b];
+        if (block->aligned) {
+            emit_str(e, ".p2align ");
+            emit_int(e, MIR_ALIGN_LOG2);
+            emit_str(e, ",,");
+            emit_int(e, MIR_ALIGN_MAX_SKIP);
+            emit_char(e, '\n');
+        }
+        emit_bytes(e, block->name, block->name_length);
+        emit_bytes(e, ":\n", 2);
+        for (int i = 0; i < block->count; i++) {
+            if (block->instructions[i].op != MIR_NOP) {
+                print_instruction(e, func, &block->instructions[i]);
+            }
+        }
+    }
+}
@@ -0,0 +1,176 @@
+#ifndef COMPILER_C_MIR_H
+#define COMPILER_C_MIR_H
+
+#include <stdbool.h>
+
+#include "emit.h"
+
+/*
+    Machine IR, x86-64 instructions held in memory between instruction selection and output.
+
+    A MIR_Function is a list of blocks in output order, each starting at a label,
+    Control falls through from the end of a block into the next one.
+    Operands are kept in AT&T order, source first and destination last.
+    mir_print_function() writes AT&T syntax assembly.
+*/
+
+// Hardware register numbers, as used in ModRM encodings
+typedef enum {
+    MIR_RAX,
+    MIR_RCX,
+    MIR_RDX,
+    MIR_RBX,
+    MIR_RSP,
+    MIR_RBP,
+    MIR_RSI,
+    MIR_RDI,
+    MIR_R8,
+    MIR_R9,
+    MIR_R10,
+    MIR_R11,
+    MIR_R12,
+    MIR_R13,
+    MIR_R14,
+    MIR_R15,
+    MIR_PREG_COUNT
+} MIR_PReg;
+
+#define MIR_NO_PREG (-1)
+
+typedef enum {
+    MIR_NOP, // Left by passes that erase instructions, never printed
+    MIR_MOV,
+    MIR_MOVZB, // Zero extends a byte register
+    MIR_ADD,
+    MIR_SUB,
+    MIR_IMUL, // One operand: %edx:%eax = %eax * src, two or three operands: dst = src * dst or imm * src
+    MIR_IDIV,
+    MIR_CLTD,
+    MIR_NEG,
+    MIR_INC,
+    MIR_DEC,
+    MIR_XOR,
+    MIR_SHL,
+    MIR_SAR,
+    MIR_SHR,
+    MIR_LEA,
+    MIR_CMP,
+    MIR_TEST,
+    MIR_SETCC,
+    MIR_CMOV, // Moves a 4 or 8 byte register or memory source into a register if the condition holds
+    MIR_JMP,
+    MIR_JCC,
+    MIR_CALL,
+    MIR_PUSH,
+    MIR_POP,
+    MIR_RET,
+    MIR_SYSCALL,
+    MIR_OP_COUNT
+} MIR_Op;
+
+typedef enum {
+    MIR_COND_E,
+    MIR_COND_NE,
+    MIR_COND_L,
+    MIR_COND_GE,
+    MIR_COND_LE,
+    MIR_COND_G,
+    MIR_COND_S,
+    MIR_COND_NS,
+} MIR_Cond;
+
+typedef enum {
+    MIR_OPERAND_NONE,
+    MIR_VREG,   // Virtual register, not yet given a location
+    MIR_PREG,   // Physical register
+    MIR_IMM,    // Immediate
+    MIR_MEM,    // value(reg, index, scale)
+    MIR_LABEL,  // Block of the same function
+    MIR_SYMBOL, // Function or helper outside the current function
+} MIR_OperandKind;
+
+typedef struct {
+    MIR_OperandKind kind;
+    int reg;   // Virtual register number, MIR_PReg, or base register of MIR_MEM (MIR_NO_PREG if none)
+    int index; // Index register of MIR_MEM, MIR_NO_PREG if none
+    int scale;
+    int value; // Immediate, displacement of MIR_MEM or block index of MIR_LABEL
+    const char *symbol;
+} MIR_Operand;
+
+#define MIR_MAX_OPERANDS 3
+
+typedef struct {
+    MIR_Op op;
+    int size; // Operand size in bytes, 1 for setcc, 4 or 8 otherwise
+    MIR_Cond cond;
+    int operand_count;
+    MIR_Operand operands[MIR_MAX_OPERANDS];
+} MIR_Instruction;
+
+#define MIR_NAME_SIZE 64
+
+// Aligned blocks start on a multiple of MIR_ALIGN bytes, unless that takes more than MIR_ALIGN_MAX_SKIP of padding
+#define MIR_ALIGN_LOG2 4
+#define MIR_ALIGN (1 << MIR_ALIGN_LOG2)
+#define MIR_ALIGN_MAX_SKIP 10
+
+typedef struct {
+    char name[MIR_NAME_SIZE]; // Label, the function's name for the entry block
+    int name_length;
+    bool aligned; // Padded to start on a MIR_ALIGN boundary, given to loop headers
+    MIR_Instruction *instructions;
+    int count;
+    int capacity;
+} MIR_Block;
+
+typedef struct {
+    bool global;
+    MIR_Block *blocks;
+    int block_count;
+    int block_capacity;
+    int current; // Block appended to by mir_emit()
+} MIR_Function;
+
+MIR_Operand mir_vreg(int reg);
+MIR_Operand mir_preg(MIR_PReg reg);
+MIR_Operand mir_imm(int value);
+MIR_Operand mir_mem(MIR_PReg base, int displacement);
+MIR_Operand mir_mem_index(MIR_PReg base, MIR_PReg index, int scale, int displacement);
+MIR_Operand mir_label(int block);
+MIR_Operand mir_symbol(const char *name);
+bool mir_same_operand(const MIR_Operand *a, const MIR_Operand *b);
+
+/*
+    A function with its entry block named `name`, the entry block is current.
+*/
+MIR_Function *mir_new_function(const char *name, bool global);
+void mir_free_function(MIR_Function *func);
+
+/*
+    Appends a block named by `format` and makes it current, returns its index.
+*/
+int mir_add_block(MIR_Function *func, const char *format, ...);
+
+MIR_Instruction *mir_emit(MIR_Function *func, MIR_Op op, int size, int operand_count, ...);
+void mir_emit_jcc(MIR_Function *func, MIR_Cond cond, int block);
+void mir_emit_setcc(MIR_Function *func, MIR_Cond cond, MIR_Operand dst);
+void mir_emit_cmov(MIR_Function *func, MIR_Cond cond, MIR_Operand src, MIR_Operand dst);
+
+MIR_Cond mir_negate_cond(MIR_Cond cond);
+
+/*
+    Index of the first instruction after `i` in `block` that is not a MIR_NOP, `block->count` if none.
+*/
+int mir_next(const MIR_Block *block, int i);
+
+/*
+    The block execution continues in after falling off the end of `block`, skipping empty ones.
+    `func->block_count` past the end of the function.
+*/
+int mir_fallthrough(const MIR_Function *func, int block);
+
+const char *mir_preg_name(MIR_PReg reg, int size);
+void mir_print_function(Emitter *e, const MIR_Function *func);
+
+#endif // COMPILER_C_MIR_H
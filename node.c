@@ -34,6 +34,9 @@ void free_node_manager(const NodeManager *nm) {
                 free(node->function.body->compound.statements[j]);
             }
             free(node->function.body->compound.statements);
+            free(node->function.params);
+        } else if (node->type == N_CALL) {
+            free(node->call.args);
         }
     }
     free(nm->nodes);
@@ -74,6 +77,9 @@ void print_node_type(const NodeType type) {
     case N_BINARY:
         printf("Binary");
         break;
+    case N_UNARY:
+        printf("Unary");
+        break;
     case N_LITERAL:
         printf("Literal");
         break;
@@ -86,6 +92,9 @@ void print_node_type(const NodeType type) {
     case N_WHILE:
         printf("While");
         break;
+    case N_CALL:
+        printf("Call");
+        break;
     default:
         printf("\nTried to print an unknown node type\n");
         exit(1);
@@ -144,6 +153,10 @@ void print_node_flat(const Node *node) {
         printf("\top: ");
         print_token_type(node->binary.op);
         break;
+    case N_UNARY:
+        printf("\top: ");
+        print_token_type(node->unary.op);
+        break;
     case N_COMPOUND:
         printf("\tn_statements: %d,\n", node->compound.count);
         break;
@@ -152,6 +165,10 @@ void print_node_flat(const Node *node) {
     case N_IDENTIFIER:
         printf("\tname: %s\n", node->identifier.name);
         break;
+    case N_CALL:
+        printf("\tname: %s,\n", node->call.name);
+        printf("\tn_args: %d", node->call.arg_count);
+        break;
     default:
         printf("\t");
         printf("[Unimplemented]");
@@ -189,6 +206,12 @@ void print_node(const Node *node,const int depth) {
         print_node(node->binary.lhs, depth + 1);
         print_node(node->binary.rhs, depth + 1);
         break;
+    case N_UNARY:
+        printf(": [op= ");
+        print_token_type(node->unary.op);
+        printf("]\n");
+        print_node(node->unary.expr, depth + 1);
+        break;
     case N_LITERAL:
         printf(": [type= ");
         print_token_type(node->literal.type);
@@ -207,13 +230,18 @@ void print_node(const Node *node,const int depth) {
         printf(": [name= %s, params= %d, return_type= ", node->function.name, node->function.param_count);
         print_token_type(node->function.return_type);
         printf("]\n");
+        for (int i = 0; i < node->function.param_count; i++) {
+            print_node(node->function.params[i], depth + 1);
+        }
         print_node(node->function.body, depth + 1);
         break;
     case N_VAR_DECL:
         printf(": [type= ");
         print_token_type(node->var_decl.type);
         printf(", name= %s]\n", node->var_decl.name);
-        print_node(node->var_decl.expr, depth + 1);
+        if (node->var_decl.expr != NULL) {
+            print_node(node->var_decl.expr, depth + 1);
+        }
         break;
     case N_RETURN:
         printf("\n");
@@ -235,6 +263,12 @@ void print_node(const Node *node,const int depth) {
         print_node(node->_while.cond, depth + 1);
         print_node(node->_while.block, depth + 1);
         break;
+    case N_CALL:
+        printf(": [name= %s, args= %d]\n", node->call.name, node->call.arg_count);
+        for (int i = 0; i < node->call.arg_count; i++) {
+            print_node(node->call.args[i], depth + 1);
+        }
+        break;
     default:
         printf("Tried to print an known node type\n");
         exit(1);
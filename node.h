@@ -12,8 +12,10 @@ typedef enum {
     N_WHILE,
     N_RETURN,
     N_BINARY,
+    N_UNARY,
     N_LITERAL,
     N_IDENTIFIER,
+    N_CALL,
 } NodeType;
 
 typedef struct Node Node;
@@ -43,6 +45,10 @@ struct Node {
             Node *rhs;
             TokenType op;
         } binary;
+        struct {
+            Node *expr;
+            TokenType op;
+        } unary;
         struct {
             Node *expr;
         } _return;
@@ -70,6 +76,11 @@ struct Node {
             TokenType type;
             Node *expr;
         } var_decl;
+        struct {
+            const char *name;
+            Node **args;
+            int arg_count;
+        } call;
     };
 };
 
@@ -108,7 +108,9 @@ Node *new_compound_node(NodeManager *nm) {
     Consumes
     `literal`
     `identifier`
+    `identifier([expr [, expr]*]?)`
     `(expr)`
+    `!term`
 */
 Node *p_parse_term(Parser *p, NodeManager *nm) {
     Node *node = NULL;
@@ -124,6 +126,9 @@ Node *p_parse_term(Parser *p, NodeManager *nm) {
         node->literal.f = atof(p_consume(p)->value);
         return node;
     case TK_IDENTIFIER:
+        if (p_peek_next(p)->type == TK_OPEN_PAREN) {
+            return p_parse_call(p, nm);
+        }
         node = new_node(nm, N_IDENTIFIER);
         node->identifier.name = p_consume(p)->value;
         return node;
@@ -132,6 +137,11 @@ Node *p_parse_term(Parser *p, NodeManager *nm) {
         node = p_parse_expression(p, nm, MIN_BINARY_OP_PRECEDENCE);
         p_consume_a(p, TK_CLOSE_PAREN);
         return node;
+    case TK_NOT:
+        node = new_node(nm, N_UNARY);
+        node->unary.op = p_consume(p)->type;
+        node->unary.expr = p_parse_term(p, nm);
+        return node;
     default:
         printf("Expected expression got ");
         print_token_type(p_peek(p)->type);
@@ -140,6 +150,39 @@ Node *p_parse_term(Parser *p, NodeManager *nm) {
     }
 }
 
+/*
+    Consumes
+    `identifier([expr [, expr]*]?)`
+*/
+Node *p_parse_call(Parser *p, NodeManager *nm) {
+    Node *node = new_node(nm, N_CALL);
+    node->call.name = p_consume_a(p, TK_IDENTIFIER)->value;
+    p_consume_a(p, TK_OPEN_PAREN);
+    int capacity = DEFAULT_STATEMENTS_PER_BLOCK;
+    node->call.args = malloc(sizeof(*node->call.args) * capacity);
+    if (node->call.args == NULL) {
+        printf("Failed to allocate call arguments");
+        exit(1);
+    }
+    node->call.arg_count = 0;
+    while (p_peek(p)->type != TK_CLOSE_PAREN && !p_is_last_token(p)) {
+        if (node->call.arg_count > 0) {
+            p_consume_a(p, TK_COMMA);
+        }
+        if (node->call.arg_count >= capacity) {
+            capacity *= 2;
+            node->call.args = realloc(node->call.args, sizeof(*node->call.args) * capacity);
+            if (node->call.args == NULL) {
+                printf("Failed to append call argument");
+                exit(1);
+            }
+        }
+        node->call.args[node->call.arg_count++] = p_parse_expression(p, nm, MIN_BINARY_OP_PRECEDENCE);
+    }
+    p_consume_a(p, TK_CLOSE_PAREN);
+    return node;
+}
+
 /*
     Consumes
     `[term]+`
@@ -281,6 +324,7 @@ Node *p_parse_var_assign(Parser *p, NodeManager *nm) {
     `(type) identifier = [= expr]?;`
     `[if statement]`
     `return [expr]?`
+    `identifier([args]);`
     `[expr];`
 
     Never consumes `;`, other functions must consume it.
@@ -297,6 +341,11 @@ Node *p_parse_statement(Parser *p, NodeManager *nm) {
     case TK_RETURN:
         return p_parse_return(p, nm);
     case TK_IDENTIFIER:
+        if (p_peek_next(p)->type == TK_OPEN_PAREN) {
+            Node *call = p_parse_call(p, nm);
+            p_consume_a(p, TK_SEMI);
+            return call;
+        }
         return p_parse_var_assign(p, nm);
     case TK_OPEN_CURLY:
         return p_parse_compound(p, nm);
@@ -321,9 +370,9 @@ Node *p_parse_compound(Parser *p, NodeManager *nm) {
 }
 /*
     Consumes
-    `(type) identifier ([var decl]*) {[statement]*}`
+    `(type) identifier ([(type) identifier [, (type) identifier]*]?) {[statement]*}`
 
-    () contains any amount of var declarations, including zero,
+    () contains any amount of comma separated parameters, including zero,
     and {} contains any amount of statements, including zero.
 */
 Node *p_parse_function(Parser *p, NodeManager *nm) {
@@ -331,13 +380,33 @@ Node *p_parse_function(Parser *p, NodeManager *nm) {
     node->function.return_type = p_consume(p)->type;
     node->function.name = p_consume(p)->value;
     p_consume_a(p, TK_OPEN_PAREN);
+    int capacity = DEFAULT_STATEMENTS_PER_BLOCK;
+    node->function.params = malloc(sizeof(*node->function.params) * capacity);
+    if (node->function.params == NULL) {
+        printf("Failed to allocate function parameters");
+        exit(1);
+    }
+    node->function.param_count = 0;
     while (p_peek(p)->type != TK_CLOSE_PAREN && !p_is_last_token(p)) {
-        // Skip all params for now...
-        p_skip(p);
+        if (node->function.param_count > 0) {
+            p_consume_a(p, TK_COMMA);
+        }
+        if (node->function.param_count >= capacity) {
+            capacity *= 2;
+            node->function.params = realloc(node->function.params, sizeof(*node->function.params) * capacity);
+            if (node->function.params == NULL) {
+                printf("Failed to append function parameter");
+                exit(1);
+            }
+        }
+        // Parameters are declarations without an initializer or `;`
+        Node *param = new_node(nm, N_VAR_DECL);
+        param->var_decl.type = p_consume(p)->type;
+        param->var_decl.name = p_consume_a(p, TK_IDENTIFIER)->value;
+        param->var_decl.expr = NULL;
+        node->function.params[node->function.param_count++] = param;
     }
     p_consume_a(p, TK_CLOSE_PAREN);
-    node->function.param_count = 0;
-    node->function.params = NULL;
     node->function.body = p_parse_compound(p, nm);
     return node;
 }
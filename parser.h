@@ -54,10 +54,18 @@ Node *new_compound_node(NodeManager *nm);
     Consumes
     `literal`
     `identifier`
+    `identifier([expr [, expr]*]?)`
     `(expr)`
+    `!term`
 */
 Node *p_parse_term(Parser *p, NodeManager *nm);
 
+/*
+    Consumes
+    `identifier([expr [, expr]*]?)`
+*/
+Node *p_parse_call(Parser *p, NodeManager *nm);
+
 /*
     Consumes
     `[term]+`
@@ -110,6 +118,7 @@ Node *p_parse_var_assign(Parser *p, NodeManager *nm);
     `(type) identifier = [= expr]?;`
     `[if statement]`
     `return [expr]?`
+    `identifier([args]);`
     `[expr];`
 
     Never consumes `;`, other functions must consume it.
@@ -125,9 +134,9 @@ Node *p_parse_compound(Parser *p, NodeManager *nm);
 
 /*
     Consumes
-    `(type) identifier ([var decl]*) {[statement]*}`
+    `(type) identifier ([(type) identifier [, (type) identifier]*]?) {[statement]*}`
 
-    () contains any amount of var declarations, including zero,
+    () contains any amount of comma separated parameters, including zero,
     and {} contains any amount of statements, including zero.
 */
 Node *p_parse_function(Parser *p, NodeManager *nm);
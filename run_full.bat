@@ -1 +1 @@
-gcc main.c -o compiler.exe;./compiler.exe test.c -a;gcc test.s -o test.exe;./test.exe; echo "exit code: $?"
+gcc main.c -o compiler.exe;./compiler.exe test.c --exe -o test.exe;./test.exe; echo "exit code: $?"
@@ -0,0 +1,35 @@
+#ifndef COMPILER_C_IR_TEST_H
+#define COMPILER_C_IR_TEST_H
+
+#include "../ir.h"
+#include <stdio.h>
+
+/*
+    Helpers shared by the tests that build IR by hand.
+    Each test is one translation unit, so they are defined here and inline keeps unused ones quiet.
+*/
+
+static inline void emit(IR_Function *func, const int block, const IR_OP op, const int dst, const int a, const int b) {
+    IR_Instruction instr = {op, dst, a, b};
+    ir_append_instruction(&func->blocks[block], &instr);
+}
+
+/*
+    Prints the outcome of a check, returns 1 if it failed.
+*/
+static inline int report(const char *name, const int ok) {
+    printf("%s: %s\n", ok ? "true" : "false", name);
+    return !ok;
+}
+
+static inline int count_ops(const IR_Function *func, const IR_OP op) {
+    int count = 0;
+    for (int b = 0; b < func->block_count; b++) {
+        for (int i = 0; i < func->blocks[b].count; i++) {
+            count += func->blocks[b].instructions[i].op == op;
+        }
+    }
+    return count;
+}
+
+#endif // COMPILER_C_IR_TEST_H
@@ -0,0 +1,52 @@
+#include "../ir_combine.h"
+#include <stdio.h>
+
+static int mulhs(const int a, const int b) { return (int)(((long long)a * b) >> 32); }
+
+/*
+    Evaluates the sequence ir_combine emits for a non power of two divisor.
+*/
+static int magic_divide(const int n, const int d) {
+    const IR_DivMagic magic = ir_div_magic(d);
+    int q = mulhs(n, magic.multiplier);
+    if (d > 0 && magic.multiplier < 0) {
+        q += n;
+    } else if (d < 0 && magic.multiplier > 0) {
+        q -= n;
+    }
+    q >>= magic.shift;
+    return q + (int)((unsigned)q >> 31);
+}
+
+static int test_divisor(const int d) {
+    const int samples[] = {0, 1, -1, 2, -2, 7, -7, 100, -100, 12345, -12345, 2147483647, -2147483647, -2147483647 - 1};
+    int failures = 0;
+    for (int i = 0; i < (int)(sizeof(samples) / sizeof(samples[0])); i++) {
+        const int n = samples[i];
+        if (n == -2147483647 - 1 && d == -1) {
+            continue;
+        }
+        if (magic_divide(n, d) != n / d) {
+            printf("false: %d / %d gave %d\n", n, d, magic_divide(n, d));
+            failures++;
+        }
+    }
+    for (int n = -100000; n <= 100000; n += 7) {
+        if (magic_divide(n, d) != n / d) {
+            printf("false: %d / %d gave %d\n", n, d, magic_divide(n, d));
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int main(void) {
+    const int divisors[] = {3, 5, 6, 7, 9, 10, 11, 12, 13, 25, 100, 125, 641, 1000, 6700417, 2147483647,
+                            -3, -5, -7, -10, -100, -1000, -2147483647};
+    int failures = 0;
+    for (int i = 0; i < (int)(sizeof(divisors) / sizeof(divisors[0])); i++) {
+        failures += test_divisor(divisors[i]);
+    }
+    printf("%s: magic division\n", failures == 0 ? "true" : "false");
+    return failures != 0;
+}
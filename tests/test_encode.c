@@ -0,0 +1,116 @@
+#include "../x86.h"
+#include "../x86_elf.h"
+#include "../x86_jit.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#define OBJECT_PATH "test_encode.o"
+#define PROGRAM_PATH "./test_encode.out"
+#define EXECUTABLE_PATH "./test_encode.exe"
+
+static int report(const char *name, const int ok) {
+    printf("%s: %s\n", ok ? "true" : "false", name);
+    return !ok;
+}
+
+static int contains(const X86_Object *obj, const unsigned char *bytes, const int length) {
+    for (int i = 0; i + length <= obj->size; i++) {
+        if (memcmp(obj->text + i, bytes, length) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+    main returns abs(-7) + five(), branching over a block too long for a rel8 displacement.
+    abs comes from libc through a relocation, five is resolved within the object.
+*/
+static void build(X86_Object *obj) {
+    const MIR_Operand eax = mir_preg(MIR_RAX);
+    const MIR_Operand ebx = mir_preg(MIR_RBX);
+
+    MIR_Function *func = mir_new_function("main", true);
+    mir_emit(func, MIR_PUSH, 8, 1, ebx);
+    mir_emit(func, MIR_MOV, 4, 2, mir_imm(-7), mir_preg(MIR_RDI));
+    mir_emit(func, MIR_CALL, 8, 1, mir_symbol("abs"));
+    mir_emit(func, MIR_MOV, 4, 2, eax, ebx);
+    mir_emit(func, MIR_CALL, 8, 1, mir_symbol("five"));
+    mir_emit(func, MIR_ADD, 4, 2, eax, ebx);
+    mir_emit(func, MIR_TEST, 4, 2, ebx, ebx);
+    mir_emit_jcc(func, MIR_COND_NE, 2);
+    mir_add_block(func, "padding");
+    for (int i = 0; i < 40; i++) {
+        mir_emit(func, MIR_ADD, 4, 2, mir_imm(1000), ebx);
+        mir_emit(func, MIR_SUB, 4, 2, mir_imm(1000), ebx);
+    }
+    mir_emit(func, MIR_JMP, 8, 1, mir_label(2));
+    mir_add_block(func, "done");
+    mir_emit(func, MIR_MOV, 4, 2, ebx, eax);
+    mir_emit(func, MIR_POP, 8, 1, ebx);
+    mir_emit(func, MIR_RET, 8, 0);
+    x86_encode_function(obj, func);
+    mir_free_function(func);
+
+    func = mir_new_function("five", false);
+    mir_emit(func, MIR_MOV, 4, 2, mir_imm(5), eax);
+    mir_emit(func, MIR_RET, 8, 0);
+    x86_encode_function(obj, func);
+    mir_free_function(func);
+
+    x86_resolve_object(obj);
+}
+
+int main(void) {
+    int failures = 0;
+    X86_Object obj = x86_new_object();
+    build(&obj);
+
+    // jne done spans the padding block and has to widen, the jmp at its end stays short
+    const unsigned char jne_long[] = {0x0F, 0x85, 0xE2, 0x01, 0x00, 0x00};
+    const unsigned char jmp_short[] = {0xEB, 0x00};
+    failures += report("long branch", contains(&obj, jne_long, sizeof(jne_long)));
+    failures += report("short branch", contains(&obj, jmp_short, sizeof(jmp_short)));
+    failures += report("call resolved in object", obj.reloc_count == 2 && !obj.relocs[0].resolved && obj.relocs[1].resolved);
+
+    static Emitter e;
+    if (!emit_open(&e, OBJECT_PATH)) {
+        printf("Failed to open %s\n", OBJECT_PATH);
+        return 1;
+    }
+    elf_write_object(&e, &obj);
+    failures += report("object written", emit_close(&e));
+    x86_free_object(&obj);
+
+    const int linked = system("cc " OBJECT_PATH " -o " PROGRAM_PATH) == 0;
+    failures += report("links with the system linker", linked);
+    if (linked) {
+        const int status = system(PROGRAM_PATH);
+        failures += report("program returns abs(-7) + 5", WIFEXITED(status) && WEXITSTATUS(status) == 12);
+    }
+    remove(OBJECT_PATH);
+    remove(PROGRAM_PATH);
+
+    // Written directly, with _start and no libc
+    obj = x86_new_object();
+    MIR_Function *func = mir_new_function("main", true);
+    mir_emit(func, MIR_MOV, 4, 2, mir_imm(42), mir_preg(MIR_RAX));
+    mir_emit(func, MIR_RET, 8, 0);
+    x86_encode_function(&obj, func);
+    mir_free_function(func);
+    failures += report("jit returns 42", x86_jit_run(&obj, "main") == 42);
+    x86_encode_start(&obj);
+    if (!emit_open_mode(&e, EXECUTABLE_PATH, 0755)) {
+        printf("Failed to open %s\n", EXECUTABLE_PATH);
+        return 1;
+    }
+    elf_write_executable(&e, &obj, X86_START);
+    failures += report("executable written", emit_close(&e));
+    x86_free_object(&obj);
+    const int status = system(EXECUTABLE_PATH);
+    failures += report("static executable returns 42", WIFEXITED(status) && WEXITSTATUS(status) == 42);
+    remove(EXECUTABLE_PATH);
+    return failures != 0;
+}
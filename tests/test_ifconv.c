@@ -0,0 +1,70 @@
+#include "../ir_ifconv.h"
+#include "../ir_interp.h"
+#include "ir_test.h"
+
+int main(void) {
+    IR_Module *module = ir_new_module();
+    int failures = 0;
+
+    // a = 3; b = 7; if (a > b) m = a; else m = b; return m;
+    IR_Function *diamond = ir_new_function("diamond");
+    for (int b = 0; b < 4; b++) {
+        ir_new_label(diamond);
+    }
+    diamond->next_reg = 4;
+    emit(diamond, 0, IR_LOAD, 0, 3, 0);
+    emit(diamond, 0, IR_LOAD, 1, 7, 0);
+    emit(diamond, 0, IR_CMP_GT, 2, 0, 1);
+    emit(diamond, 0, IR_BR_EQ, 2, 1, 2);
+    emit(diamond, 1, IR_STORE, 3, 0, 0);
+    emit(diamond, 1, IR_BR, 3, 0, 0);
+    emit(diamond, 2, IR_STORE, 3, 1, 0);
+    emit(diamond, 3, IR_RET, 3, 0, 0);
+    ir_append_function(module, diamond);
+
+    // a = 3; s = 7; if (a < s) s = s + a; return s;
+    IR_Function *triangle = ir_new_function("triangle");
+    for (int b = 0; b < 3; b++) {
+        ir_new_label(triangle);
+    }
+    triangle->next_reg = 4;
+    emit(triangle, 0, IR_LOAD, 0, 3, 0);
+    emit(triangle, 0, IR_LOAD, 1, 7, 0);
+    emit(triangle, 0, IR_CMP_LT, 2, 0, 1);
+    emit(triangle, 0, IR_BR_EQ, 2, 1, 2);
+    emit(triangle, 1, IR_ADD, 1, 1, 0);
+    emit(triangle, 2, IR_RET, 1, 0, 0);
+    ir_append_function(module, triangle);
+
+    // a = 3; s = 7; if (!(a < s)) s = s + a; return s;
+    IR_Function *inverted = ir_new_function("inverted");
+    for (int b = 0; b < 3; b++) {
+        ir_new_label(inverted);
+    }
+    inverted->next_reg = 4;
+    emit(inverted, 0, IR_LOAD, 0, 3, 0);
+    emit(inverted, 0, IR_LOAD, 1, 7, 0);
+    emit(inverted, 0, IR_CMP_LT, 2, 0, 1);
+    emit(inverted, 0, IR_BR_EQ, 2, 2, 1);
+    emit(inverted, 1, IR_ADD, 1, 1, 0);
+    emit(inverted, 2, IR_RET, 1, 0, 0);
+    ir_append_function(module, inverted);
+
+    failures += report("diamond converted", ir_if_convert(diamond));
+    failures += report("diamond has no branch left", count_ops(diamond, IR_BR_EQ) == 0);
+    failures += report("diamond selects", count_ops(diamond, IR_SELECT) == 1);
+    failures += report("diamond arms deleted", diamond->block_count == 2);
+    failures += report("diamond keeps the result", ir_interp_module(module, "diamond").value == 7);
+
+    failures += report("triangle converted", ir_if_convert(triangle));
+    failures += report("triangle has no branch left", count_ops(triangle, IR_BR_EQ) == 0);
+    failures += report("triangle arm deleted", triangle->block_count == 2);
+    failures += report("triangle keeps the result", ir_interp_module(module, "triangle").value == 10);
+    failures += report("converted function left alone", !ir_if_convert(triangle));
+
+    failures += report("inverted triangle converted", ir_if_convert(inverted));
+    failures += report("inverted triangle keeps the result", ir_interp_module(module, "inverted").value == 7);
+
+    ir_free_module(module);
+    return failures != 0;
+}
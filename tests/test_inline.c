@@ -0,0 +1,108 @@
+#include "../ir_inline.h"
+#include "../ir_interp.h"
+#include "../ir_opt.h"
+#include "ir_test.h"
+
+int main(void) {
+    IR_Module *module = ir_new_module();
+    int failures = 0;
+
+    // caller() { return twice(21) + abs(-5); }
+    IR_Function *func = ir_new_function("caller");
+    func->next_reg = 5;
+    emit(func, 0, IR_LOAD, 0, 21, 0);
+    emit(func, 0, IR_ARG, 0, 0, 0);
+    emit(func, 0, IR_CALL, 1, ir_add_callee(func, "twice"), 1);
+    emit(func, 0, IR_LOAD, 2, -5, 0);
+    emit(func, 0, IR_ARG, 0, 2, 0);
+    emit(func, 0, IR_CALL, 3, ir_add_callee(func, "abs"), 1);
+    emit(func, 0, IR_ADD, 4, 1, 3);
+    emit(func, 0, IR_RET, 4, 0, 0);
+    ir_append_function(module, func);
+
+    // twice(x) { return x + x; }
+    func = ir_new_function("twice");
+    func->next_reg = 2;
+    func->param_count = 1;
+    emit(func, 0, IR_PARAM, 0, 0, 0);
+    emit(func, 0, IR_ADD, 1, 0, 0);
+    emit(func, 0, IR_RET, 1, 0, 0);
+    ir_append_function(module, func);
+
+    // abs(x) { if (x < 0) { return 0 - x; } return x; }
+    func = ir_new_function("abs");
+    for (int b = 0; b < 2; b++) {
+        ir_new_label(func);
+    }
+    func->next_reg = 4;
+    func->param_count = 1;
+    emit(func, 0, IR_PARAM, 0, 0, 0);
+    emit(func, 0, IR_LOAD, 1, 0, 0);
+    emit(func, 0, IR_CMP_LT, 2, 0, 1);
+    emit(func, 0, IR_BR_EQ, 2, 1, 2);
+    emit(func, 1, IR_SUB, 3, 1, 0);
+    emit(func, 1, IR_RET, 3, 0, 0);
+    emit(func, 2, IR_RET, 0, 0, 0);
+    ir_append_function(module, func);
+
+    // down(n) { if (n) { return down(n); } return 0; }, recursive so never inlined
+    func = ir_new_function("down");
+    for (int b = 0; b < 2; b++) {
+        ir_new_label(func);
+    }
+    func->next_reg = 3;
+    func->param_count = 1;
+    emit(func, 0, IR_PARAM, 0, 0, 0);
+    emit(func, 0, IR_LOAD, 1, 0, 0);
+    emit(func, 0, IR_BR_EQ, 0, 2, 1);
+    emit(func, 1, IR_RET, 1, 0, 0);
+    emit(func, 2, IR_ARG, 0, 1, 0);
+    emit(func, 2, IR_CALL, 2, ir_add_callee(func, "down"), 1);
+    emit(func, 2, IR_RET, 2, 0, 0);
+    ir_append_function(module, func);
+
+    // early(x) { if (x) { return 7; return x; } return 0; }, the parser leaves code after a return in its block
+    func = ir_new_function("early");
+    for (int b = 0; b < 2; b++) {
+        ir_new_label(func);
+    }
+    func->next_reg = 3;
+    func->param_count = 1;
+    emit(func, 0, IR_PARAM, 0, 0, 0);
+    emit(func, 0, IR_LOAD, 1, 0, 0);
+    emit(func, 0, IR_BR_EQ, 0, 1, 2);
+    emit(func, 1, IR_LOAD, 2, 7, 0);
+    emit(func, 1, IR_RET, 2, 0, 0);
+    emit(func, 1, IR_RET, 0, 0, 0);
+    emit(func, 2, IR_RET, 1, 0, 0);
+    ir_append_function(module, func);
+
+    // returns_early() { return early(3); }
+    func = ir_new_function("returns_early");
+    func->next_reg = 2;
+    emit(func, 0, IR_LOAD, 0, 3, 0);
+    emit(func, 0, IR_ARG, 0, 0, 0);
+    emit(func, 0, IR_CALL, 1, ir_add_callee(func, "early"), 1);
+    emit(func, 0, IR_RET, 1, 0, 0);
+    ir_append_function(module, func);
+
+    IR_CallGraph *graph = ir_call_graph_build(module);
+    int position[6];
+    for (int i = 0; i < graph->count; i++) {
+        position[graph->order[i]] = i;
+    }
+    const int bottom_up = position[1] < position[0] && position[2] < position[0];
+    failures += report("callees ordered before callers", bottom_up);
+    failures += report("caller inlined", ir_inline_calls(module, graph, 0, IR_INLINE_THRESHOLD));
+    failures += report("no calls left", count_ops(module->functions[0], IR_CALL) == 0);
+    failures += report("branching callee spliced", module->functions[0]->block_count == 1 + 3 + 1);
+    failures += report("inlined caller returns 47", ir_interp_module(module, "caller").value == 47);
+    failures += report("recursion kept", !ir_inline_calls(module, graph, 3, IR_INLINE_THRESHOLD));
+    failures += report("early return inlined", ir_inline_calls(module, graph, 5, IR_INLINE_THRESHOLD));
+    ir_eliminate_dead_code(module->functions[5]);
+    failures += report("code after an inlined return dropped", ir_interp_module(module, "returns_early").value == 7);
+    ir_call_graph_free(graph);
+
+    ir_free_module(module);
+    return failures != 0;
+}
@@ -0,0 +1,130 @@
+#include "../ir_eval.h"
+#include "../ir_interp.h"
+#include "ir_test.h"
+
+static int check(const char *name, const IR_InterpResult result, const IR_InterpStatus status, const int value) {
+    return report(name, result.status == status && (status != IR_INTERP_OK || result.value == value));
+}
+
+int main(void) {
+    IR_Module *module = ir_new_module();
+    int failures = 0;
+
+    // s = 0; i = 10; while (i > 0) { s = s + i; i = i - 1; } return s;
+    IR_Function *func = ir_new_function("sum");
+    for (int b = 0; b < 4; b++) {
+        ir_new_label(func);
+    }
+    func->next_reg = 5;
+    emit(func, 0, IR_LOAD, 0, 0, 0);
+    emit(func, 0, IR_LOAD, 1, 10, 0);
+    emit(func, 1, IR_LOAD, 2, 0, 0);
+    emit(func, 1, IR_CMP_GT, 3, 1, 2);
+    emit(func, 1, IR_BR_EQ, 3, 2, 3);
+    emit(func, 2, IR_ADD, 0, 0, 1);
+    emit(func, 2, IR_LOAD, 4, 1, 0);
+    emit(func, 2, IR_SUB, 1, 1, 4);
+    emit(func, 2, IR_BR, 1, 0, 0);
+    emit(func, 3, IR_RET, 0, 0, 0);
+    ir_append_function(module, func);
+
+    func = ir_new_function("trap");
+    ir_new_label(func);
+    func->next_reg = 3;
+    emit(func, 0, IR_LOAD, 0, 1, 0);
+    emit(func, 0, IR_LOAD, 1, 0, 0);
+    emit(func, 0, IR_DIV, 2, 0, 1);
+    emit(func, 0, IR_RET, 2, 0, 0);
+    ir_append_function(module, func);
+
+    func = ir_new_function("empty");
+    ir_new_label(func);
+    ir_append_function(module, func);
+
+    // twice(x) { return x + x; }  caller() { return twice(21); }
+    func = ir_new_function("twice");
+    ir_new_label(func);
+    func->next_reg = 2;
+    func->param_count = 1;
+    emit(func, 0, IR_PARAM, 0, 0, 0);
+    emit(func, 0, IR_ADD, 1, 0, 0);
+    emit(func, 0, IR_RET, 1, 0, 0);
+    ir_append_function(module, func);
+
+    func = ir_new_function("caller");
+    ir_new_label(func);
+    func->next_reg = 2;
+    emit(func, 0, IR_LOAD, 0, 21, 0);
+    emit(func, 0, IR_ARG, 0, 0, 0);
+    emit(func, 0, IR_CALL, 1, ir_add_callee(func, "twice"), 1);
+    emit(func, 0, IR_RET, 1, 0, 0);
+    ir_append_function(module, func);
+
+    const IR_InterpResult sum = ir_interp_module(module, "sum");
+    failures += check("loop falls through into its condition", sum, IR_INTERP_OK, 55);
+    // Entry block, 11 condition checks, 10 loop bodies and the return
+    const int counted = sum.executed == 2 + 11 * 3 + 10 * 4 + 1;
+    failures += report("executed instructions counted", counted);
+    failures += check("division by zero traps", ir_interp_module(module, "trap"), IR_INTERP_TRAP, 0);
+    failures += check("falling off the end returns 0", ir_interp_module(module, "empty"), IR_INTERP_OK, 0);
+    failures += check("call passes its argument", ir_interp_module(module, "caller"), IR_INTERP_OK, 42);
+
+    // depth(n) { if (n == 0) { return 0; } return depth(n - 1) + 1; }  deep() { return depth(200000); }
+    func = ir_new_function("depth");
+    for (int b = 0; b < 2; b++) {
+        ir_new_label(func);
+    }
+    func->next_reg = 6;
+    func->param_count = 1;
+    emit(func, 0, IR_PARAM, 0, 0, 0);
+    emit(func, 0, IR_LOAD, 1, 0, 0);
+    emit(func, 0, IR_CMP_EQ, 2, 0, 1);
+    emit(func, 0, IR_BR_EQ, 2, 1, 2);
+    emit(func, 1, IR_RET, 1, 0, 0);
+    emit(func, 2, IR_LOAD, 3, 1, 0);
+    emit(func, 2, IR_SUB, 3, 0, 3);
+    emit(func, 2, IR_ARG, 0, 3, 0);
+    emit(func, 2, IR_CALL, 4, ir_add_callee(func, "depth"), 1);
+    emit(func, 2, IR_LOAD, 5, 1, 0);
+    emit(func, 2, IR_ADD, 4, 4, 5);
+    emit(func, 2, IR_RET, 4, 0, 0);
+    ir_append_function(module, func);
+
+    func = ir_new_function("deep");
+    ir_new_label(func);
+    func->next_reg = 2;
+    emit(func, 0, IR_LOAD, 0, 200000, 0);
+    emit(func, 0, IR_ARG, 0, 0, 0);
+    emit(func, 0, IR_CALL, 1, ir_add_callee(func, "depth"), 1);
+    emit(func, 0, IR_RET, 1, 0, 0);
+    ir_append_function(module, func);
+
+    // forever() { return forever() + 1; }
+    func = ir_new_function("forever");
+    ir_new_label(func);
+    func->next_reg = 2;
+    emit(func, 0, IR_CALL, 0, ir_add_callee(func, "forever"), 0);
+    emit(func, 0, IR_LOAD, 1, 1, 0);
+    emit(func, 0, IR_ADD, 0, 0, 1);
+    emit(func, 0, IR_RET, 0, 0, 0);
+    ir_append_function(module, func);
+
+    failures += check("deep recursion returns", ir_interp_module(module, "deep"), IR_INTERP_OK, 200000);
+    failures += check("unbounded recursion stops", ir_interp_module(module, "forever"), IR_INTERP_DEPTH, 0);
+
+    IR_Program *program = ir_interp_compile(module->functions[0]);
+    failures += check("budget stops the loop", ir_interp_run(program, 10), IR_INTERP_BUDGET, 0);
+    ir_interp_free(program);
+
+    const int evaluated = ir_evaluate_function(module->functions[0], IR_EVAL_BUDGET) &&
+                          module->functions[0]->block_count == 1 &&
+                          ir_interp_module(module, "sum").value == 55;
+    failures += report("closed function evaluated at compile time", evaluated);
+    const int kept = !ir_evaluate_function(module->functions[1], IR_EVAL_BUDGET);
+    failures += report("trapping function kept", kept);
+    const int calling = !ir_evaluate_function(module->functions[4], IR_EVAL_BUDGET);
+    failures += report("calling function kept", calling);
+
+    ir_free_module(module);
+    return failures != 0;
+}
@@ -0,0 +1,68 @@
+#include "../ir_layout.h"
+#include "../ir_interp.h"
+#include "ir_test.h"
+
+int main(void) {
+    IR_Module *module = ir_new_module();
+    int failures = 0;
+
+    // n = 10; if (n < 0) { return -1; } s = 0; i = 0; while (i < n) { s = s + i; i = i + 1; } return s;
+    IR_Function *func = ir_new_function("sum");
+    for (int b = 0; b < 5; b++) {
+        ir_new_label(func);
+    }
+    func->next_reg = 8;
+    emit(func, 0, IR_LOAD, 0, 10, 0);
+    emit(func, 0, IR_LOAD, 1, 0, 0);
+    emit(func, 0, IR_CMP_LT, 2, 0, 1);
+    emit(func, 0, IR_BR_EQ, 2, 1, 2);
+    emit(func, 1, IR_LOAD, 3, -1, 0);
+    emit(func, 1, IR_RET, 3, 0, 0);
+    emit(func, 2, IR_LOAD, 4, 0, 0);
+    emit(func, 2, IR_LOAD, 5, 0, 0);
+    emit(func, 3, IR_CMP_LT, 6, 5, 0);
+    emit(func, 3, IR_BR_EQ, 6, 4, 5);
+    emit(func, 4, IR_ADD, 4, 4, 5);
+    emit(func, 4, IR_LOAD, 7, 1, 0);
+    emit(func, 4, IR_ADD, 5, 5, 7);
+    emit(func, 4, IR_BR, 3, 0, 0);
+    emit(func, 5, IR_RET, 4, 0, 0);
+    ir_append_function(module, func);
+
+    IR_CFG *cfg = ir_cfg_build(func);
+    IR_Profile *profile = ir_profile_build(func, cfg);
+    failures += report("early return predicted cold", profile->taken[0] < 0.2);
+    failures += report("loop predicted to stay", profile->taken[3] > 0.8);
+    failures += report("loop body runs several times", profile->freq[4] > 2 && profile->freq[5] < profile->freq[3]);
+    ir_profile_free(profile);
+    ir_cfg_free(cfg);
+
+    failures += report("blocks reordered", ir_place_blocks(func));
+    const IR_Block *last = &func->blocks[func->block_count - 1];
+    failures += report("cold return placed last", last->count == 2 && last->instructions[0].a == -1);
+    failures += report("loop exit follows the loop", func->blocks[4].instructions[0].op == IR_RET);
+    failures += report("layout keeps the result", ir_interp_module(module, "sum").value == 45);
+    failures += report("layout is stable", !ir_place_blocks(func));
+
+    // x = 3; if (x == 5) { return 1; } x = 2; and fall off the end
+    func = ir_new_function("falls");
+    for (int b = 0; b < 2; b++) {
+        ir_new_label(func);
+    }
+    func->next_reg = 4;
+    emit(func, 0, IR_LOAD, 0, 3, 0);
+    emit(func, 0, IR_LOAD, 1, 5, 0);
+    emit(func, 0, IR_CMP_EQ, 2, 0, 1);
+    emit(func, 0, IR_BR_EQ, 2, 1, 2);
+    emit(func, 1, IR_LOAD, 3, 1, 0);
+    emit(func, 1, IR_RET, 3, 0, 0);
+    emit(func, 2, IR_LOAD, 0, 2, 0);
+    ir_append_function(module, func);
+
+    failures += report("hot fall off the end chained to the entry", ir_place_blocks(func));
+    failures += report("moved fall off the end returns", count_ops(func, IR_RET) == 2);
+    failures += report("moved fall off the end returns 0", ir_interp_module(module, "falls").value == 0);
+
+    ir_free_module(module);
+    return failures != 0;
+}
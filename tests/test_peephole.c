@@ -0,0 +1,64 @@
+#include "../x86_peephole.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+    Runs the peephole over `func` and compares the printed result with `expected`.
+*/
+static int check(const char *name, MIR_Function *func, const char *expected) {
+    char buffer[1024] = {0};
+    FILE *fp = tmpfile();
+    static Emitter e;
+    emit_open_fd(&e, fileno(fp));
+    x86_peephole(func);
+    mir_print_function(&e, func);
+    emit_close(&e);
+    rewind(fp);
+    fread(buffer, 1, sizeof(buffer) - 1, fp);
+    fclose(fp);
+    mir_free_function(func);
+    const int ok = strcmp(buffer, expected) == 0;
+    printf("%s: %s\n", ok ? "true" : "false", name);
+    if (!ok) {
+        printf("%s", buffer);
+    }
+    return !ok;
+}
+
+int main(void) {
+    const MIR_Operand eax = mir_preg(MIR_RAX);
+    const MIR_Operand ecx = mir_preg(MIR_RCX);
+    const MIR_Operand esi = mir_preg(MIR_RSI);
+    const MIR_Operand slot = mir_mem(MIR_RBP, -8);
+    int failures = 0;
+
+    MIR_Function *func = mir_new_function("f", false);
+    mir_emit(func, MIR_MOV, 4, 2, ecx, slot);
+    mir_emit(func, MIR_MOV, 4, 2, slot, eax);
+    mir_emit(func, MIR_MOV, 4, 2, eax, eax);
+    failures += check("store to load forwarding", func, "f:\n    movl %ecx, -8(%rbp)\n    movl %ecx, %eax\n");
+
+    func = mir_new_function("f", false);
+    mir_emit_jcc(func, MIR_COND_L, 1);
+    mir_emit(func, MIR_JMP, 8, 1, mir_label(2));
+    mir_add_block(func, "block_1");
+    mir_emit(func, MIR_JMP, 8, 1, mir_label(3));
+    mir_add_block(func, "block_2");
+    mir_emit(func, MIR_JMP, 8, 1, mir_label(3));
+    mir_add_block(func, "block_3");
+    mir_emit(func, MIR_RET, 8, 0);
+    failures += check("jump chains", func, "f:\nblock_1:\nblock_2:\nblock_3:\n    ret\n");
+
+    func = mir_new_function("f", false);
+    mir_emit(func, MIR_SUB, 4, 2, esi, ecx);
+    mir_emit(func, MIR_TEST, 4, 2, ecx, ecx);
+    mir_emit_jcc(func, MIR_COND_NE, 0);
+    mir_emit(func, MIR_IMUL, 4, 2, esi, ecx);
+    mir_emit(func, MIR_TEST, 4, 2, ecx, ecx);
+    mir_emit_jcc(func, MIR_COND_NE, 0);
+    failures += check("test after arithmetic", func,
+                      "f:\n    subl %esi, %ecx\n    jne f\n    imull %esi, %ecx\n    testl %ecx, %ecx\n    jne f\n");
+
+    x86_peephole_print_stats();
+    return failures != 0;
+}
@@ -0,0 +1,42 @@
+#include "../ir_rotate.h"
+#include "../ir_interp.h"
+#include "ir_test.h"
+
+int main(void) {
+    IR_Module *module = ir_new_module();
+    int failures = 0;
+
+    // s = 0; i = 0; while (i < 10) { s = s + i; i = i + 1; } return s;
+    IR_Function *func = ir_new_function("sum");
+    for (int b = 0; b < 3; b++) {
+        ir_new_label(func);
+    }
+    func->next_reg = 6;
+    emit(func, 0, IR_LOAD, 0, 0, 0);
+    emit(func, 0, IR_LOAD, 1, 0, 0);
+    emit(func, 0, IR_LOAD, 2, 10, 0);
+    emit(func, 1, IR_CMP_LT, 3, 1, 2);
+    emit(func, 1, IR_BR_EQ, 3, 2, 3);
+    emit(func, 2, IR_ADD, 0, 0, 1);
+    emit(func, 2, IR_LOAD, 4, 1, 0);
+    emit(func, 2, IR_ADD, 1, 1, 4);
+    emit(func, 2, IR_BR, 1, 0, 0);
+    emit(func, 3, IR_RET, 0, 0, 0);
+    ir_append_function(module, func);
+
+    IR_Program *program = ir_interp_compile(func);
+    const long long before = ir_interp_run(program, IR_INTERP_NO_BUDGET).executed;
+    ir_interp_free(program);
+    failures += report("loop rotated", ir_rotate_loops(func));
+    const IR_Block *latch = &func->blocks[2];
+    const IR_Instruction *test = &latch->instructions[latch->count - 1];
+    failures += report("latch tests at the bottom", test->op == IR_BR_EQ && test->a == 2 && test->b == 3);
+    failures += report("no branch back to the guard", count_ops(func, IR_BR) == 0);
+    const IR_InterpResult after = ir_interp_module(module, "sum");
+    failures += report("rotated loop keeps the result", after.value == 45);
+    failures += report("iterations run fewer branches", after.executed < before);
+    failures += report("rotated loop left alone", !ir_rotate_loops(func));
+
+    ir_free_module(module);
+    return failures != 0;
+}
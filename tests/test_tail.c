@@ -0,0 +1,76 @@
+#include "../ir_interp.h"
+#include "../ir_tail.h"
+#include "ir_test.h"
+
+int main(void) {
+    IR_Module *module = ir_new_module();
+    int failures = 0;
+
+    // main() { return sum(100, 0) + odd(7); }
+    IR_Function *func = ir_new_function("main");
+    func->next_reg = 5;
+    emit(func, 0, IR_LOAD, 0, 100, 0);
+    emit(func, 0, IR_LOAD, 1, 0, 0);
+    emit(func, 0, IR_ARG, 0, 0, 0);
+    emit(func, 0, IR_ARG, 0, 1, 1);
+    emit(func, 0, IR_CALL, 2, ir_add_callee(func, "sum"), 2);
+    emit(func, 0, IR_LOAD, 0, 7, 0);
+    emit(func, 0, IR_ARG, 0, 0, 0);
+    emit(func, 0, IR_CALL, 3, ir_add_callee(func, "odd"), 1);
+    emit(func, 0, IR_ADD, 4, 2, 3);
+    emit(func, 0, IR_RET, 4, 0, 0);
+    ir_append_function(module, func);
+
+    // sum(n, acc) { if (n) { return sum(n - 1, acc + n); } return acc; }
+    IR_Function *sum = ir_new_function("sum");
+    for (int b = 0; b < 2; b++) {
+        ir_new_label(sum);
+    }
+    sum->next_reg = 6;
+    sum->param_count = 2;
+    emit(sum, 0, IR_PARAM, 0, 0, 0);
+    emit(sum, 0, IR_PARAM, 1, 1, 0);
+    emit(sum, 0, IR_BR_EQ, 0, 1, 2);
+    emit(sum, 1, IR_LOAD, 2, 1, 0);
+    emit(sum, 1, IR_SUB, 3, 0, 2);
+    emit(sum, 1, IR_ADD, 4, 1, 0);
+    emit(sum, 1, IR_ARG, 0, 3, 0);
+    emit(sum, 1, IR_ARG, 0, 4, 1);
+    emit(sum, 1, IR_CALL, 5, ir_add_callee(sum, "sum"), 2);
+    emit(sum, 1, IR_RET, 5, 0, 0);
+    emit(sum, 2, IR_RET, 1, 0, 0);
+    ir_append_function(module, sum);
+
+    // odd(n) { if (n) { return even(n - 1); } return 0; } and even the other way round
+    for (int f = 0; f < 2; f++) {
+        func = ir_new_function(f == 0 ? "odd" : "even");
+        for (int b = 0; b < 2; b++) {
+            ir_new_label(func);
+        }
+        func->next_reg = 5;
+        func->param_count = 1;
+        emit(func, 0, IR_PARAM, 0, 0, 0);
+        emit(func, 0, IR_BR_EQ, 0, 1, 2);
+        emit(func, 1, IR_LOAD, 1, 1, 0);
+        emit(func, 1, IR_SUB, 2, 0, 1);
+        emit(func, 1, IR_ARG, 0, 2, 0);
+        emit(func, 1, IR_CALL, 3, ir_add_callee(func, f == 0 ? "even" : "odd"), 1);
+        emit(func, 1, IR_RET, 3, 0, 0);
+        emit(func, 2, IR_LOAD, 4, f, 0);
+        emit(func, 2, IR_RET, 4, 0, 0);
+        ir_append_function(module, func);
+    }
+
+    failures += report("caller has no tail calls", !ir_eliminate_tail_calls(module->functions[0]));
+    failures += report("self tail call rewritten", ir_eliminate_tail_calls(sum));
+    failures += report("self tail call is a loop", count_ops(sum, IR_CALL) == 0 && count_ops(sum, IR_TAIL_CALL) == 0);
+    failures += report("entry split after params", sum->block_count == 4 && sum->blocks[0].count == 3);
+    for (int f = 2; f < 4; f++) {
+        ir_eliminate_tail_calls(module->functions[f]);
+    }
+    failures += report("mutual recursion jumps to the other function", count_ops(module->functions[2], IR_TAIL_CALL) == 1);
+    failures += report("main returns 5051", ir_interp_module(module, "main").value == 5051);
+
+    ir_free_module(module);
+    return failures != 0;
+}
@@ -105,6 +105,33 @@ void print_token_type(const TokenType type) {
     case TK_COMMA:
         printf("\',\'");
         break;
+    case TK_EQ_EQ:
+        printf("\'==\'");
+        break;
+    case TK_NOT_EQ:
+        printf("\'!=\'");
+        break;
+    case TK_LT:
+        printf("\'<\'");
+        break;
+    case TK_LT_EQ:
+        printf("\'<=\'");
+        break;
+    case TK_GT:
+        printf("\'>\'");
+        break;
+    case TK_GT_EQ:
+        printf("\'>=\'");
+        break;
+    case TK_AND_AND:
+        printf("\'&&\'");
+        break;
+    case TK_OR_OR:
+        printf("\'||\'");
+        break;
+    case TK_NOT:
+        printf("\'!\'");
+        break;
     case TK_RETURN:
         printf("Return");
         break;
@@ -143,6 +170,14 @@ void print_token(const Token *token) {
 
 bool is_binary_operator(const TokenType type) {
     switch (type) {
+    case TK_OR_OR:
+    case TK_AND_AND:
+    case TK_EQ_EQ:
+    case TK_NOT_EQ:
+    case TK_LT:
+    case TK_LT_EQ:
+    case TK_GT:
+    case TK_GT_EQ:
     case TK_PLUS:
     case TK_MINUS:
     case TK_MULTIPLY:
@@ -156,6 +191,14 @@ bool is_binary_operator(const TokenType type) {
 
 int associativity(const TokenType type) {
     switch (type) {
+    case TK_OR_OR:
+    case TK_AND_AND:
+    case TK_EQ_EQ:
+    case TK_NOT_EQ:
+    case TK_LT:
+    case TK_LT_EQ:
+    case TK_GT:
+    case TK_GT_EQ:
     case TK_PLUS:
     case TK_MINUS:
     case TK_MULTIPLY:
@@ -172,14 +215,26 @@ int associativity(const TokenType type) {
 
 int precedence(const TokenType type) {
     switch (type) {
+    case TK_OR_OR:
+        return 0;
+    case TK_AND_AND:
+        return 1;
+    case TK_EQ_EQ:
+    case TK_NOT_EQ:
+        return 2;
+    case TK_LT:
+    case TK_LT_EQ:
+    case TK_GT:
+    case TK_GT_EQ:
+        return 3;
     case TK_PLUS:
     case TK_MINUS:
-        return 0;
+        return 4;
     case TK_MULTIPLY:
     case TK_DIVIDE:
-        return 1;
+        return 5;
     case TK_EXP:
-        return 2;
+        return 6;
     default:
         print_token_type(type);
         printf("Tried to get the precedence of a token which is not a binary "
@@ -200,6 +255,7 @@ Tokenizer t_new_tokenizer(const char *src, const int src_size){
     tokenizer.size = src_size;
     tokenizer.src = src;
     tokenizer.buf.size = 0;
+    memset(tokenizer.buf.buf, 0, sizeof(tokenizer.buf.buf));
     ta_init(&tokenizer.tokens);
     return tokenizer;
 }
@@ -304,6 +360,12 @@ TokenType char_to_token_type(const char c) {
         return TK_EXP;
     case '=':
         return TK_EQ;
+    case '<':
+        return TK_LT;
+    case '>':
+        return TK_GT;
+    case '!':
+        return TK_NOT;
     case '(':
         return TK_OPEN_PAREN;
     case ')':
@@ -319,6 +381,39 @@ TokenType char_to_token_type(const char c) {
     }
 }
 
+/*
+    Two character operators, `==`, `!=`, `<=`, `>=`, `&&` and `||`
+*/
+static bool t_two_char_token_type(const char c, const char next, TokenType *type) {
+    if (c == '&' && next == '&') {
+        *type = TK_AND_AND;
+        return true;
+    }
+    if (c == '|' && next == '|') {
+        *type = TK_OR_OR;
+        return true;
+    }
+    if (next != '=') {
+        return false;
+    }
+    switch (c) {
+    case '=':
+        *type = TK_EQ_EQ;
+        return true;
+    case '!':
+        *type = TK_NOT_EQ;
+        return true;
+    case '<':
+        *type = TK_LT_EQ;
+        return true;
+    case '>':
+        *type = TK_GT_EQ;
+        return true;
+    default:
+        return false;
+    }
+}
+
 static void t_skip_comments(Tokenizer *tk) {
     t_skip(tk); // '/'
     // Single line comment
@@ -330,7 +425,7 @@ static void t_skip_comments(Tokenizer *tk) {
         t_skip(tk);                 // '\n'
     } else if (t_peek(tk) == '*') { // Multi-line comments
         t_skip(tk);                 // '*'
-        while (t_peek(tk) != '*' && t_peek_next(tk) != '/') {
+        while (!(t_peek(tk) == '*' && t_peek_next(tk) == '/')) {
             t_skip(tk);
         }
         t_skip(tk);
@@ -366,12 +461,18 @@ void t_tokenize(Tokenizer *tk) {
             t_buffer_reset(tk);
         } else if (is_whitespace(c)) {
             t_skip(tk);
-        } else if (t_peek(tk) == '/') {
+        } else if (c == '/' && (t_peek_next(tk) == '/' || t_peek_next(tk) == '*')) {
             t_skip_comments(tk);
         } else {
             // Handle special cases
+            TokenType type;
             t_consume(tk);
-            t_push_buffer(tk,char_to_token_type(c));
+            if (!t_is_eof(tk) && t_two_char_token_type(c, t_peek(tk), &type)) {
+                t_consume(tk);
+            } else {
+                type = char_to_token_type(c);
+            }
+            t_push_buffer(tk,type);
         }
     }
 }
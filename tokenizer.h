@@ -47,6 +47,15 @@ typedef enum {
     TK_OPEN_CURLY,
     TK_CLOSE_CURLY,
     TK_COMMA,
+    TK_EQ_EQ,
+    TK_NOT_EQ,
+    TK_LT,
+    TK_LT_EQ,
+    TK_GT,
+    TK_GT_EQ,
+    TK_AND_AND,
+    TK_OR_OR,
+    TK_NOT,
     // Other
     TK_INT_LITERAL,
     TK_FLT_LITERAL,
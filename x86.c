@@ -1,82 +1,1005 @@
 #include "x86.h"
 
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
 #include "ir.h"
+#include "ir_cfg.h"
+#include "mir.h"
+#include "x86_encode.h"
+#include "x86_peephole.h"
+#include "x86_regalloc.h"
+#include "x86_select.h"
+
+/*
+    Operands covered by a constant are renamed to pseudo registers naming an immediate, see x86_resolve().
+*/
+#define X86_IMM_REG(i) (-2 - (i))
+
+static bool x86_is_imm(const int reg) { return reg <= X86_IMM_REG(0); }
+
+static int x86_imm_value(const X86_Context *ctx, const int reg) { return ctx->imm_values[X86_IMM_REG(0) - reg]; }
+
+static bool x86_is_imm_value(const X86_Context *ctx, const int reg, const int value) {
+    return x86_is_imm(reg) && x86_imm_value(ctx, reg) == value;
+}
+
+static bool x86_in_reg(const X86_Context *ctx, const int reg) {
+    return !x86_is_imm(reg) && ctx->alloc->location[reg] != X86_NO_REG;
+}
+
+static bool x86_in_memory(const X86_Context *ctx, const int reg) { return !x86_is_imm(reg) && !x86_in_reg(ctx, reg); }
+
+#define X86_EAX mir_preg(MIR_RAX)
+#define X86_EDX mir_preg(MIR_RDX)
+
+// IR block `b` is MIR block `b + 1`, after the entry block holding the prologue
+#define X86_BLOCK(b) ((b) + 1)
+
+/*
+    The operand naming an IR register, an immediate, its physical register or its stack slot.
+*/
+static MIR_Operand x86_operand(const X86_Context *ctx, const int reg) {
+    if (x86_is_imm(reg)) {
+        return mir_imm(x86_imm_value(ctx, reg));
+    }
+    const int location = ctx->alloc->location[reg];
+    if (location != X86_NO_REG) {
+        return mir_preg(x86_preg(location));
+    }
+    return x86_frame_slot(ctx->frame, ctx->alloc->slot_offset[reg]);
+}
+
+/*
+    The physical register of an IR register which has one.
+*/
+static MIR_PReg x86_location(const X86_Context *ctx, const int reg) { return x86_preg(ctx->alloc->location[reg]); }
+
+static bool x86_same_location(const X86_Context *ctx, const int a, const int b) {
+    if (a == b) {
+        return true;
+    }
+    if (x86_is_imm(a) || x86_is_imm(b)) {
+        return false;
+    }
+    if (x86_in_reg(ctx, a) || x86_in_reg(ctx, b)) {
+        return ctx->alloc->location[a] == ctx->alloc->location[b];
+    }
+    // Registers that are never live at once can share a slot
+    return ctx->alloc->slot_offset[a] == ctx->alloc->slot_offset[b];
+}
+
+/*
+    Copies `src` into `dst`, going through %eax when both live in memory.
+*/
+static void x86_gen_move(MIR_Function *mir, const X86_Context *ctx, const int dst, const int src) {
+    if (x86_same_location(ctx, dst, src)) {
+        return;
+    }
+    if (x86_in_memory(ctx, dst) && x86_in_memory(ctx, src)) {
+        mir_emit(mir, MIR_MOV, 4, 2, x86_operand(ctx, src), X86_EAX);
+        mir_emit(mir, MIR_MOV, 4, 2, X86_EAX, x86_operand(ctx, dst));
+        return;
+    }
+    mir_emit(mir, MIR_MOV, 4, 2, x86_operand(ctx, src), x86_operand(ctx, dst));
+}
+
+/*
+    Copies every `src[i]` into `dst[i]` as if all at once, a register is only written once no other move still reads it.
+    Memory to memory moves go through %eax before anything else,
+    Registers left waiting on each other form cycles, which are broken by saving one of them in %eax.
+*/
+static void x86_gen_parallel_move(MIR_Function *mir, const MIR_Operand *dst, MIR_Operand *src, const int count) {
+    bool *done = calloc(count + 1, sizeof(bool));
+    if (done == NULL) {
+        printf("Failed to allocate parallel move\n");
+        exit(1);
+    }
+    int remaining = count;
+    for (int i = 0; i < count; i++) {
+        if (mir_same_operand(&dst[i], &src[i])) {
+            done[i] = true;
+            remaining--;
+        } else if (dst[i].kind == MIR_MEM && src[i].kind == MIR_MEM) {
+            mir_emit(mir, MIR_MOV, 4, 2, src[i], X86_EAX);
+            mir_emit(mir, MIR_MOV, 4, 2, X86_EAX, dst[i]);
+            done[i] = true;
+            remaining--;
+        }
+    }
+    while (remaining > 0) {
+        int ready = -1;
+        for (int i = 0; i < count && ready == -1; i++) {
+            bool blocked = false;
+            for (int j = 0; j < count && !done[i] && dst[i].kind == MIR_PREG; j++) {
+                blocked |= j != i && !done[j] && src[j].kind == MIR_PREG && src[j].reg == dst[i].reg;
+            }
+            if (!done[i] && !blocked) {
+                ready = i;
+            }
+        }
+        if (ready == -1) {
+            for (ready = 0; done[ready]; ready++) {
+            }
+            mir_emit(mir, MIR_MOV, 4, 2, dst[ready], X86_EAX);
+            for (int j = 0; j < count; j++) {
+                if (!done[j] && j != ready && src[j].kind == MIR_PREG && src[j].reg == dst[ready].reg) {
+                    src[j] = X86_EAX;
+                }
+            }
+        }
+        mir_emit(mir, MIR_MOV, 4, 2, src[ready], dst[ready]);
+        done[ready] = true;
+        remaining--;
+    }
+    free(done);
+}
+
+/*
+    `dst = a op b` for two operand instructions, working in place when `dst` has a register.
+*/
+static void x86_gen_binary(MIR_Function *mir, const X86_Context *ctx, const MIR_Op op, const bool commutative,
+                           const IR_Instruction *instr) {
+    const MIR_Operand dst = x86_operand(ctx, instr->dst);
+    if (x86_in_reg(ctx, instr->dst) && !x86_same_location(ctx, instr->dst, instr->b)) {
+        x86_gen_move(mir, ctx, instr->dst, instr->a);
+        mir_emit(mir, op, 4, 2, x86_operand(ctx, instr->b), dst);
+        return;
+    }
+    if (x86_in_reg(ctx, instr->dst) && commutative) {
+        mir_emit(mir, op, 4, 2, x86_operand(ctx, instr->a), dst);
+        return;
+    }
+    mir_emit(mir, MIR_MOV, 4, 2, x86_operand(ctx, instr->a), X86_EAX);
+    mir_emit(mir, op, 4, 2, x86_operand(ctx, instr->b), X86_EAX);
+    mir_emit(mir, MIR_MOV, 4, 2, X86_EAX, dst);
+}
+
+static void x86_gen_shift(MIR_Function *mir, const X86_Context *ctx, const MIR_Op op, const IR_Instruction *instr) {
+    if (x86_in_reg(ctx, instr->dst)) {
+        x86_gen_move(mir, ctx, instr->dst, instr->a);
+        mir_emit(mir, op, 4, 2, mir_imm(instr->b), x86_operand(ctx, instr->dst));
+        return;
+    }
+    mir_emit(mir, MIR_MOV, 4, 2, x86_operand(ctx, instr->a), X86_EAX);
+    mir_emit(mir, op, 4, 2, mir_imm(instr->b), X86_EAX);
+    mir_emit(mir, MIR_MOV, 4, 2, X86_EAX, x86_operand(ctx, instr->dst));
+}
+
+/*
+    Sets the flags for comparing `a` with `b`,
+    Returns the comparison to test them with, which is swapped when only `b` could be the cmpl destination.
+*/
+static IR_OP x86_gen_compare(MIR_Function *mir, const X86_Context *ctx, const IR_Instruction *cmp) {
+    if (x86_in_reg(ctx, cmp->a)) {
+        mir_emit(mir, MIR_CMP, 4, 2, x86_operand(ctx, cmp->b), x86_operand(ctx, cmp->a));
+        return cmp->op;
+    }
+    if (x86_is_imm(cmp->a) && !x86_is_imm(cmp->b)) {
+        mir_emit(mir, MIR_CMP, 4, 2, x86_operand(ctx, cmp->a), x86_operand(ctx, cmp->b));
+        return ir_compare_swap(cmp->op);
+    }
+    mir_emit(mir, MIR_MOV, 4, 2, x86_operand(ctx, cmp->a), X86_EAX);
+    mir_emit(mir, MIR_CMP, 4, 2, x86_operand(ctx, cmp->b), X86_EAX);
+    return cmp->op;
+}
 
-static int ir_reg_to_rbp(const int a) { return a * 8 + 8; }
+/*
+    Condition code for setcc/jcc that holds when the comparison does.
+*/
+static MIR_Cond x86_condition(const IR_OP op) {
+    switch (op) {
+    case IR_CMP_EQ:
+        return MIR_COND_E;
+    case IR_CMP_NE:
+        return MIR_COND_NE;
+    case IR_CMP_LT:
+        return MIR_COND_L;
+    case IR_CMP_LE:
+        return MIR_COND_LE;
+    case IR_CMP_GT:
+        return MIR_COND_G;
+    case IR_CMP_GE:
+        return MIR_COND_GE;
+    default:
+        printf("Tried to get the condition code of a non comparison IR op\n");
+        exit(1);
+    }
+}
 
-void x86_gen_instruction(FILE *fp, const IR_Instruction *instr) {
+/*
+    Jumps to `if_true` when the condition holds and `if_false` otherwise,
+    Leaving out whichever jump would land on the next block.
+*/
+static void x86_gen_cond_branch(MIR_Function *mir, const X86_Context *ctx, const IR_OP cond, const int if_true, const int if_false) {
+    const int next = ctx->block + 1;
+    if (if_true == next) {
+        mir_emit_jcc(mir, x86_condition(ir_compare_negate(cond)), X86_BLOCK(if_false));
+        return;
+    }
+    mir_emit_jcc(mir, x86_condition(cond), X86_BLOCK(if_true));
+    if (if_false != next) {
+        mir_emit(mir, MIR_JMP, 8, 1, mir_label(X86_BLOCK(if_false)));
+    }
+}
+
+/*
+    Copies the select's `b` into its `dst` when the flags satisfy `cond`,
+    Through %eax when `dst` has no register, as cmov only writes registers.
+*/
+static void x86_gen_cmov(MIR_Function *mir, const X86_Context *ctx, const MIR_Cond cond, const IR_Instruction *select) {
+    const MIR_Operand dst = x86_operand(ctx, select->dst);
+    if (x86_in_reg(ctx, select->dst)) {
+        mir_emit_cmov(mir, cond, x86_operand(ctx, select->b), dst);
+        return;
+    }
+    mir_emit(mir, MIR_MOV, 4, 2, dst, X86_EAX);
+    mir_emit_cmov(mir, cond, x86_operand(ctx, select->b), X86_EAX);
+    mir_emit(mir, MIR_MOV, 4, 2, X86_EAX, dst);
+}
+
+/*
+    The fixed template for each IR op, used when no tile in X86_TILES does better.
+*/
+void x86_gen_instruction(MIR_Function *mir, const X86_Context *ctx, const IR_Instruction *instr) {
+    // Branches keep a block id in `dst`
+    const MIR_Operand dst = instr->op == IR_BR ? mir_label(X86_BLOCK(instr->dst)) : x86_operand(ctx, instr->dst);
     switch (instr->op) {
     case IR_ADD:
-        fprintf(fp, "    movl -%d(%%rbp), %%eax\n", ir_reg_to_rbp(instr->a));
-        fprintf(fp, "    addl -%d(%%rbp), %%eax\n", ir_reg_to_rbp(instr->b));
-        fprintf(fp, "    movl %%eax, -%d(%%rbp)\n", ir_reg_to_rbp(instr->dst));
+        x86_gen_binary(mir, ctx, MIR_ADD, true, instr);
         break;
     case IR_SUB:
-        fprintf(fp, "    movl -%d(%%rbp), %%eax\n", ir_reg_to_rbp(instr->a));
-        fprintf(fp, "    subl -%d(%%rbp), %%eax\n", ir_reg_to_rbp(instr->b));
-        fprintf(fp, "    movl %%eax, -%d(%%rbp)\n", ir_reg_to_rbp(instr->dst));
+        x86_gen_binary(mir, ctx, MIR_SUB, false, instr);
         break;
     case IR_MUL:
-        fprintf(fp, "    movl -%d(%%rbp), %%eax\n", ir_reg_to_rbp(instr->a));
-        fprintf(fp, "    imull -%d(%%rbp)\n", ir_reg_to_rbp(instr->b));
-        fprintf(fp, "    movl %%eax, -%d(%%rbp)\n", ir_reg_to_rbp(instr->dst));
+        x86_gen_binary(mir, ctx, MIR_IMUL, true, instr);
         break;
     case IR_DIV:
-        fprintf(fp, "    movl -%d(%%rbp), %%eax\n", ir_reg_to_rbp(instr->a));
-        fprintf(fp, "    idivl -%d(%%rbp)\n", ir_reg_to_rbp(instr->b));
-        fprintf(fp, "    movl %%eax, -%d(%%rbp)\n", ir_reg_to_rbp(instr->dst));
+        mir_emit(mir, MIR_MOV, 4, 2, x86_operand(ctx, instr->a), X86_EAX);
+        mir_emit(mir, MIR_CLTD, 4, 0);
+        mir_emit(mir, MIR_IDIV, 4, 1, x86_operand(ctx, instr->b));
+        mir_emit(mir, MIR_MOV, 4, 2, X86_EAX, dst);
+        break;
+    case IR_SHL:
+        x86_gen_shift(mir, ctx, MIR_SHL, instr);
+        break;
+    case IR_SAR:
+        x86_gen_shift(mir, ctx, MIR_SAR, instr);
+        break;
+    case IR_SHR:
+        x86_gen_shift(mir, ctx, MIR_SHR, instr);
+        break;
+    case IR_LEA:
+        if (x86_in_reg(ctx, instr->a)) {
+            const MIR_PReg a = x86_location(ctx, instr->a);
+            mir_emit(mir, MIR_LEA, 4, 2, mir_mem_index(a, a, 1 << instr->b, 0), x86_in_reg(ctx, instr->dst) ? dst : X86_EAX);
+        } else {
+            mir_emit(mir, MIR_MOV, 4, 2, x86_operand(ctx, instr->a), X86_EAX);
+            mir_emit(mir, MIR_LEA, 4, 2, mir_mem_index(MIR_RAX, MIR_RAX, 1 << instr->b, 0), X86_EAX);
+        }
+        if (!x86_in_reg(ctx, instr->dst) || !x86_in_reg(ctx, instr->a)) {
+            mir_emit(mir, MIR_MOV, 4, 2, X86_EAX, dst);
+        }
+        break;
+    case IR_MULH: {
+        // One operand imull only takes a register or memory, an immediate goes into %eax instead
+        const bool swap = x86_is_imm(instr->b);
+        mir_emit(mir, MIR_MOV, 4, 2, x86_operand(ctx, swap ? instr->b : instr->a), X86_EAX);
+        mir_emit(mir, MIR_IMUL, 4, 1, x86_operand(ctx, swap ? instr->a : instr->b));
+        mir_emit(mir, MIR_MOV, 4, 2, X86_EDX, dst);
+        break;
+    }
+    case IR_POW:
+        // Through %eax in case the base lives in %esi
+        mir_emit(mir, MIR_MOV, 4, 2, x86_operand(ctx, instr->b), X86_EAX);
+        mir_emit(mir, MIR_MOV, 4, 2, x86_operand(ctx, instr->a), mir_preg(MIR_RDI));
+        mir_emit(mir, MIR_MOV, 4, 2, X86_EAX, mir_preg(MIR_RSI));
+        mir_emit(mir, MIR_CALL, 8, 1, mir_symbol(X86_POW_HELPER));
+        mir_emit(mir, MIR_MOV, 4, 2, X86_EAX, dst);
         break;
     case IR_LOAD:
-        fprintf(fp, "    movl $%d, -%d(%%rbp)\n", instr->a, ir_reg_to_rbp(instr->dst));
+        mir_emit(mir, MIR_MOV, 4, 2, mir_imm(instr->a), dst);
         break;
     case IR_STORE:
-        fprintf(fp, "    movl -%d(%%rbp), %%eax\n", ir_reg_to_rbp(instr->a));
-        fprintf(fp, "    movl %%eax, -%d(%%rbp)\n", ir_reg_to_rbp(instr->dst));
+        x86_gen_move(mir, ctx, instr->dst, instr->a);
+        break;
+    case IR_SELECT:
+        if (x86_in_reg(ctx, instr->a)) {
+            mir_emit(mir, MIR_TEST, 4, 2, x86_operand(ctx, instr->a), x86_operand(ctx, instr->a));
+        } else {
+            mir_emit(mir, MIR_MOV, 4, 2, x86_operand(ctx, instr->a), X86_EAX);
+            mir_emit(mir, MIR_TEST, 4, 2, X86_EAX, X86_EAX);
+        }
+        x86_gen_cmov(mir, ctx, MIR_COND_NE, instr);
         break;
     case IR_RET:
-        fprintf(fp, "    movl -%d(%%rbp), %%eax\n", ir_reg_to_rbp(instr->dst));
-        fprintf(fp, "    jmp return\n");
+        mir_emit(mir, MIR_MOV, 4, 2, dst, X86_EAX);
+        // Outside the frame there is nothing to pop
+        if (ctx->frame->framed[ctx->block]) {
+            mir_emit(mir, MIR_JMP, 8, 1, mir_label(ctx->return_block));
+        } else {
+            mir_emit(mir, MIR_RET, 8, 0);
+        }
         break;
     case IR_BR:
-        fprintf(fp, "    jmp block_%d\n", instr->dst);
+        if (instr->dst != ctx->block + 1) {
+            mir_emit(mir, MIR_JMP, 8, 1, dst);
+        }
         break;
     case IR_BR_EQ:
-        fprintf(fp, "    movl -%d(%%rbp), %%eax\n", ir_reg_to_rbp(instr->dst));
-        fprintf(fp, "    testl %%eax, %%eax\n");
-        fprintf(fp, "    jz block_%d\n", instr->b);
+        if (x86_in_reg(ctx, instr->dst)) {
+            mir_emit(mir, MIR_TEST, 4, 2, dst, dst);
+        } else {
+            mir_emit(mir, MIR_MOV, 4, 2, dst, X86_EAX);
+            mir_emit(mir, MIR_TEST, 4, 2, X86_EAX, X86_EAX);
+        }
+        x86_gen_cond_branch(mir, ctx, IR_CMP_NE, instr->a, instr->b);
         break;
+    case IR_CMP_EQ:
+    case IR_CMP_NE:
+    case IR_CMP_LT:
+    case IR_CMP_LE:
+    case IR_CMP_GT:
+    case IR_CMP_GE: {
+        const IR_OP cond = x86_gen_compare(mir, ctx, instr);
+        mir_emit_setcc(mir, x86_condition(cond), X86_EAX);
+        if (x86_in_reg(ctx, instr->dst)) {
+            mir_emit(mir, MIR_MOVZB, 4, 2, X86_EAX, dst);
+        } else {
+            mir_emit(mir, MIR_MOVZB, 4, 2, X86_EAX, X86_EAX);
+            mir_emit(mir, MIR_MOV, 4, 2, X86_EAX, dst);
+        }
+        break;
+    }
     default:
         break;
     }
 }
 
-void x86_gen_block(FILE *fp, const IR_Block *block) {
+/*
+    Rewrites operand `slot` (in `ir_instruction_uses()` order) of the instruction.
+*/
+static void x86_set_operand(IR_Instruction *instr, const int slot, const int reg) {
+    if (instr->op == IR_RET || instr->op == IR_BR_EQ) {
+        instr->dst = reg;
+    } else if (slot == 0) {
+        instr->a = reg;
+    } else {
+        instr->b = reg;
+    }
+}
+
+/*
+    A copy of instruction `k` whose operands covered by constants name immediates.
+*/
+static IR_Instruction x86_resolve(X86_Context *ctx, const int k) {
+    const X86_Selection *sel = ctx->sel;
+    IR_Instruction view = *sel->instructions[k];
+    for (int slot = 0; slot < 2; slot++) {
+        const int child = sel->child[slot][k];
+        if (child == -1 || sel->instructions[child]->op != IR_LOAD) {
+            continue;
+        }
+        if (ctx->imm_count >= X86_MAX_IMMEDIATES) {
+            printf("Too many immediates in one tile\n");
+            exit(1);
+        }
+        const int i = ctx->imm_count++;
+        ctx->imm_values[i] = sel->instructions[child]->a;
+        x86_set_operand(&view, slot, X86_IMM_REG(i));
+    }
+    return view;
+}
+
+/*
+    The covered shift producing one of an add's operands, `slot` is set to the operand it produces, -1 if there is none.
+*/
+static const IR_Instruction *x86_shift_child(const X86_Context *ctx, const int k, int *slot) {
+    *slot = -1;
+    for (int s = 0; s < 2; s++) {
+        const int child = ctx->sel->child[s][k];
+        if (child != -1 && ctx->sel->instructions[child]->op == IR_SHL) {
+            *slot = s;
+            return ctx->sel->instructions[child];
+        }
+    }
+    return NULL;
+}
+
+/*
+    The covered shift a scaled add tile was chosen for, `slot` is set to the operand it produces.
+*/
+static const IR_Instruction *x86_scaled_shift(const X86_Context *ctx, const int k, int *slot) {
+    const IR_Instruction *shift = x86_shift_child(ctx, k, slot);
+    if (shift == NULL) {
+        printf("Add tiled as scaled has no covered shift\n");
+        exit(1);
+    }
+    return shift;
+}
+
+static int x86_operand_at(const IR_Instruction *instr, const int slot) { return slot == 0 ? instr->a : instr->b; }
+
+// System V passes the first six integer arguments in registers and the rest on the stack
+static const MIR_PReg X86_ARG_REGS[] = {MIR_RDI, MIR_RSI, MIR_RDX, MIR_RCX, MIR_R8, MIR_R9};
+
+/*
+    Where argument `index` arrives in the callee.
+*/
+static MIR_Operand x86_param_operand(const X86_Context *ctx, const int index) {
+    if (index < X86_ARG_REG_COUNT) {
+        return mir_preg(X86_ARG_REGS[index]);
+    }
+    return x86_frame_param(ctx->frame, index - X86_ARG_REG_COUNT);
+}
+
+/*
+    The value passed by the IR_ARG at `k`, a covered constant is passed as an immediate.
+*/
+static MIR_Operand x86_arg_operand(const X86_Context *ctx, const int k) {
+    const IR_Instruction *arg = ctx->sel->instructions[k];
+    const int child = ctx->sel->child[0][k];
+    return child != -1 ? mir_imm(ctx->sel->instructions[child]->a) : x86_operand(ctx, arg->a);
+}
+
+/*
+    Tiles, each with a cost function returning the instructions it would emit or -1 if it does not match.
+    Ties go to the earlier tile.
+*/
+typedef struct {
+    IR_OP op;
+    const char *name;
+    int (*cost)(const X86_Context *ctx, const IR_Instruction *instr, int k);
+    void (*emit)(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, int k);
+} X86_Tile;
+
+static int cost_zero(const X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    const bool zero = instr->op == IR_LOAD ? instr->a == 0 : x86_is_imm_value(ctx, instr->a, 0);
+    return x86_in_reg(ctx, instr->dst) && zero ? 1 : -1;
+}
+
+static void emit_zero(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    const MIR_Operand dst = x86_operand(ctx, instr->dst);
+    mir_emit(mir, MIR_XOR, 4, 2, dst, dst);
+}
+
+static int cost_copy_elided(const X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    return x86_same_location(ctx, instr->dst, instr->a) ? 0 : -1;
+}
+
+static void emit_nothing(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {}
+
+/*
+    `dst += 1` or `dst -= 1` in place, returns 0 if the instruction is neither.
+*/
+static int x86_step(const X86_Context *ctx, const IR_Instruction *instr) {
+    if (instr->op == IR_ADD && x86_same_location(ctx, instr->dst, instr->a)) {
+        return x86_is_imm_value(ctx, instr->b, 1) ? 1 : x86_is_imm_value(ctx, instr->b, -1) ? -1 : 0;
+    }
+    if (instr->op == IR_ADD && x86_same_location(ctx, instr->dst, instr->b)) {
+        return x86_is_imm_value(ctx, instr->a, 1) ? 1 : x86_is_imm_value(ctx, instr->a, -1) ? -1 : 0;
+    }
+    if (instr->op == IR_SUB && x86_same_location(ctx, instr->dst, instr->a)) {
+        return x86_is_imm_value(ctx, instr->b, 1) ? -1 : x86_is_imm_value(ctx, instr->b, -1) ? 1 : 0;
+    }
+    return 0;
+}
+
+static int cost_inc_dec(const X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    return x86_step(ctx, instr) != 0 ? 1 : -1;
+}
+
+static void emit_inc_dec(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    mir_emit(mir, x86_step(ctx, instr) > 0 ? MIR_INC : MIR_DEC, 4, 1, x86_operand(ctx, instr->dst));
+}
+
+/*
+    `dst = r + k` into another register as `leal k(r), dst`, for sub `k` is negated.
+*/
+static bool x86_lea_disp(const X86_Context *ctx, const IR_Instruction *instr, int *base, int *disp) {
+    if (!x86_in_reg(ctx, instr->dst)) {
+        return false;
+    }
+    for (int slot = 0; slot < (instr->op == IR_ADD ? 2 : 1); slot++) {
+        const int reg = x86_operand_at(instr, slot);
+        const int imm = x86_operand_at(instr, 1 - slot);
+        if (x86_in_reg(ctx, reg) && !x86_same_location(ctx, instr->dst, reg) && x86_is_imm(imm)) {
+            const int value = x86_imm_value(ctx, imm);
+            if (instr->op == IR_SUB && value == INT_MIN) {
+                return false;
+            }
+            *base = reg;
+            *disp = instr->op == IR_SUB ? -value : value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int cost_lea_disp(const X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    int base;
+    int disp;
+    return x86_lea_disp(ctx, instr, &base, &disp) ? 1 : -1;
+}
+
+static void emit_lea_disp(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    int base;
+    int disp;
+    x86_lea_disp(ctx, instr, &base, &disp);
+    mir_emit(mir, MIR_LEA, 4, 2, mir_mem(x86_location(ctx, base), disp), x86_operand(ctx, instr->dst));
+}
+
+static int cost_lea_index(const X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    int slot = -1;
+    if (x86_shift_child(ctx, k, &slot) != NULL) {
+        return -1;
+    }
+    const bool regs = x86_in_reg(ctx, instr->dst) && x86_in_reg(ctx, instr->a) && x86_in_reg(ctx, instr->b);
+    return regs && !x86_same_location(ctx, instr->dst, instr->a) && !x86_same_location(ctx, instr->dst, instr->b) ? 1 : -1;
+}
+
+static void emit_lea_index(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    const MIR_Operand sum = mir_mem_index(x86_location(ctx, instr->a), x86_location(ctx, instr->b), 1, 0);
+    mir_emit(mir, MIR_LEA, 4, 2, sum, x86_operand(ctx, instr->dst));
+}
+
+static int cost_lea_scaled(const X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    int slot = -1;
+    const IR_Instruction *shift = x86_shift_child(ctx, k, &slot);
+    if (shift == NULL) {
+        return -1;
+    }
+    const int other = x86_operand_at(instr, 1 - slot);
+    const bool base = x86_in_reg(ctx, other) || x86_is_imm(other);
+    return x86_in_reg(ctx, instr->dst) && x86_in_reg(ctx, shift->a) && base ? 1 : -1;
+}
+
+static void emit_lea_scaled(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    int slot = -1;
+    const IR_Instruction *shift = x86_scaled_shift(ctx, k, &slot);
+    const int other = x86_operand_at(instr, 1 - slot);
+    const MIR_PReg index = x86_location(ctx, shift->a);
+    MIR_Operand address;
+    if (x86_is_imm(other)) {
+        address = mir_mem_index(MIR_NO_PREG, index, 1 << shift->b, x86_imm_value(ctx, other));
+    } else {
+        address = mir_mem_index(x86_location(ctx, other), index, 1 << shift->b, 0);
+    }
+    mir_emit(mir, MIR_LEA, 4, 2, address, x86_operand(ctx, instr->dst));
+}
+
+static int cost_add_scaled(const X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    int slot = -1;
+    return x86_shift_child(ctx, k, &slot) != NULL ? 4 : -1;
+}
+
+static void emit_add_scaled(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    int slot = -1;
+    const IR_Instruction *shift = x86_scaled_shift(ctx, k, &slot);
+    mir_emit(mir, MIR_MOV, 4, 2, x86_operand(ctx, shift->a), X86_EAX);
+    mir_emit(mir, MIR_SHL, 4, 2, mir_imm(shift->b), X86_EAX);
+    mir_emit(mir, MIR_ADD, 4, 2, x86_operand(ctx, x86_operand_at(instr, 1 - slot)), X86_EAX);
+    mir_emit(mir, MIR_MOV, 4, 2, X86_EAX, x86_operand(ctx, instr->dst));
+}
+
+static int cost_neg_add(const X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    const bool in_place = x86_in_reg(ctx, instr->dst) && x86_same_location(ctx, instr->dst, instr->b);
+    return in_place && !x86_same_location(ctx, instr->dst, instr->a) ? 2 : -1;
+}
+
+static void emit_neg_add(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    // `dst = -b + a` works in place
+    const MIR_Operand dst = x86_operand(ctx, instr->dst);
+    mir_emit(mir, MIR_NEG, 4, 1, dst);
+    mir_emit(mir, MIR_ADD, 4, 2, x86_operand(ctx, instr->a), dst);
+}
+
+static int cost_imul_imm(const X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    const bool one_imm = x86_is_imm(instr->a) != x86_is_imm(instr->b);
+    return x86_in_reg(ctx, instr->dst) && one_imm ? 1 : -1;
+}
+
+static void emit_imul_imm(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    const int imm = x86_is_imm(instr->a) ? instr->a : instr->b;
+    const int src = x86_is_imm(instr->a) ? instr->b : instr->a;
+    mir_emit(mir, MIR_IMUL, 4, 3, x86_operand(ctx, imm), x86_operand(ctx, src), x86_operand(ctx, instr->dst));
+}
+
+static int cost_cmp_jcc(const X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    return ctx->sel->child[0][k] != -1 ? 2 : -1;
+}
+
+static void emit_cmp_jcc(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    const IR_Instruction cmp = x86_resolve(ctx, ctx->sel->child[0][k]);
+    const IR_OP cond = x86_gen_compare(mir, ctx, &cmp);
+    x86_gen_cond_branch(mir, ctx, cond, instr->a, instr->b);
+}
+
+static int cost_cmp_cmov(const X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    return ctx->sel->child[0][k] != -1 ? 2 : -1;
+}
+
+static void emit_cmp_cmov(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    const IR_Instruction cmp = x86_resolve(ctx, ctx->sel->child[0][k]);
+    x86_gen_cmov(mir, ctx, x86_condition(x86_gen_compare(mir, ctx, &cmp)), instr);
+}
+
+static int cost_params(const X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    return ctx->func->param_count;
+}
+
+/*
+    The first IR_PARAM moves every parameter out of the argument registers at once, the others emit nothing.
+*/
+static void emit_params(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    const int start = ctx->sel->block_start[ctx->block];
+    const int end = start + ctx->func->blocks[ctx->block].count;
+    if (k > start && ctx->sel->instructions[k - 1]->op == IR_PARAM) {
+        return;
+    }
+    int count = 0;
+    while (k + count < end && ctx->sel->instructions[k + count]->op == IR_PARAM) {
+        count++;
+    }
+    MIR_Operand *dst = malloc(sizeof(MIR_Operand) * (count + 1));
+    MIR_Operand *src = malloc(sizeof(MIR_Operand) * (count + 1));
+    if (dst == NULL || src == NULL) {
+        printf("Failed to allocate parameter moves\n");
+        exit(1);
+    }
+    for (int i = 0; i < count; i++) {
+        const IR_Instruction *param = ctx->sel->instructions[k + i];
+        dst[i] = x86_operand(ctx, param->dst);
+        src[i] = x86_param_operand(ctx, param->a);
+    }
+    x86_gen_parallel_move(mir, dst, src, count);
+    free(dst);
+    free(src);
+}
+
+// Passed by the IR_CALL or IR_TAIL_CALL after it
+static int cost_arg(const X86_Context *ctx, const IR_Instruction *instr, const int k) { return 0; }
+
+static int cost_call(const X86_Context *ctx, const IR_Instruction *instr, const int k) { return instr->b + 2; }
+
+static void x86_check_args(const X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    const int first_arg = k - instr->b;
+    for (int i = 0; i < instr->b; i++) {
+        const IR_Instruction *arg = first_arg + i >= 0 ? ctx->sel->instructions[first_arg + i] : NULL;
+        if (arg == NULL || arg->op != IR_ARG || arg->b != i) {
+            printf("Arguments of a call to %s are not directly before it\n", ctx->func->callees[instr->a]);
+            exit(1);
+        }
+    }
+}
+
+/*
+    Pushes the stack arguments of the call at `k` last to first,
+    Padded to an even count so %rsp stays 16 byte aligned at the call. Returns the bytes pushed.
+*/
+static int x86_gen_stack_args(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    const int arg_count = instr->b;
+    const int first_arg = k - arg_count;
+    const int stack_count = arg_count > X86_ARG_REG_COUNT ? arg_count - X86_ARG_REG_COUNT : 0;
+    if (stack_count & 1) {
+        mir_emit(mir, MIR_SUB, 8, 2, mir_imm(8), mir_preg(MIR_RSP));
+    }
+    for (int i = arg_count - 1; i >= X86_ARG_REG_COUNT; i--) {
+        const MIR_Operand arg = x86_arg_operand(ctx, first_arg + i);
+        if (arg.kind == MIR_PREG) {
+            // Only the low 4 bytes of the slot are read
+            mir_emit(mir, MIR_PUSH, 8, 1, arg);
+        } else {
+            mir_emit(mir, MIR_MOV, 4, 2, arg, X86_EAX);
+            mir_emit(mir, MIR_PUSH, 8, 1, X86_EAX);
+        }
+    }
+    return (stack_count + (stack_count & 1)) * 8;
+}
+
+/*
+    The register arguments are moved in together as their sources may be each other's argument registers.
+*/
+static void x86_gen_reg_args(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    MIR_Operand dst[X86_ARG_REG_COUNT] = {0};
+    MIR_Operand src[X86_ARG_REG_COUNT] = {0};
+    const int reg_count = instr->b < X86_ARG_REG_COUNT ? instr->b : X86_ARG_REG_COUNT;
+    for (int i = 0; i < reg_count; i++) {
+        dst[i] = mir_preg(X86_ARG_REGS[i]);
+        src[i] = x86_arg_operand(ctx, k - instr->b + i);
+    }
+    x86_gen_parallel_move(mir, dst, src, reg_count);
+}
+
+/*
+    Calls with the result left in %eax.
+*/
+static void x86_gen_call(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    const int stack_size = x86_gen_stack_args(mir, ctx, instr, k);
+    x86_gen_reg_args(mir, ctx, instr, k);
+    mir_emit(mir, MIR_CALL, 8, 1, mir_symbol(ctx->func->callees[instr->a]));
+    if (stack_size > 0) {
+        mir_emit(mir, MIR_ADD, 8, 2, mir_imm(stack_size), mir_preg(MIR_RSP));
+    }
+}
+
+static void emit_call(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    x86_check_args(ctx, instr, k);
+    x86_gen_call(mir, ctx, instr, k);
+    mir_emit(mir, MIR_MOV, 4, 2, X86_EAX, x86_operand(ctx, instr->dst));
+}
+
+/*
+    With every argument in a register the frame is torn down and the callee jumped to,
+    It returns straight to our caller with the return address left on top of the stack.
+    Stack arguments would have to overwrite our caller's, so those calls still call and return.
+*/
+static void emit_tail_call(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    x86_check_args(ctx, instr, k);
+    if (instr->b > X86_ARG_REG_COUNT) {
+        x86_gen_call(mir, ctx, instr, k);
+        mir_emit(mir, MIR_JMP, 8, 1, mir_label(ctx->return_block));
+        return;
+    }
+    x86_gen_reg_args(mir, ctx, instr, k);
+    if (ctx->frame->framed[ctx->block]) {
+        x86_gen_epilogue(mir, ctx->frame);
+    }
+    mir_emit(mir, MIR_JMP, 8, 1, mir_symbol(ctx->func->callees[instr->a]));
+}
+
+/*
+    Rough instruction count of x86_gen_instruction(), -1 if the instruction covers anything but constants.
+*/
+static int cost_template(const X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    for (int slot = 0; slot < 2; slot++) {
+        const int child = ctx->sel->child[slot][k];
+        if (child != -1 && ctx->sel->instructions[child]->op != IR_LOAD) {
+            return -1;
+        }
+    }
+    switch (instr->op) {
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+        if (x86_in_reg(ctx, instr->dst) && !x86_same_location(ctx, instr->dst, instr->b)) {
+            return x86_same_location(ctx, instr->dst, instr->a) ? 1 : 2;
+        }
+        return x86_in_reg(ctx, instr->dst) && instr->op != IR_SUB ? 1 : 3;
+    case IR_LOAD:
+        return 1;
+    case IR_STORE:
+        return x86_in_memory(ctx, instr->dst) && x86_in_memory(ctx, instr->a) ? 2 : 1;
+    case IR_PARAM:
+    case IR_ARG:
+    case IR_CALL:
+    case IR_TAIL_CALL:
+        // Generated together with the instructions around them
+        return -1;
+    default:
+        return 3;
+    }
+}
+
+static void emit_template(MIR_Function *mir, X86_Context *ctx, const IR_Instruction *instr, const int k) {
+    x86_gen_instruction(mir, ctx, instr);
+}
+
+#define X86_ANY_OP (-1)
+
+static const X86_Tile X86_TILES[] = {
+    {IR_LOAD, "xor_zero", cost_zero, emit_zero},
+    {IR_STORE, "copy_elided", cost_copy_elided, emit_nothing},
+    {IR_STORE, "xor_zero", cost_zero, emit_zero},
+    {IR_ADD, "inc_dec", cost_inc_dec, emit_inc_dec},
+    {IR_SUB, "inc_dec", cost_inc_dec, emit_inc_dec},
+    {IR_ADD, "lea_disp", cost_lea_disp, emit_lea_disp},
+    {IR_SUB, "lea_disp", cost_lea_disp, emit_lea_disp},
+    {IR_ADD, "lea_index", cost_lea_index, emit_lea_index},
+    {IR_ADD, "lea_scaled", cost_lea_scaled, emit_lea_scaled},
+    {IR_ADD, "add_scaled", cost_add_scaled, emit_add_scaled},
+    {IR_SUB, "neg_add", cost_neg_add, emit_neg_add},
+    {IR_MUL, "imul_imm", cost_imul_imm, emit_imul_imm},
+    {IR_BR_EQ, "cmp_jcc", cost_cmp_jcc, emit_cmp_jcc},
+    {IR_SELECT, "cmp_cmov", cost_cmp_cmov, emit_cmp_cmov},
+    {IR_PARAM, "params", cost_params, emit_params},
+    {IR_ARG, "arg", cost_arg, emit_nothing},
+    {IR_CALL, "call", cost_call, emit_call},
+    {IR_TAIL_CALL, "tail_call", cost_call, emit_tail_call},
+    {X86_ANY_OP, "template", cost_template, emit_template},
+};
+
+#define X86_TILE_COUNT (int)(sizeof(X86_TILES) / sizeof(X86_TILES[0]))
+
+/*
+    Generates root instruction `k` with the cheapest tile matching it.
+*/
+static void x86_gen_tiled(MIR_Function *mir, X86_Context *ctx, const int k) {
+    ctx->imm_count = 0;
+    const IR_Instruction view = x86_resolve(ctx, k);
+    const X86_Tile *best = NULL;
+    int best_cost = INT_MAX;
+    for (int t = 0; t < X86_TILE_COUNT; t++) {
+        const X86_Tile *tile = &X86_TILES[t];
+        if (tile->op != (IR_OP)X86_ANY_OP && tile->op != view.op) {
+            continue;
+        }
+        const int cost = tile->cost(ctx, &view, k);
+        if (cost >= 0 && cost < best_cost) {
+            best = tile;
+            best_cost = cost;
+        }
+    }
+    if (best == NULL) {
+        printf("No tile matches IR op %d\n", view.op);
+        exit(1);
+    }
+    best->emit(mir, ctx, &view, k);
+}
+
+void x86_gen_block(MIR_Function *mir, X86_Context *ctx, const IR_Block *block) {
+    const int start = ctx->sel->block_start[ctx->block];
+    const bool restores = ctx->block == ctx->frame->restore_block;
     for (int i = 0; i < block->count; i++) {
-        x86_gen_instruction(fp, &block->instructions[i]);
+        const int k = start + i;
+        const bool terminator = ir_is_terminator(block->instructions[i].op);
+        if (terminator && restores) {
+            x86_gen_epilogue(mir, ctx->frame);
+        }
+        // Covered instructions are generated by the tile of the instruction reading them
+        if (ctx->sel->parent[k] == -1) {
+            x86_gen_tiled(mir, ctx, k);
+        }
+        if (terminator) {
+            // Anything after the terminator is unreachable
+            return;
+        }
+    }
+    if (restores) {
+        x86_gen_epilogue(mir, ctx->frame);
     }
 }
 
-void x86_gen_function(FILE *fp, const IR_Function *func) {
-    const int locals_size = func->local_count * 8;
-    const int stack_size = (locals_size + 15) & ~15;
-    fprintf(fp, ".global %s\n", func->name);
-    fprintf(fp, "%s:\n", func->name);
-    fprintf(fp, "    push %%rbp\n");
-    fprintf(fp, "    mov %%rsp, %%rbp\n");
-    fprintf(fp, "    subq $%d, %%rsp\n", stack_size);
+MIR_Function *x86_gen_function(const IR_Function *func, const bool allocate_registers) {
+    X86_Selection *sel = x86_select(func);
+    X86_RegAlloc *alloc = allocate_registers ? x86_alloc_registers(func, sel) : x86_alloc_stack(func, sel);
+    X86_Frame frame = x86_frame_layout(func, alloc);
+    MIR_Function *mir = mir_new_function(func->name, true);
+    // Ahead of the entry block's label, in case anything branches back to it
+    if (frame.save_block == 0) {
+        x86_gen_prologue(mir, &frame);
+    }
+
+    X86_Context ctx = {func, 0, X86_BLOCK(func->block_count), alloc, &frame, sel, 0, {0}};
     for (int i = 0; i < func->block_count; i++) {
-        fprintf(fp, "block_%d:\n", i);
-        x86_gen_block(fp, &func->blocks[i]);
+        mir_add_block(mir, ".L%s_%d", func->name, i);
+        if (i > 0 && i == frame.save_block) {
+            x86_gen_prologue(mir, &frame);
+        }
+        ctx.block = i;
+        x86_gen_block(mir, &ctx, &func->blocks[i]);
+    }
+    // Falling off the end returns too, with nothing to pop outside the frame
+    const int last = func->block_count - 1;
+    if (last >= 0 && !frame.framed[last] && ir_block_terminator(&func->blocks[last]) == -1) {
+        mir_emit(mir, MIR_RET, 8, 0);
+    }
+    // Loop headers start on a fetch boundary, the branches back to them run every iteration
+    IR_CFG *cfg = ir_cfg_build(func);
+    for (int l = 0; l < cfg->loop_count; l++) {
+        mir->blocks[X86_BLOCK(cfg->loops[l].header)].aligned = true;
+    }
+    ir_cfg_free(cfg);
+    mir_add_block(mir, ".L%s_return", func->name);
+    // Only returns inside a frame no block restores come here
+    if (frame.save_block != -1 && frame.restore_block == -1) {
+        x86_gen_epilogue(mir, &frame);
+        mir_emit(mir, MIR_RET, 8, 0);
+    }
+    x86_frame_free(&frame);
+    x86_free_alloc(alloc);
+    x86_free_selection(sel);
+    return mir;
+}
+
+static bool uses_op(const IR_Module *module, const IR_OP op) {
+    for (int f = 0; f < module->count; f++) {
+        const IR_Function *func = module->functions[f];
+        for (int b = 0; b < func->block_count; b++) {
+            for (int i = 0; i < func->blocks[b].count; i++) {
+                if (func->blocks[b].instructions[i].op == op) {
+                    return true;
+                }
+            }
+        }
     }
-    fprintf(fp, "return:\n");
-    fprintf(fp, "    mov %%rbp, %%rsp\n");
-    fprintf(fp, "    pop %%rbp\n");
-    fprintf(fp, "    ret\n");
-    fprintf(fp, ".section .note.GNU-stack,\"\",@progbits\n");
+    return false;
 }
 
-void x86_gen_module(FILE *fp, const IR_Module *module) {
+/*
+    int pow(int base (%edi), int exponent (%esi)) by repeated squaring, matching ir_pow().
+*/
+MIR_Function *x86_gen_pow_helper(void) {
+    enum { ENTRY, LOOP, SQUARE, NEGATIVE, DONE };
+    const MIR_Operand eax = mir_preg(MIR_RAX);
+    const MIR_Operand esi = mir_preg(MIR_RSI);
+    const MIR_Operand edi = mir_preg(MIR_RDI);
+    MIR_Function *mir = mir_new_function(X86_POW_HELPER, false);
+    mir_emit(mir, MIR_MOV, 4, 2, mir_imm(1), eax);
+    mir_emit(mir, MIR_TEST, 4, 2, esi, esi);
+    mir_emit_jcc(mir, MIR_COND_S, NEGATIVE);
+    mir_add_block(mir, ".Lpow_loop");
+    mir_emit(mir, MIR_TEST, 4, 2, esi, esi);
+    mir_emit_jcc(mir, MIR_COND_E, DONE);
+    mir_emit(mir, MIR_TEST, 4, 2, mir_imm(1), esi);
+    mir_emit_jcc(mir, MIR_COND_E, SQUARE);
+    mir_emit(mir, MIR_IMUL, 4, 2, edi, eax);
+    mir_add_block(mir, ".Lpow_square");
+    mir_emit(mir, MIR_IMUL, 4, 2, edi, edi);
+    mir_emit(mir, MIR_SHR, 4, 2, mir_imm(1), esi);
+    mir_emit(mir, MIR_JMP, 8, 1, mir_label(LOOP));
+    mir_add_block(mir, ".Lpow_negative");
+    mir_emit(mir, MIR_CMP, 4, 2, mir_imm(1), edi);
+    mir_emit_jcc(mir, MIR_COND_E, DONE);
+    mir_emit(mir, MIR_XOR, 4, 2, eax, eax);
+    mir_emit(mir, MIR_CMP, 4, 2, mir_imm(-1), edi);
+    mir_emit_jcc(mir, MIR_COND_NE, DONE);
+    mir_emit(mir, MIR_MOV, 4, 2, mir_imm(1), eax);
+    mir_emit(mir, MIR_TEST, 4, 2, mir_imm(1), esi);
+    mir_emit_jcc(mir, MIR_COND_E, DONE);
+    mir_emit(mir, MIR_MOV, 4, 2, mir_imm(-1), eax);
+    mir_add_block(mir, ".Lpow_done");
+    mir_emit(mir, MIR_RET, 8, 0);
+    return mir;
+}
+
+MIR_Function *x86_gen_start(void) {
+    MIR_Function *mir = mir_new_function(X86_START, true);
+    // The kernel enters with %rsp 16 byte aligned, so main sees the alignment a call leaves
+    mir_emit(mir, MIR_XOR, 4, 2, mir_preg(MIR_RBP), mir_preg(MIR_RBP));
+    mir_emit(mir, MIR_CALL, 8, 1, mir_symbol("main"));
+    mir_emit(mir, MIR_MOV, 4, 2, mir_preg(MIR_RAX), mir_preg(MIR_RDI));
+    mir_emit(mir, MIR_MOV, 4, 2, mir_imm(X86_SYS_EXIT_GROUP), mir_preg(MIR_RAX));
+    mir_emit(mir, MIR_SYSCALL, 8, 0);
+    return mir;
+}
+
+void x86_gen_module(Emitter *e, const IR_Module *module, const bool allocate_registers) {
+    for (int i = 0; i < module->count; i++) {
+        MIR_Function *mir = x86_gen_function(module->functions[i], allocate_registers);
+        x86_peephole(mir);
+        mir_print_function(e, mir);
+        mir_free_function(mir);
+    }
+    if (uses_op(module, IR_POW)) {
+        MIR_Function *mir = x86_gen_pow_helper();
+        mir_print_function(e, mir);
+        mir_free_function(mir);
+    }
+    emit_str(e, ".section .note.GNU-stack,\"\",@progbits\n");
+}
+
+X86_Object x86_encode_module(const IR_Module *module, const bool allocate_registers) {
+    X86_Object obj = x86_new_object();
     for (int i = 0; i < module->count; i++) {
-        x86_gen_function(fp, module->functions[i]);
+        MIR_Function *mir = x86_gen_function(module->functions[i], allocate_registers);
+        x86_peephole(mir);
+        x86_encode_function(&obj, mir);
+        mir_free_function(mir);
     }
+    if (uses_op(module, IR_POW)) {
+        MIR_Function *mir = x86_gen_pow_helper();
+        x86_encode_function(&obj, mir);
+        mir_free_function(mir);
+    }
+    x86_resolve_object(&obj);
+    return obj;
+}
+
+void x86_encode_start(X86_Object *obj) {
+    MIR_Function *mir = x86_gen_start();
+    x86_encode_function(obj, mir);
+    mir_free_function(mir);
+    x86_resolve_object(obj);
 }
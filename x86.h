@@ -1,9 +1,13 @@
 #ifndef COMPILER_C_X86_H
 #define COMPILER_C_X86_H
 
-#include <stdio.h>
-
+#include "emit.h"
 #include "ir.h"
+#include "mir.h"
+#include "x86_encode.h"
+#include "x86_frame.h"
+#include "x86_regalloc.h"
+#include "x86_select.h"
 
 /*
     x86-64 Assembly
@@ -11,9 +15,51 @@
     System V AMD 64
 */
 
-void x86_gen_instruction(FILE *fp, const IR_Instruction *instr);
-void x86_gen_block(FILE *fp, const IR_Block *block);
-void x86_gen_function(FILE *fp, const IR_Function *func);
-void x86_gen_module(FILE *fp, const IR_Module *module);
+// Called for IR_POW with a non constant exponent
+#define X86_POW_HELPER "__pow_i32"
+#define X86_START "_start"
+#define X86_SYS_EXIT_GROUP 231
+
+// Immediate operands a single tile can have
+#define X86_MAX_IMMEDIATES 2
+
+typedef struct {
+    const IR_Function *func;
+    int block;        // IR block being generated
+    int return_block; // MIR block holding the epilogue returns inside the frame jump to
+    const X86_RegAlloc *alloc;
+    const X86_Frame *frame;
+    const X86_Selection *sel;
+    // Constants covered by the tile being generated
+    int imm_count;
+    int imm_values[X86_MAX_IMMEDIATES];
+} X86_Context;
+
+void x86_gen_instruction(MIR_Function *mir, const X86_Context *ctx, const IR_Instruction *instr);
+void x86_gen_block(MIR_Function *mir, X86_Context *ctx, const IR_Block *block);
+/*
+    Lowers a function to MIR, IR block `b` becomes MIR block `b + 1` after the entry block.
+    The prologue opens the entry block unless the frame is shrink-wrapped into a later one.
+    With `allocate_registers` values live in registers picked by linear scan,
+    Otherwise every IR register is kept in a stack slot.
+*/
+MIR_Function *x86_gen_function(const IR_Function *func, bool allocate_registers);
+MIR_Function *x86_gen_pow_helper(void);
+/*
+    Entry point of executables, calls main and exits with its result through exit_group.
+*/
+MIR_Function *x86_gen_start(void);
+/*
+    Each function goes through x86_peephole() before it is printed.
+*/
+void x86_gen_module(Emitter *e, const IR_Module *module, bool allocate_registers);
+/*
+    Machine code for the same functions x86_gen_module() prints, with calls between them already resolved.
+*/
+X86_Object x86_encode_module(const IR_Module *module, bool allocate_registers);
+/*
+    Appends x86_gen_start() to an object from x86_encode_module() and resolves its call to main.
+*/
+void x86_encode_start(X86_Object *obj);
 
 #endif // COMPILER_C_X86_H
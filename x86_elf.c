@@ -0,0 +1,302 @@
+#include "x86_elf.h"
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    SECTION_NULL,
+    SECTION_TEXT,
+    SECTION_RELA_TEXT,
+    SECTION_SYMTAB,
+    SECTION_STRTAB,
+    SECTION_NOTE_GNU_STACK,
+    SECTION_SHSTRTAB,
+    SECTION_COUNT
+};
+
+static const char SHSTRTAB[] = "\0.text\0.rela.text\0.symtab\0.strtab\0.note.GNU-stack\0.shstrtab";
+#define SHSTRTAB_TEXT 1
+#define SHSTRTAB_RELA_TEXT 7
+#define SHSTRTAB_SYMTAB 18
+#define SHSTRTAB_STRTAB 26
+#define SHSTRTAB_NOTE_GNU_STACK 34
+#define SHSTRTAB_SHSTRTAB 50
+
+typedef struct {
+    Elf64_Sym *symbols;
+    int count;
+    char *strings;
+    int string_size;
+    // Index in `symbols` of each X86_Symbol, and of the symbol each X86_Reloc refers to
+    int *defined;
+    int *reloc_symbols;
+    int first_global;
+} SymbolTable;
+
+static int add_string(SymbolTable *table, const char *name) {
+    const int offset = table->string_size;
+    const int length = (int)strlen(name) + 1;
+    memcpy(table->strings + offset, name, length);
+    table->string_size += length;
+    return offset;
+}
+
+static void add_symbol(SymbolTable *table, const char *name, const unsigned char bind, const Elf64_Section section,
+                       const Elf64_Addr offset, const int size) {
+    Elf64_Sym *sym = &table->symbols[table->count++];
+    memset(sym, 0, sizeof(Elf64_Sym));
+    sym->st_name = add_string(table, name);
+    sym->st_info = ELF64_ST_INFO(bind, STT_FUNC);
+    sym->st_shndx = section;
+    sym->st_value = offset;
+    sym->st_size = size;
+}
+
+static void *allocate(const size_t size) {
+    void *p = calloc(1, size);
+    if (p == NULL) {
+        printf("Failed to allocate ELF symbol table\n");
+        exit(1);
+    }
+    return p;
+}
+
+/*
+    Local symbols have to come before global ones, undefined symbols are added once however many calls name them.
+    Symbol values are text offsets plus `base`, the address .text is loaded at in executables.
+*/
+static SymbolTable build_symbol_table(const X86_Object *obj, const Elf64_Addr base) {
+    SymbolTable table;
+    const int max_symbols = 1 + obj->symbol_count + obj->reloc_count;
+    table.symbols = allocate(sizeof(Elf64_Sym) * max_symbols);
+    table.strings = allocate((size_t)max_symbols * MIR_NAME_SIZE + 1);
+    table.defined = allocate(sizeof(int) * (obj->symbol_count + 1));
+    table.reloc_symbols = allocate(sizeof(int) * (obj->reloc_count + 1));
+    table.count = 0;
+    table.string_size = 0;
+    add_symbol(&table, "", STB_LOCAL, SHN_UNDEF, 0, 0);
+    table.symbols[0].st_info = 0;
+
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            table.first_global = table.count;
+        }
+        for (int s = 0; s < obj->symbol_count; s++) {
+            const X86_Symbol *symbol = &obj->symbols[s];
+            if (symbol->global == (pass == 1)) {
+                table.defined[s] = table.count;
+                add_symbol(&table, symbol->name, symbol->global ? STB_GLOBAL : STB_LOCAL, SECTION_TEXT,
+                           base + symbol->offset, symbol->size);
+            }
+        }
+    }
+    for (int r = 0; r < obj->reloc_count; r++) {
+        const X86_Reloc *reloc = &obj->relocs[r];
+        table.reloc_symbols[r] = -1;
+        if (reloc->resolved) {
+            continue;
+        }
+        for (int p = 0; p < r; p++) {
+            if (!obj->relocs[p].resolved && strcmp(obj->relocs[p].symbol, reloc->symbol) == 0) {
+                table.reloc_symbols[r] = table.reloc_symbols[p];
+                break;
+            }
+        }
+        if (table.reloc_symbols[r] == -1) {
+            table.reloc_symbols[r] = table.count;
+            add_symbol(&table, reloc->symbol, STB_GLOBAL, SHN_UNDEF, 0, 0);
+            table.symbols[table.count - 1].st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+        }
+    }
+    return table;
+}
+
+static void free_symbol_table(SymbolTable *table) {
+    free(table->symbols);
+    free(table->strings);
+    free(table->defined);
+    free(table->reloc_symbols);
+}
+
+static int align(const int offset, const int alignment) { return (offset + alignment - 1) & -alignment; }
+
+static void pad(Emitter *e, int *offset, const int alignment) {
+    while (*offset < align(*offset, alignment)) {
+        emit_char(e, 0);
+        (*offset)++;
+    }
+}
+
+static void section_header(Elf64_Shdr *shdr, const int name, const Elf64_Word type, const Elf64_Xword flags,
+                           const int offset, const int size, const int alignment) {
+    memset(shdr, 0, sizeof(Elf64_Shdr));
+    shdr->sh_name = name;
+    shdr->sh_type = type;
+    shdr->sh_flags = flags;
+    shdr->sh_offset = offset;
+    shdr->sh_size = size;
+    shdr->sh_addralign = alignment;
+}
+
+static void init_header(Elf64_Ehdr *ehdr, const Elf64_Half type, const int section_count, const int shdr_offset) {
+    memset(ehdr, 0, sizeof(Elf64_Ehdr));
+    memcpy(ehdr->e_ident, ELFMAG, SELFMAG);
+    ehdr->e_ident[EI_CLASS] = ELFCLASS64;
+    ehdr->e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr->e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr->e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    ehdr->e_type = type;
+    ehdr->e_machine = EM_X86_64;
+    ehdr->e_version = EV_CURRENT;
+    ehdr->e_shoff = shdr_offset;
+    ehdr->e_ehsize = sizeof(Elf64_Ehdr);
+    ehdr->e_shentsize = sizeof(Elf64_Shdr);
+    ehdr->e_shnum = section_count;
+    ehdr->e_shstrndx = section_count - 1;
+}
+
+void elf_write_object(Emitter *e, const X86_Object *obj) {
+    SymbolTable table = build_symbol_table(obj, 0);
+    int rela_count = 0;
+    for (int r = 0; r < obj->reloc_count; r++) {
+        rela_count += !obj->relocs[r].resolved;
+    }
+
+    // File layout: header, .text, .rela.text, .symtab, .strtab, .shstrtab, section headers
+    const int text_offset = align(sizeof(Elf64_Ehdr), 16);
+    const int rela_offset = align(text_offset + obj->size, 8);
+    const int rela_size = rela_count * (int)sizeof(Elf64_Rela);
+    const int symtab_offset = rela_offset + rela_size;
+    const int symtab_size = table.count * (int)sizeof(Elf64_Sym);
+    const int strtab_offset = symtab_offset + symtab_size;
+    const int shstrtab_offset = strtab_offset + table.string_size;
+    const int shdr_offset = align(shstrtab_offset + (int)sizeof(SHSTRTAB), 8);
+
+    Elf64_Ehdr ehdr;
+    init_header(&ehdr, ET_REL, SECTION_COUNT, shdr_offset);
+
+    int offset = sizeof(ehdr);
+    emit_bytes(e, (const char *)&ehdr, sizeof(ehdr));
+    pad(e, &offset, 16);
+    emit_bytes(e, (const char *)obj->text, obj->size);
+    offset += obj->size;
+    pad(e, &offset, 8);
+
+    for (int r = 0; r < obj->reloc_count; r++) {
+        const X86_Reloc *reloc = &obj->relocs[r];
+        if (reloc->resolved) {
+            continue;
+        }
+        // The rel32 is relative to the end of the field, 4 bytes past its offset
+        const Elf64_Rela rela = {reloc->offset, ELF64_R_INFO(table.reloc_symbols[r], R_X86_64_PLT32), -4};
+        emit_bytes(e, (const char *)&rela, sizeof(rela));
+    }
+    emit_bytes(e, (const char *)table.symbols, symtab_size);
+    emit_bytes(e, table.strings, table.string_size);
+    emit_bytes(e, SHSTRTAB, sizeof(SHSTRTAB));
+    offset = shstrtab_offset + (int)sizeof(SHSTRTAB);
+    pad(e, &offset, 8);
+
+    Elf64_Shdr shdrs[SECTION_COUNT];
+    memset(&shdrs[SECTION_NULL], 0, sizeof(Elf64_Shdr));
+    section_header(&shdrs[SECTION_TEXT], SHSTRTAB_TEXT, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text_offset,
+                   obj->size, 16);
+    section_header(&shdrs[SECTION_RELA_TEXT], SHSTRTAB_RELA_TEXT, SHT_RELA, SHF_INFO_LINK, rela_offset, rela_size, 8);
+    shdrs[SECTION_RELA_TEXT].sh_link = SECTION_SYMTAB;
+    shdrs[SECTION_RELA_TEXT].sh_info = SECTION_TEXT;
+    shdrs[SECTION_RELA_TEXT].sh_entsize = sizeof(Elf64_Rela);
+    section_header(&shdrs[SECTION_SYMTAB], SHSTRTAB_SYMTAB, SHT_SYMTAB, 0, symtab_offset, symtab_size, 8);
+    shdrs[SECTION_SYMTAB].sh_link = SECTION_STRTAB;
+    shdrs[SECTION_SYMTAB].sh_info = table.first_global;
+    shdrs[SECTION_SYMTAB].sh_entsize = sizeof(Elf64_Sym);
+    section_header(&shdrs[SECTION_STRTAB], SHSTRTAB_STRTAB, SHT_STRTAB, 0, strtab_offset, table.string_size, 1);
+    // Empty, marks the stack as non executable like the directive in the assembly output
+    section_header(&shdrs[SECTION_NOTE_GNU_STACK], SHSTRTAB_NOTE_GNU_STACK, SHT_PROGBITS, 0, shstrtab_offset, 0, 1);
+    section_header(&shdrs[SECTION_SHSTRTAB], SHSTRTAB_SHSTRTAB, SHT_STRTAB, 0, shstrtab_offset, sizeof(SHSTRTAB), 1);
+    emit_bytes(e, (const char *)shdrs, sizeof(shdrs));
+
+    free_symbol_table(&table);
+}
+
+// Executables have no relocations or stack note, their sections keep the object's indices up to .strtab
+enum { EXE_SECTION_SHSTRTAB = SECTION_STRTAB + 1, EXE_SECTION_COUNT };
+
+enum { SEGMENT_LOAD, SEGMENT_GNU_STACK, SEGMENT_COUNT };
+
+void elf_write_executable(Emitter *e, const X86_Object *obj, const char *entry) {
+    for (int r = 0; r < obj->reloc_count; r++) {
+        if (!obj->relocs[r].resolved) {
+            printf("Undefined reference to %s\n", obj->relocs[r].symbol);
+            exit(1);
+        }
+    }
+    const int entry_symbol = x86_find_symbol(obj, entry);
+    if (entry_symbol == -1) {
+        printf("Undefined entry point %s\n", entry);
+        exit(1);
+    }
+
+    // Headers and .text are mapped by a single read and execute segment starting at the file's first byte
+    const int text_offset = align(sizeof(Elf64_Ehdr) + SEGMENT_COUNT * sizeof(Elf64_Phdr), 16);
+    const Elf64_Addr text_address = ELF_BASE_ADDRESS + text_offset;
+    SymbolTable table = build_symbol_table(obj, text_address);
+    const int symtab_offset = align(text_offset + obj->size, 8);
+    const int symtab_size = table.count * (int)sizeof(Elf64_Sym);
+    const int strtab_offset = symtab_offset + symtab_size;
+    const int shstrtab_offset = strtab_offset + table.string_size;
+    const int shdr_offset = align(shstrtab_offset + (int)sizeof(SHSTRTAB), 8);
+
+    Elf64_Ehdr ehdr;
+    init_header(&ehdr, ET_EXEC, EXE_SECTION_COUNT, shdr_offset);
+    ehdr.e_entry = text_address + obj->symbols[entry_symbol].offset;
+    ehdr.e_phoff = sizeof(Elf64_Ehdr);
+    ehdr.e_phentsize = sizeof(Elf64_Phdr);
+    ehdr.e_phnum = SEGMENT_COUNT;
+
+    Elf64_Phdr phdrs[SEGMENT_COUNT];
+    memset(phdrs, 0, sizeof(phdrs));
+    phdrs[SEGMENT_LOAD].p_type = PT_LOAD;
+    phdrs[SEGMENT_LOAD].p_flags = PF_R | PF_X;
+    phdrs[SEGMENT_LOAD].p_vaddr = ELF_BASE_ADDRESS;
+    phdrs[SEGMENT_LOAD].p_paddr = ELF_BASE_ADDRESS;
+    phdrs[SEGMENT_LOAD].p_filesz = text_offset + obj->size;
+    phdrs[SEGMENT_LOAD].p_memsz = text_offset + obj->size;
+    phdrs[SEGMENT_LOAD].p_align = ELF_PAGE_SIZE;
+    // Without it the kernel maps the stack executable
+    phdrs[SEGMENT_GNU_STACK].p_type = PT_GNU_STACK;
+    phdrs[SEGMENT_GNU_STACK].p_flags = PF_R | PF_W;
+    phdrs[SEGMENT_GNU_STACK].p_align = 16;
+
+    int offset = sizeof(ehdr) + sizeof(phdrs);
+    emit_bytes(e, (const char *)&ehdr, sizeof(ehdr));
+    emit_bytes(e, (const char *)phdrs, sizeof(phdrs));
+    pad(e, &offset, 16);
+    emit_bytes(e, (const char *)obj->text, obj->size);
+    offset += obj->size;
+    pad(e, &offset, 8);
+    emit_bytes(e, (const char *)table.symbols, symtab_size);
+    emit_bytes(e, table.strings, table.string_size);
+    emit_bytes(e, SHSTRTAB, sizeof(SHSTRTAB));
+    offset = shstrtab_offset + (int)sizeof(SHSTRTAB);
+    pad(e, &offset, 8);
+
+    Elf64_Shdr shdrs[EXE_SECTION_COUNT];
+    memset(&shdrs[SECTION_NULL], 0, sizeof(Elf64_Shdr));
+    section_header(&shdrs[SECTION_TEXT], SHSTRTAB_TEXT, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text_offset,
+                   obj->size, 16);
+    shdrs[SECTION_TEXT].sh_addr = text_address;
+    // Nothing to relocate, the slot stays an inactive section so .symtab keeps its index
+    section_header(&shdrs[SECTION_RELA_TEXT], 0, SHT_NULL, 0, 0, 0, 0);
+    section_header(&shdrs[SECTION_SYMTAB], SHSTRTAB_SYMTAB, SHT_SYMTAB, 0, symtab_offset, symtab_size, 8);
+    shdrs[SECTION_SYMTAB].sh_link = SECTION_STRTAB;
+    shdrs[SECTION_SYMTAB].sh_info = table.first_global;
+    shdrs[SECTION_SYMTAB].sh_entsize = sizeof(Elf64_Sym);
+    section_header(&shdrs[SECTION_STRTAB], SHSTRTAB_STRTAB, SHT_STRTAB, 0, strtab_offset, table.string_size, 1);
+    section_header(&shdrs[EXE_SECTION_SHSTRTAB], SHSTRTAB_SHSTRTAB, SHT_STRTAB, 0, shstrtab_offset,
+                   sizeof(SHSTRTAB), 1);
+    emit_bytes(e, (const char *)shdrs, sizeof(shdrs));
+
+    free_symbol_table(&table);
+}
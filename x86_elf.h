@@ -0,0 +1,27 @@
+#ifndef COMPILER_C_X86_ELF_H
+#define COMPILER_C_X86_ELF_H
+
+#include "emit.h"
+#include "x86_encode.h"
+
+/*
+    ELF64 relocatable object, x86-64 System V.
+
+    Sections: .text, .rela.text, .symtab, .strtab, .note.GNU-stack and .shstrtab.
+    Every function is a STT_FUNC symbol in .text, calls left unresolved by x86_resolve_object()
+    Become R_X86_64_PLT32 relocations against undefined global symbols.
+*/
+void elf_write_object(Emitter *e, const X86_Object *obj);
+
+#define ELF_BASE_ADDRESS 0x400000
+#define ELF_PAGE_SIZE 0x1000
+
+/*
+    Static, non PIE ELF64 executable starting at symbol `entry`.
+    The headers and .text form one read and execute PT_LOAD segment at ELF_BASE_ADDRESS,
+    So the kernel maps the program with a single mmap and no dynamic loader is involved.
+    Every call has to be resolved within the object.
+*/
+void elf_write_executable(Emitter *e, const X86_Object *obj, const char *entry);
+
+#endif // COMPILER_C_X86_ELF_H
@@ -0,0 +1,500 @@
+#include "x86_encode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Longest encoding used: REX, two opcode bytes, ModRM, SIB, disp32 and imm32
+#define X86_MAX_INSTRUCTION 15
+
+typedef struct {
+    unsigned char bytes[X86_MAX_INSTRUCTION];
+    int count;
+} Encoding;
+
+// Opcodes of the two operand ALU instructions, `digit` is the ModRM reg field of their 0x81/0x83 immediate forms
+typedef struct {
+    int store; // op r/m, r
+    int load;  // op r, r/m
+    int digit;
+    int accumulator; // op %eax, imm32
+} Alu;
+
+static const Alu ALU[MIR_OP_COUNT] = {
+    [MIR_ADD] = {0x01, 0x03, 0, 0x05},
+    [MIR_SUB] = {0x29, 0x2B, 5, 0x2D},
+    [MIR_XOR] = {0x31, 0x33, 6, 0x35},
+    [MIR_CMP] = {0x39, 0x3B, 7, 0x3D},
+};
+
+static const int CONDITION_CODES[] = {
+    [MIR_COND_E] = 0x4, [MIR_COND_NE] = 0x5, [MIR_COND_L] = 0xC, [MIR_COND_GE] = 0xD,
+    [MIR_COND_LE] = 0xE, [MIR_COND_G] = 0xF,  [MIR_COND_S] = 0x8, [MIR_COND_NS] = 0x9,
+};
+
+static bool fits8(const int value) { return value >= -128 && value <= 127; }
+
+static void put(Encoding *enc, const int byte) { enc->bytes[enc->count++] = (unsigned char)byte; }
+
+static void put32(Encoding *enc, const int value) {
+    const unsigned int bits = (unsigned int)value;
+    for (int i = 0; i < 4; i++) {
+        put(enc, (int)(bits >> (8 * i)) & 0xFF);
+    }
+}
+
+static int scale_bits(const int scale) { return scale == 8 ? 3 : scale == 4 ? 2 : scale == 2 ? 1 : 0; }
+
+/*
+    REX prefix, opcode and ModRM with its SIB and displacement.
+    `reg` is a register or an opcode extension digit, `rm` a register or memory operand.
+    With `byte_rm` a register `rm` names a byte register, where %spl to %dil need a REX prefix to exist.
+*/
+static void encode_modrm(Encoding *enc, const int opcode_length, const int opcode0, const int opcode1, const int reg,
+                         const MIR_Operand *rm, const bool wide, const bool byte_rm) {
+    int rex = (wide ? 0x08 : 0) | (reg >= 8 ? 0x04 : 0);
+    bool force_rex = false;
+    if (rm->kind == MIR_PREG) {
+        rex |= rm->reg >= 8 ? 0x01 : 0;
+        force_rex = byte_rm && rm->reg >= MIR_RSP && rm->reg <= MIR_RDI;
+    } else {
+        rex |= rm->index != MIR_NO_PREG && rm->index >= 8 ? 0x02 : 0;
+        rex |= rm->reg != MIR_NO_PREG && rm->reg >= 8 ? 0x01 : 0;
+    }
+    if (rex != 0 || force_rex) {
+        put(enc, 0x40 | rex);
+    }
+    put(enc, opcode0);
+    if (opcode_length == 2) {
+        put(enc, opcode1);
+    }
+
+    const int r = (reg & 7) << 3;
+    if (rm->kind == MIR_PREG) {
+        put(enc, 0xC0 | r | (rm->reg & 7));
+        return;
+    }
+    const int base = rm->reg;
+    const int disp = rm->value;
+    if (base == MIR_NO_PREG) {
+        // disp32(,index,scale) takes a SIB with no base
+        put(enc, 0x04 | r);
+        put(enc, (scale_bits(rm->scale) << 6) | ((rm->index == MIR_NO_PREG ? 4 : rm->index & 7) << 3) | 5);
+        put32(enc, disp);
+        return;
+    }
+    // %rbp and %r13 as a base always take a displacement
+    const int mod = disp == 0 && (base & 7) != 5 ? 0x00 : fits8(disp) ? 0x40 : 0x80;
+    if (rm->index == MIR_NO_PREG && (base & 7) != 4) {
+        put(enc, mod | r | (base & 7));
+    } else {
+        // %rsp and %r12 as a base need a SIB
+        put(enc, mod | r | 4);
+        put(enc, (scale_bits(rm->scale) << 6) | ((rm->index == MIR_NO_PREG ? 4 : rm->index & 7) << 3) | (base & 7));
+    }
+    if (mod == 0x40) {
+        put(enc, disp);
+    } else if (mod == 0x80) {
+        put32(enc, disp);
+    }
+}
+
+static void encode_rm(Encoding *enc, const int opcode, const int reg, const MIR_Operand *rm, const bool wide) {
+    encode_modrm(enc, 1, opcode, 0, reg, rm, wide, false);
+}
+
+static void encode_alu(Encoding *enc, const MIR_Instruction *instr, const bool wide) {
+    const MIR_Operand *src = &instr->operands[0];
+    const MIR_Operand *dst = &instr->operands[1];
+    const Alu *alu = &ALU[instr->op];
+    if (src->kind == MIR_IMM && fits8(src->value)) {
+        encode_rm(enc, 0x83, alu->digit, dst, wide);
+        put(enc, src->value);
+    } else if (src->kind == MIR_IMM && dst->kind == MIR_PREG && dst->reg == MIR_RAX) {
+        if (wide) {
+            put(enc, 0x48);
+        }
+        put(enc, alu->accumulator);
+        put32(enc, src->value);
+    } else if (src->kind == MIR_IMM) {
+        encode_rm(enc, 0x81, alu->digit, dst, wide);
+        put32(enc, src->value);
+    } else if (src->kind == MIR_PREG) {
+        encode_rm(enc, alu->store, src->reg, dst, wide);
+    } else {
+        encode_rm(enc, alu->load, dst->reg, src, wide);
+    }
+}
+
+static void encode_mov(Encoding *enc, const MIR_Instruction *instr, const bool wide) {
+    const MIR_Operand *src = &instr->operands[0];
+    const MIR_Operand *dst = &instr->operands[1];
+    if (src->kind == MIR_IMM && dst->kind == MIR_PREG && !wide) {
+        if (dst->reg >= 8) {
+            put(enc, 0x41);
+        }
+        put(enc, 0xB8 + (dst->reg & 7));
+        put32(enc, src->value);
+    } else if (src->kind == MIR_IMM) {
+        encode_rm(enc, 0xC7, 0, dst, wide);
+        put32(enc, src->value);
+    } else if (src->kind == MIR_PREG) {
+        encode_rm(enc, 0x89, src->reg, dst, wide);
+    } else {
+        encode_rm(enc, 0x8B, dst->reg, src, wide);
+    }
+}
+
+static void encode_imul(Encoding *enc, const MIR_Instruction *instr, const bool wide) {
+    const MIR_Operand *ops = instr->operands;
+    if (instr->operand_count == 1) {
+        encode_rm(enc, 0xF7, 5, &ops[0], wide);
+        return;
+    }
+    // Two operand imull with an immediate is the three operand form with the destination as its source
+    const MIR_Operand *imm = ops[0].kind == MIR_IMM ? &ops[0] : NULL;
+    const MIR_Operand *src = instr->operand_count == 3 ? &ops[1] : imm != NULL ? &ops[1] : &ops[0];
+    const MIR_Operand *dst = &ops[instr->operand_count - 1];
+    if (imm == NULL) {
+        encode_modrm(enc, 2, 0x0F, 0xAF, dst->reg, src, wide, false);
+    } else if (fits8(imm->value)) {
+        encode_rm(enc, 0x6B, dst->reg, src, wide);
+        put(enc, imm->value);
+    } else {
+        encode_rm(enc, 0x69, dst->reg, src, wide);
+        put32(enc, imm->value);
+    }
+}
+
+static void encode_test(Encoding *enc, const MIR_Instruction *instr, const bool wide) {
+    const MIR_Operand *src = &instr->operands[0];
+    const MIR_Operand *dst = &instr->operands[1];
+    if (src->kind == MIR_IMM && dst->kind == MIR_PREG && dst->reg == MIR_RAX) {
+        if (wide) {
+            put(enc, 0x48);
+        }
+        put(enc, 0xA9);
+        put32(enc, src->value);
+    } else if (src->kind == MIR_IMM) {
+        encode_rm(enc, 0xF7, 0, dst, wide);
+        put32(enc, src->value);
+    } else if (src->kind == MIR_PREG) {
+        encode_rm(enc, 0x85, src->reg, dst, wide);
+    } else {
+        encode_rm(enc, 0x85, dst->reg, src, wide);
+    }
+}
+
+/*
+    Encodes everything but branches and calls, whose displacements are only known once the function is laid out.
+*/
+static void encode_instruction(Encoding *enc, const MIR_Instruction *instr) {
+    const bool wide = instr->size == 8;
+    const MIR_Operand *ops = instr->operands;
+    enc->count = 0;
+    switch (instr->op) {
+    case MIR_MOV:
+        encode_mov(enc, instr, wide);
+        break;
+    case MIR_MOVZB:
+        encode_modrm(enc, 2, 0x0F, 0xB6, ops[1].reg, &ops[0], false, true);
+        break;
+    case MIR_ADD:
+    case MIR_SUB:
+    case MIR_XOR:
+    case MIR_CMP:
+        encode_alu(enc, instr, wide);
+        break;
+    case MIR_IMUL:
+        encode_imul(enc, instr, wide);
+        break;
+    case MIR_IDIV:
+        encode_rm(enc, 0xF7, 7, &ops[0], wide);
+        break;
+    case MIR_CLTD:
+        put(enc, 0x99);
+        break;
+    case MIR_NEG:
+        encode_rm(enc, 0xF7, 3, &ops[0], wide);
+        break;
+    case MIR_INC:
+        encode_rm(enc, 0xFF, 0, &ops[0], wide);
+        break;
+    case MIR_DEC:
+        encode_rm(enc, 0xFF, 1, &ops[0], wide);
+        break;
+    case MIR_SHL:
+    case MIR_SAR:
+    case MIR_SHR: {
+        // Shifts by one have their own opcode without the count byte
+        const int digit = instr->op == MIR_SHL ? 4 : instr->op == MIR_SAR ? 7 : 5;
+        encode_rm(enc, ops[0].value == 1 ? 0xD1 : 0xC1, digit, &ops[1], wide);
+        if (ops[0].value != 1) {
+            put(enc, ops[0].value);
+        }
+        break;
+    }
+    case MIR_LEA:
+        encode_rm(enc, 0x8D, ops[1].reg, &ops[0], wide);
+        break;
+    case MIR_TEST:
+        encode_test(enc, instr, wide);
+        break;
+    case MIR_SETCC:
+        encode_modrm(enc, 2, 0x0F, 0x90 + CONDITION_CODES[instr->cond], 0, &ops[0], false, true);
+        break;
+    case MIR_CMOV:
+        encode_modrm(enc, 2, 0x0F, 0x40 + CONDITION_CODES[instr->cond], ops[1].reg, &ops[0], wide, false);
+        break;
+    case MIR_PUSH:
+    case MIR_POP:
+        if (ops[0].reg >= 8) {
+            put(enc, 0x41);
+        }
+        put(enc, (instr->op == MIR_PUSH ? 0x50 : 0x58) + (ops[0].reg & 7));
+        break;
+    case MIR_RET:
+        put(enc, 0xC3);
+        break;
+    case MIR_SYSCALL:
+        put(enc, 0x0F);
+        put(enc, 0x05);
+        break;
+    default:
+        printf("Can not encode MIR op %d\n", instr->op);
+        exit(1);
+    }
+}
+
+// A jmp to a symbol (a tail call) is relocated like a call instead
+static bool is_branch(const MIR_Instruction *instr) {
+    return (instr->op == MIR_JMP || instr->op == MIR_JCC) && instr->operands[0].kind == MIR_LABEL;
+}
+
+static int branch_length(const MIR_Op op, const bool wide) { return !wide ? 2 : op == MIR_JMP ? 5 : 6; }
+
+static void encode_branch(Encoding *enc, const MIR_Instruction *instr, const bool wide, const int displacement) {
+    enc->count = 0;
+    if (!wide) {
+        put(enc, instr->op == MIR_JMP ? 0xEB : 0x70 + CONDITION_CODES[instr->cond]);
+        put(enc, displacement);
+    } else if (instr->op == MIR_JMP) {
+        put(enc, 0xE9);
+        put32(enc, displacement);
+    } else {
+        put(enc, 0x0F);
+        put(enc, 0x80 + CONDITION_CODES[instr->cond]);
+        put32(enc, displacement);
+    }
+}
+
+X86_Object x86_new_object(void) { return (X86_Object){NULL, 0, 0, NULL, 0, 0, NULL, 0, 0}; }
+
+void x86_free_object(X86_Object *obj) {
+    free(obj->text);
+    free(obj->symbols);
+    free(obj->relocs);
+    *obj = x86_new_object();
+}
+
+// The multi-byte NOPs gas pads code with, indexed by length, longer padding takes several
+#define MAX_NOP 11
+static const unsigned char NOPS[MAX_NOP + 1][MAX_NOP] = {
+    {0},
+    {0x90},
+    {0x66, 0x90},
+    {0x0F, 0x1F, 0x00},
+    {0x0F, 0x1F, 0x40, 0x00},
+    {0x0F, 0x1F, 0x44, 0x00, 0x00},
+    {0x66, 0x0F, 0x1F, 0x44, 0x00, 0x00},
+    {0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00},
+    {0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x66, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x66, 0x2E, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x66, 0x66, 0x2E, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+};
+
+/*
+    Bytes of padding ahead of `block` when it would start at `offset` in the text.
+*/
+static int align_padding(const MIR_Block *block, const int offset) {
+    if (!block->aligned) {
+        return 0;
+    }
+    const int padding = -offset & (MIR_ALIGN - 1);
+    return padding <= MIR_ALIGN_MAX_SKIP ? padding : 0;
+}
+
+static void append_text(X86_Object *obj, const Encoding *enc) {
+    if (obj->size + enc->count > obj->capacity) {
+        obj->capacity = obj->capacity == 0 ? 4096 : obj->capacity * 2;
+        obj->text = realloc(obj->text, obj->capacity);
+        if (obj->text == NULL) {
+            printf("Failed to allocate machine code\n");
+            exit(1);
+        }
+    }
+    memcpy(obj->text + obj->size, enc->bytes, enc->count);
+    obj->size += enc->count;
+}
+
+static void copy_name(char *dst, const char *name) {
+    if (strlen(name) >= MIR_NAME_SIZE) {
+        printf("Symbol name too long: %s\n", name);
+        exit(1);
+    }
+    strcpy(dst, name);
+}
+
+static void add_reloc(X86_Object *obj, const int offset, const char *symbol) {
+    if (obj->reloc_count >= obj->reloc_capacity) {
+        obj->reloc_capacity = obj->reloc_capacity == 0 ? 8 : obj->reloc_capacity * 2;
+        obj->relocs = realloc(obj->relocs, sizeof(X86_Reloc) * obj->reloc_capacity);
+        if (obj->relocs == NULL) {
+            printf("Failed to allocate relocations\n");
+            exit(1);
+        }
+    }
+    X86_Reloc *reloc = &obj->relocs[obj->reloc_count++];
+    reloc->offset = offset;
+    copy_name(reloc->symbol, symbol);
+    reloc->resolved = false;
+}
+
+static void add_symbol(X86_Object *obj, const char *name, const int offset, const int size, const bool global) {
+    if (obj->symbol_count >= obj->symbol_capacity) {
+        obj->symbol_capacity = obj->symbol_capacity == 0 ? 8 : obj->symbol_capacity * 2;
+        obj->symbols = realloc(obj->symbols, sizeof(X86_Symbol) * obj->symbol_capacity);
+        if (obj->symbols == NULL) {
+            printf("Failed to allocate symbols\n");
+            exit(1);
+        }
+    }
+    X86_Symbol *symbol = &obj->symbols[obj->symbol_count++];
+    copy_name(symbol->name, name);
+    symbol->offset = offset;
+    symbol->size = size;
+    symbol->global = global;
+}
+
+void x86_encode_function(X86_Object *obj, const MIR_Function *func) {
+    int count = 0;
+    for (int b = 0; b < func->block_count; b++) {
+        count += func->blocks[b].count;
+    }
+    // Per instruction in block order: encoded length of non branches, and whether a branch needs rel32
+    int *lengths = malloc(sizeof(int) * (count + 1));
+    bool *wide = calloc(count + 1, sizeof(bool));
+    int *block_offsets = malloc(sizeof(int) * (func->block_count + 1));
+    if (lengths == NULL || wide == NULL || block_offsets == NULL) {
+        printf("Failed to allocate branch relaxation\n");
+        exit(1);
+    }
+    Encoding enc;
+    for (int b = 0, k = 0; b < func->block_count; b++) {
+        for (int i = 0; i < func->blocks[b].count; i++, k++) {
+            const MIR_Instruction *instr = &func->blocks[b].instructions[i];
+            if (instr->op == MIR_NOP) {
+                lengths[k] = 0;
+            } else if (instr->op == MIR_CALL || (instr->op == MIR_JMP && !is_branch(instr))) {
+                lengths[k] = 5;
+            } else if (!is_branch(instr)) {
+                encode_instruction(&enc, instr);
+                lengths[k] = enc.count;
+            }
+        }
+    }
+
+    // Padding depends on where the function starts in the text
+    const int start = obj->size;
+    bool changed = true;
+    while (changed) {
+        int offset = 0;
+        for (int b = 0, k = 0; b < func->block_count; b++) {
+            offset += align_padding(&func->blocks[b], start + offset);
+            block_offsets[b] = offset;
+            for (int i = 0; i < func->blocks[b].count; i++, k++) {
+                const MIR_Instruction *instr = &func->blocks[b].instructions[i];
+                offset += is_branch(instr) ? branch_length(instr->op, wide[k]) : lengths[k];
+            }
+        }
+        block_offsets[func->block_count] = offset;
+        // Offsets of blocks after a widened branch move, so widening continues until a pass finds nothing to widen
+        changed = false;
+        offset = 0;
+        for (int b = 0, k = 0; b < func->block_count; b++) {
+            offset = block_offsets[b];
+            for (int i = 0; i < func->blocks[b].count; i++, k++) {
+                const MIR_Instruction *instr = &func->blocks[b].instructions[i];
+                if (!is_branch(instr)) {
+                    offset += lengths[k];
+                    continue;
+                }
+                offset += branch_length(instr->op, wide[k]);
+                if (!wide[k] && !fits8(block_offsets[instr->operands[0].value] - offset)) {
+                    wide[k] = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    for (int b = 0, k = 0; b < func->block_count; b++) {
+        for (int padding = block_offsets[b] - (obj->size - start); padding > 0; padding -= MAX_NOP) {
+            const int length = padding < MAX_NOP ? padding : MAX_NOP;
+            enc.count = 0;
+            for (int i = 0; i < length; i++) {
+                put(&enc, NOPS[length][i]);
+            }
+            append_text(obj, &enc);
+        }
+        for (int i = 0; i < func->blocks[b].count; i++, k++) {
+            const MIR_Instruction *instr = &func->blocks[b].instructions[i];
+            if (instr->op == MIR_NOP) {
+                continue;
+            }
+            if (is_branch(instr)) {
+                const int end = obj->size - start + branch_length(instr->op, wide[k]);
+                encode_branch(&enc, instr, wide[k], block_offsets[instr->operands[0].value] - end);
+            } else if (instr->op == MIR_CALL || instr->op == MIR_JMP) {
+                enc.count = 0;
+                put(&enc, instr->op == MIR_CALL ? 0xE8 : 0xE9);
+                put32(&enc, 0);
+                add_reloc(obj, obj->size + 1, instr->operands[0].symbol);
+            } else {
+                encode_instruction(&enc, instr);
+            }
+            append_text(obj, &enc);
+        }
+    }
+    add_symbol(obj, func->blocks[0].name, start, obj->size - start, func->global);
+    free(lengths);
+    free(wide);
+    free(block_offsets);
+}
+
+int x86_find_symbol(const X86_Object *obj, const char *name) {
+    for (int s = 0; s < obj->symbol_count; s++) {
+        if (strcmp(obj->symbols[s].name, name) == 0) {
+            return s;
+        }
+    }
+    return -1;
+}
+
+void x86_resolve_object(X86_Object *obj) {
+    for (int r = 0; r < obj->reloc_count; r++) {
+        X86_Reloc *reloc = &obj->relocs[r];
+        const int s = x86_find_symbol(obj, reloc->symbol);
+        if (s == -1) {
+            continue;
+        }
+        // rel32 counts from the end of the field
+        const int displacement = obj->symbols[s].offset - (reloc->offset + 4);
+        const unsigned int bits = (unsigned int)displacement;
+        for (int i = 0; i < 4; i++) {
+            obj->text[reloc->offset + i] = (unsigned char)(bits >> (8 * i));
+        }
+        reloc->resolved = true;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef COMPILER_C_X86_ENCODE_H
+#define COMPILER_C_X86_ENCODE_H
+
+#include <stdbool.h>
+
+#include "mir.h"
+
+/*
+    x86-64 machine code for MIR functions.
+
+    Functions are encoded one after another into a single text section.
+    Branches start out with rel8 displacements and are widened to rel32 until every displacement fits,
+    A widened branch stays wide so this settles, even though alignment padding may shrink as code moves.
+    Aligned blocks are padded with the same NOPs gas uses.
+    Calls name a symbol and leave a relocation, x86_resolve_object() patches those defined in the object.
+*/
+
+typedef struct {
+    char name[MIR_NAME_SIZE];
+    int offset;
+    int size;
+    bool global;
+} X86_Symbol;
+
+typedef struct {
+    int offset; // Of the rel32 field, relative to the start of the text
+    char symbol[MIR_NAME_SIZE];
+    bool resolved;
+} X86_Reloc;
+
+typedef struct {
+    unsigned char *text;
+    int size;
+    int capacity;
+    X86_Symbol *symbols;
+    int symbol_count;
+    int symbol_capacity;
+    X86_Reloc *relocs;
+    int reloc_count;
+    int reloc_capacity;
+} X86_Object;
+
+X86_Object x86_new_object(void);
+void x86_free_object(X86_Object *obj);
+
+/*
+    Appends the machine code of `func`, adding a symbol named after its entry block.
+*/
+void x86_encode_function(X86_Object *obj, const MIR_Function *func);
+
+/*
+    Symbol index of `name`, -1 if the object does not define it.
+*/
+int x86_find_symbol(const X86_Object *obj, const char *name);
+
+/*
+    Patches calls to symbols defined in the object, leaving the rest for the linker.
+*/
+void x86_resolve_object(X86_Object *obj);
+
+#endif // COMPILER_C_X86_ENCODE_H
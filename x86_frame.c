@@ -0,0 +1,195 @@
+#include "x86_frame.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ir_cfg.h"
+
+static bool in_frame(const X86_RegAlloc *alloc, const int reg) {
+    const int location = alloc->location[reg];
+    return alloc->slot_offset[reg] != 0 || (location != X86_NO_REG && x86_is_callee_saved(location));
+}
+
+static bool needs_frame(const IR_Block *block, const X86_RegAlloc *alloc) {
+    const int term = ir_block_terminator(block);
+    for (int i = 0; i < (term == -1 ? block->count : term + 1); i++) {
+        const IR_Instruction *instr = &block->instructions[i];
+        const bool stack_args = instr->b > X86_ARG_REG_COUNT;
+        if (x86_is_call(instr->op) && (instr->op != IR_TAIL_CALL || stack_args)) {
+            return true;
+        }
+        if (instr->op == IR_PARAM && instr->a >= X86_ARG_REG_COUNT) {
+            return true;
+        }
+        int uses[IR_MAX_USES];
+        const int use_count = ir_instruction_uses(instr, uses);
+        const int def = ir_instruction_def(instr);
+        if (def != -1 && in_frame(alloc, def)) {
+            return true;
+        }
+        for (int u = 0; u < use_count; u++) {
+            if (in_frame(alloc, uses[u])) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/*
+    Marks the blocks between the save and restore blocks, returns a block the frame would leak into, or -1.
+*/
+static int mark_framed(const IR_CFG *cfg, bool *framed, const int save, const int restore) {
+    for (int b = 0; b < cfg->block_count; b++) {
+        framed[b] = cfg->blocks[b].rpo != -1 && ir_cfg_dominates(cfg, save, b) &&
+                    (restore == -1 || ir_cfg_post_dominates(cfg, restore, b));
+    }
+    for (int b = 0; b < cfg->block_count; b++) {
+        for (int s = 0; framed[b] && b != restore && s < cfg->blocks[b].succ_count; s++) {
+            if (!framed[cfg->blocks[b].succs[s]]) {
+                return cfg->blocks[b].succs[s];
+            }
+        }
+    }
+    return -1;
+}
+
+static void x86_shrink_wrap(X86_Frame *frame, const IR_Function *func, const X86_RegAlloc *alloc) {
+    if (!frame->frame_pointer && frame->saved_count == 0 && frame->size == 0) {
+        frame->save_block = -1;
+        return;
+    }
+    IR_CFG *cfg = ir_cfg_build(func);
+    int save = -1;
+    int restore = -1;
+    for (int b = 0; b < func->block_count; b++) {
+        if (cfg->blocks[b].rpo != -1 && needs_frame(&func->blocks[b], alloc)) {
+            restore = save == -1 ? b : ir_cfg_common_post_dominator(cfg, restore, b);
+            save = save == -1 ? b : ir_cfg_common_dominator(cfg, save, b);
+        }
+    }
+    frame->save_block = save;
+    if (save == -1) {
+        ir_cfg_free(cfg);
+        return;
+    }
+    // Each round only moves the save block up the dominator tree or the restore block up the post-dominator tree
+    while (true) {
+        // Neither may run more than once
+        while (cfg->blocks[save].loop != -1 && cfg->blocks[save].idom != -1) {
+            save = cfg->blocks[save].idom;
+        }
+        restore = ir_cfg_common_post_dominator(cfg, restore, save);
+        while (restore != -1 && cfg->blocks[restore].loop != -1) {
+            restore = cfg->blocks[restore].ipdom;
+        }
+        if (restore != -1) {
+            const IR_Block *block = &func->blocks[restore];
+            const int term = ir_block_terminator(block);
+            // The epilogue goes before the terminator, whose test may read what it restores
+            if (term != -1 && block->instructions[term].op == IR_BR_EQ) {
+                restore = cfg->blocks[restore].ipdom;
+                continue;
+            }
+            if (!ir_cfg_dominates(cfg, save, restore)) {
+                save = ir_cfg_common_dominator(cfg, save, restore);
+                continue;
+            }
+        }
+        const int leak = mark_framed(cfg, frame->framed, save, restore);
+        if (leak == -1) {
+            break;
+        }
+        const int wider = ir_cfg_common_dominator(cfg, save, leak);
+        if (wider == save) {
+            restore = -1;
+        }
+        save = wider;
+    }
+    frame->save_block = save;
+    frame->restore_block = -1;
+    // A returning block pops the frame on its way out like any other return
+    if (restore != -1 && cfg->blocks[restore].succ_count == 1) {
+        frame->restore_block = restore;
+    }
+    ir_cfg_free(cfg);
+}
+
+X86_Frame x86_frame_layout(const IR_Function *func, const X86_RegAlloc *alloc) {
+    X86_Frame frame = {false, false, {0}, 0, 0, 0, -1, calloc(func->block_count + 1, sizeof(bool))};
+    if (frame.framed == NULL) {
+        printf("Failed to allocate frame blocks\n");
+        exit(1);
+    }
+    bool leaf = true;
+    for (int b = 0; b < func->block_count; b++) {
+        for (int i = 0; i < func->blocks[b].count; i++) {
+            const IR_Instruction *instr = &func->blocks[b].instructions[i];
+            const bool passes = instr->op == IR_CALL || instr->op == IR_TAIL_CALL;
+            const bool stack_args = passes && instr->b > X86_ARG_REG_COUNT;
+            // A tail call passing everything in registers jumps away once the frame is gone
+            if (x86_is_call(instr->op) && (instr->op != IR_TAIL_CALL || stack_args)) {
+                leaf = false;
+            }
+            if (stack_args) {
+                frame.frame_pointer = true;
+            }
+        }
+    }
+    for (int reg = 0; reg < X86_REG_COUNT; reg++) {
+        if (alloc->used[reg] && x86_is_callee_saved(reg)) {
+            frame.saved[frame.saved_count++] = reg;
+        }
+    }
+    if (leaf) {
+        frame.red_zone = alloc->slots_size <= X86_RED_ZONE;
+        frame.size = frame.red_zone ? 0 : (alloc->slots_size + 15) & ~15;
+    } else {
+        // %rsp is 8 past a multiple of 16 on entry, after the return address was pushed
+        const int pushed = 8 + (frame.frame_pointer ? 8 : 0) + frame.saved_count * 8;
+        frame.size = ((pushed + alloc->slots_size + 15) & ~15) - pushed;
+    }
+    x86_shrink_wrap(&frame, func, alloc);
+    return frame;
+}
+
+void x86_frame_free(X86_Frame *frame) { free(frame->framed); }
+
+MIR_Operand x86_frame_slot(const X86_Frame *frame, const int offset) {
+    if (frame->frame_pointer) {
+        return mir_mem(MIR_RBP, -(frame->saved_count * 8 + offset));
+    }
+    return mir_mem(MIR_RSP, frame->size - offset);
+}
+
+MIR_Operand x86_frame_param(const X86_Frame *frame, const int index) {
+    if (frame->frame_pointer) {
+        return mir_mem(MIR_RBP, 16 + 8 * index);
+    }
+    return mir_mem(MIR_RSP, frame->size + frame->saved_count * 8 + 8 + 8 * index);
+}
+
+void x86_gen_prologue(MIR_Function *mir, const X86_Frame *frame) {
+    if (frame->frame_pointer) {
+        mir_emit(mir, MIR_PUSH, 8, 1, mir_preg(MIR_RBP));
+        mir_emit(mir, MIR_MOV, 8, 2, mir_preg(MIR_RSP), mir_preg(MIR_RBP));
+    }
+    for (int i = 0; i < frame->saved_count; i++) {
+        mir_emit(mir, MIR_PUSH, 8, 1, mir_preg(x86_preg(frame->saved[i])));
+    }
+    if (frame->size > 0) {
+        mir_emit(mir, MIR_SUB, 8, 2, mir_imm(frame->size), mir_preg(MIR_RSP));
+    }
+}
+
+void x86_gen_epilogue(MIR_Function *mir, const X86_Frame *frame) {
+    if (frame->size > 0) {
+        mir_emit(mir, MIR_ADD, 8, 2, mir_imm(frame->size), mir_preg(MIR_RSP));
+    }
+    for (int i = frame->saved_count - 1; i >= 0; i--) {
+        mir_emit(mir, MIR_POP, 8, 1, mir_preg(x86_preg(frame->saved[i])));
+    }
+    if (frame->frame_pointer) {
+        mir_emit(mir, MIR_POP, 8, 1, mir_preg(MIR_RBP));
+    }
+}
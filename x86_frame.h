@@ -0,0 +1,62 @@
+#ifndef COMPILER_C_X86_FRAME_H
+#define COMPILER_C_X86_FRAME_H
+
+#include <stdbool.h>
+
+#include "ir.h"
+#include "mir.h"
+#include "x86_regalloc.h"
+
+/*
+    Frame lowering, where a function keeps its stack slots and saved registers.
+
+    Callee saved registers the allocator used are pushed on entry, below them %rsp is lowered by the frame size.
+    Slots are addressed from %rsp, which only moves again for the duration of a call.
+    A call passing stack arguments pushes them one at a time, so those functions keep %rbp as a frame pointer.
+    A leaf function whose slots fit the 128 bytes below %rsp (the System V red zone) does not move %rsp at all.
+    Anything calling out lowers %rsp so it is 16 byte aligned at each call.
+
+    The frame is shrink-wrapped around the blocks that need it, those touching a slot or callee saved register,
+    Calling out or reading a stack parameter. The prologue goes at their nearest common dominator
+    And the epilogue at the end of their nearest common post-dominator, both moved out of any loop.
+    When that is only the exit, each return inside the frame pops it on its own way out.
+    Returns outside the frame, typically early exits, are a plain ret.
+*/
+
+// Arguments passed in registers, the rest are pushed
+#define X86_ARG_REG_COUNT 6
+// Bytes below %rsp that signal handlers leave alone
+#define X86_RED_ZONE 128
+
+typedef struct {
+    bool frame_pointer; // Slots and stack parameters addressed from %rbp
+    bool red_zone;      // Slots sit below %rsp, which the function never lowers
+    X86_Reg saved[X86_REG_COUNT]; // Callee saved registers in the order they are pushed
+    int saved_count;
+    int size; // Bytes %rsp is lowered by below the pushed registers
+    int save_block;    // IR block the prologue starts, -1 if nothing needs the frame
+    int restore_block; // IR block the epilogue ends, -1 if returns inside the frame pop it themselves
+    bool *framed;      // Whether each IR block runs with the frame set up
+} X86_Frame;
+
+X86_Frame x86_frame_layout(const IR_Function *func, const X86_RegAlloc *alloc);
+void x86_frame_free(X86_Frame *frame);
+
+/*
+    The stack slot `offset` bytes down from the top of the slot area, see X86_RegAlloc.slot_offset.
+*/
+MIR_Operand x86_frame_slot(const X86_Frame *frame, int offset);
+
+/*
+    Where stack argument `index` arrives above the return address, 0 being the first argument not in a register.
+*/
+MIR_Operand x86_frame_param(const X86_Frame *frame, int index);
+
+void x86_gen_prologue(MIR_Function *mir, const X86_Frame *frame);
+
+/*
+    Pops the frame and restores the callee saved registers, leaving the return address on top of the stack.
+*/
+void x86_gen_epilogue(MIR_Function *mir, const X86_Frame *frame);
+
+#endif // COMPILER_C_X86_FRAME_H
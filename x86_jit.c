@@ -0,0 +1,43 @@
+#include "x86_jit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+int x86_jit_run(const X86_Object *obj, const char *entry) {
+    for (int r = 0; r < obj->reloc_count; r++) {
+        if (!obj->relocs[r].resolved) {
+            printf("Undefined reference to %s\n", obj->relocs[r].symbol);
+            exit(1);
+        }
+    }
+    const int symbol = x86_find_symbol(obj, entry);
+    if (symbol == -1) {
+        printf("Undefined entry point %s\n", entry);
+        exit(1);
+    }
+
+    const long page_size = sysconf(_SC_PAGESIZE);
+    const size_t size = ((size_t)obj->size + page_size - 1) / page_size * page_size;
+    unsigned char *code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        printf("Failed to map JIT memory\n");
+        exit(1);
+    }
+    memcpy(code, obj->text, obj->size);
+    if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+        printf("Failed to make JIT memory executable\n");
+        exit(1);
+    }
+
+    // Object pointer to function pointer goes through memcpy, ISO C has no direct conversion
+    int (*function)(void);
+    unsigned char *address = code + obj->symbols[symbol].offset;
+    memcpy(&function, &address, sizeof(function));
+    const int result = function();
+
+    munmap(code, size);
+    return result;
+}
@@ -0,0 +1,19 @@
+#ifndef COMPILER_C_X86_JIT_H
+#define COMPILER_C_X86_JIT_H
+
+#include "x86_encode.h"
+
+/*
+    Runs machine code in the compiler's own process.
+
+    The text is copied into fresh mmap'd memory while it is writable, then flipped to read and execute with mprotect,
+    So no page is ever writable and executable at once.
+    Every call has to be resolved within the object, x86_encode_module() has already done so.
+*/
+
+/*
+    Calls `entry` as int entry(void) and returns its result, the memory is unmapped afterwards.
+*/
+int x86_jit_run(const X86_Object *obj, const char *entry);
+
+#endif // COMPILER_C_X86_JIT_H
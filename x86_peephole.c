@@ -0,0 +1,225 @@
+#include "x86_peephole.h"
+
+#include <stdio.h>
+
+// Cycles of jumps could otherwise keep retargeting each other
+#define X86_PEEPHOLE_MAX_PASSES 8
+
+typedef struct {
+    const char *name;
+    bool (*apply)(MIR_Function *func, int block, int i);
+    int hits;
+} X86_PeepholeRule;
+
+static MIR_Instruction *at(MIR_Function *func, const int block, const int i) {
+    MIR_Block *b = &func->blocks[block];
+    return i < b->count ? &b->instructions[i] : NULL;
+}
+
+// Jumps to a block, a jmp to a symbol leaves the function
+static bool is_jump(const MIR_Instruction *instr) {
+    return (instr->op == MIR_JMP || instr->op == MIR_JCC) && instr->operands[0].kind == MIR_LABEL;
+}
+
+/*
+    Whether `instr` is the last instruction of `block` and a jump to where execution would fall through anyway.
+*/
+static bool jumps_to_next(const MIR_Function *func, const int block, const int i) {
+    const MIR_Instruction *instr = &func->blocks[block].instructions[i];
+    const int target = instr->operands[0].value;
+    return mir_next(&func->blocks[block], i) == func->blocks[block].count && target > block &&
+           target <= mir_fallthrough(func, block);
+}
+
+/*
+    The block holding the first instruction executed after jumping to `block`, skipping empty blocks.
+*/
+static int jump_destination(const MIR_Function *func, const int block) {
+    return mir_next(&func->blocks[block], -1) < func->blocks[block].count ? block : mir_fallthrough(func, block);
+}
+
+/*
+    movl %ecx, -8(%rbp)        movl %ecx, -8(%rbp)
+    movl -8(%rbp), %esi  ->    movl %ecx, %esi
+    The memory operand still holds the value, so the second move reads it from the source of the first instead.
+*/
+static bool store_load(MIR_Function *func, const int block, const int i) {
+    const MIR_Instruction *store = at(func, block, i);
+    MIR_Instruction *load = at(func, block, mir_next(&func->blocks[block], i));
+    if (store->op != MIR_MOV || store->operands[1].kind != MIR_MEM || store->operands[0].kind == MIR_MEM ||
+        load == NULL || load->op != MIR_MOV || load->size != store->size ||
+        !mir_same_operand(&load->operands[0], &store->operands[1])) {
+        return false;
+    }
+    if (mir_same_operand(&load->operands[1], &store->operands[0])) {
+        load->op = MIR_NOP;
+    } else {
+        load->operands[0] = store->operands[0];
+    }
+    return true;
+}
+
+/*
+    Moves onto themselves, and a move straight back to where a value was just copied from.
+*/
+static bool redundant_move(MIR_Function *func, const int block, const int i) {
+    MIR_Instruction *move = at(func, block, i);
+    if (move->op != MIR_MOV) {
+        return false;
+    }
+    if (mir_same_operand(&move->operands[0], &move->operands[1])) {
+        move->op = MIR_NOP;
+        return true;
+    }
+    MIR_Instruction *back = at(func, block, mir_next(&func->blocks[block], i));
+    if (back != NULL && back->op == MIR_MOV && back->size == move->size &&
+        mir_same_operand(&back->operands[0], &move->operands[1]) &&
+        mir_same_operand(&back->operands[1], &move->operands[0])) {
+        back->op = MIR_NOP;
+        return true;
+    }
+    return false;
+}
+
+/*
+    A jump to the block that directly follows it.
+*/
+static bool jump_to_next(MIR_Function *func, const int block, const int i) {
+    MIR_Instruction *jump = at(func, block, i);
+    if (!is_jump(jump) || !jumps_to_next(func, block, i)) {
+        return false;
+    }
+    jump->op = MIR_NOP;
+    return true;
+}
+
+/*
+    A jump to a block whose first instruction is another jump goes straight to the final target.
+    Chains that do not end within a few hops are left alone, they are likely a cycle.
+*/
+static bool jump_chain(MIR_Function *func, const int block, const int i) {
+    MIR_Instruction *jump = at(func, block, i);
+    if (!is_jump(jump)) {
+        return false;
+    }
+    int target = jump->operands[0].value;
+    for (int hops = 0; hops < X86_PEEPHOLE_MAX_PASSES; hops++) {
+        const int destination = jump_destination(func, target);
+        const MIR_Instruction *next =
+            destination < func->block_count ? at(func, destination, mir_next(&func->blocks[destination], -1)) : NULL;
+        if (next == NULL || next->op != MIR_JMP || !is_jump(next)) {
+            if (target == jump->operands[0].value) {
+                return false;
+            }
+            jump->operands[0] = mir_label(target);
+            return true;
+        }
+        target = next->operands[0].value;
+    }
+    return false;
+}
+
+/*
+    jl block_2                 jge block_3
+    jmp block_3          ->
+  block_2:                   block_2:
+*/
+static bool jump_over_jump(MIR_Function *func, const int block, const int i) {
+    MIR_Instruction *branch = at(func, block, i);
+    const int j = mir_next(&func->blocks[block], i);
+    MIR_Instruction *jump = at(func, block, j);
+    if (branch->op != MIR_JCC || jump == NULL || jump->op != MIR_JMP || !is_jump(jump) || mir_next(&func->blocks[block], j) < func->blocks[block].count) {
+        return false;
+    }
+    const int target = branch->operands[0].value;
+    if (target <= block || target > mir_fallthrough(func, block)) {
+        return false;
+    }
+    branch->cond = mir_negate_cond(branch->cond);
+    branch->operands[0] = jump->operands[0];
+    jump->op = MIR_NOP;
+    return true;
+}
+
+/*
+    Instructions that set the zero flag from the value they leave in their last operand.
+    Shifts by zero leave the flags alone.
+*/
+static bool sets_zero_flag(const MIR_Instruction *instr) {
+    switch (instr->op) {
+    case MIR_ADD:
+    case MIR_SUB:
+    case MIR_XOR:
+    case MIR_INC:
+    case MIR_DEC:
+    case MIR_NEG:
+        return true;
+    case MIR_SHL:
+    case MIR_SAR:
+    case MIR_SHR:
+        return instr->operands[0].kind == MIR_IMM && instr->operands[0].value != 0;
+    default:
+        return false;
+    }
+}
+
+/*
+    subl %esi, %ecx            subl %esi, %ecx
+    testl %ecx, %ecx     ->
+    jne block_4                jne block_4
+    Likewise ahead of cmove or cmovne.
+    Only for jumps and moves on the zero flag, arithmetic leaves the carry and overflow flags different from testl.
+*/
+static bool redundant_test(MIR_Function *func, const int block, const int i) {
+    const MIR_Instruction *op = at(func, block, i);
+    const int j = mir_next(&func->blocks[block], i);
+    MIR_Instruction *test = at(func, block, j);
+    const MIR_Instruction *branch = test == NULL ? NULL : at(func, block, mir_next(&func->blocks[block], j));
+    if (!sets_zero_flag(op) || branch == NULL || test->op != MIR_TEST || test->size != op->size) {
+        return false;
+    }
+    const MIR_Operand *result = &op->operands[op->operand_count - 1];
+    if (result->kind != MIR_PREG || !mir_same_operand(&test->operands[0], result) ||
+        !mir_same_operand(&test->operands[1], result)) {
+        return false;
+    }
+    const bool on_flags = branch->op == MIR_JCC || branch->op == MIR_CMOV;
+    if (!on_flags || (branch->cond != MIR_COND_E && branch->cond != MIR_COND_NE)) {
+        return false;
+    }
+    test->op = MIR_NOP;
+    return true;
+}
+
+static X86_PeepholeRule RULES[] = {
+    {"store_load", store_load, 0},         {"redundant_move", redundant_move, 0}, {"jump_to_next", jump_to_next, 0},
+    {"jump_chain", jump_chain, 0},         {"jump_over_jump", jump_over_jump, 0}, {"redundant_test", redundant_test, 0},
+};
+
+#define RULE_COUNT (int)(sizeof(RULES) / sizeof(RULES[0]))
+
+void x86_peephole(MIR_Function *func) {
+    bool changed = true;
+    for (int pass = 0; changed && pass < X86_PEEPHOLE_MAX_PASSES; pass++) {
+        changed = false;
+        for (int b = 0; b < func->block_count; b++) {
+            const MIR_Block *block = &func->blocks[b];
+            for (int i = mir_next(block, -1); i < block->count; i = mir_next(block, i)) {
+                for (int r = 0; r < RULE_COUNT; r++) {
+                    if (RULES[r].apply(func, b, i)) {
+                        RULES[r].hits++;
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void x86_peephole_print_stats(void) {
+    printf("Peephole rule hits:\n");
+    for (int r = 0; r < RULE_COUNT; r++) {
+        printf("    %-16s %d\n", RULES[r].name, RULES[r].hits);
+    }
+}
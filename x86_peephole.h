@@ -0,0 +1,21 @@
+#ifndef COMPILER_C_X86_PEEPHOLE_H
+#define COMPILER_C_X86_PEEPHOLE_H
+
+#include "mir.h"
+
+/*
+    Peephole optimization over the MIR of a function.
+
+    Each rule in the table looks at a small window starting at one instruction and rewrites or erases instructions in it,
+    Rules are retried until none applies so that one rewrite can expose another.
+    Windows stay within a block, except where a rule looks at the block a jump lands on.
+*/
+
+void x86_peephole(MIR_Function *func);
+
+/*
+    Prints how many times each rule applied since the start of the program.
+*/
+void x86_peephole_print_stats(void);
+
+#endif // COMPILER_C_X86_PEEPHOLE_H
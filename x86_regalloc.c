@@ -0,0 +1,338 @@
+#include "x86_regalloc.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ir_cfg.h"
+
+static const MIR_PReg PREGS[X86_REG_COUNT] = {
+    MIR_RCX, MIR_RSI, MIR_RDI, MIR_R8, MIR_R9, MIR_R10, MIR_R11, MIR_RBX, MIR_R12, MIR_R13, MIR_R14, MIR_R15,
+};
+
+MIR_PReg x86_preg(const X86_Reg reg) { return PREGS[reg]; }
+bool x86_is_callee_saved(const X86_Reg reg) { return reg >= X86_RBX; }
+
+bool x86_is_call(const IR_OP op) { return op == IR_POW || op == IR_CALL || op == IR_TAIL_CALL; }
+
+typedef struct {
+    int reg;
+    int start; // Instruction k reads at 2k and writes at 2k + 1
+    int end;
+    float weight;
+    bool crosses_call;
+    int hint; // IR register whose physical register would save a move, -1 if none
+    int arrives_in; // X86_Reg a parameter is passed in, X86_NO_REG if none
+    int location;
+} Interval;
+
+static X86_RegAlloc *new_alloc(const IR_Function *func) {
+    X86_RegAlloc *alloc = calloc(1, sizeof(X86_RegAlloc));
+    if (alloc == NULL) {
+        printf("Failed to allocate register allocation\n");
+        exit(1);
+    }
+    alloc->location = malloc(sizeof(int) * (func->next_reg + 1));
+    alloc->slot_offset = malloc(sizeof(int) * (func->next_reg + 1));
+    if (alloc->location == NULL || alloc->slot_offset == NULL) {
+        printf("Failed to allocate register locations\n");
+        exit(1);
+    }
+    for (int r = 0; r < func->next_reg; r++) {
+        alloc->location[r] = X86_NO_REG;
+        alloc->slot_offset[r] = 0;
+    }
+    alloc->slots_size = 0;
+    return alloc;
+}
+
+void x86_free_alloc(X86_RegAlloc *alloc) {
+    free(alloc->location);
+    free(alloc->slot_offset);
+    free(alloc);
+}
+
+static void touch(Interval *interval, const int pos) {
+    if (pos < interval->start) {
+        interval->start = pos;
+    }
+    if (pos > interval->end) {
+        interval->end = pos;
+    }
+}
+
+static float loop_weight(const IR_CFG *cfg, const int block) {
+    const int loop = cfg->blocks[block].loop;
+    float weight = 1.0f;
+    for (int d = loop == -1 ? 0 : cfg->loops[loop].depth; d > 0; d--) {
+        weight *= 10.0f;
+    }
+    return weight;
+}
+
+/*
+    Instructions generated as `dst = a; dst op= b`, where `dst` sharing `a`'s register drops the copy.
+*/
+static bool is_two_address(const IR_OP op) {
+    switch (op) {
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_SHL:
+    case IR_SAR:
+    case IR_SHR:
+    case IR_STORE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*
+    The allocatable register argument `index` is passed in, %edx and the stack are not.
+*/
+static int param_reg(const int index) {
+    static const int ARG_REGS[] = {X86_RDI, X86_RSI, X86_NO_REG, X86_RCX, X86_R8, X86_R9};
+    return index < (int)(sizeof(ARG_REGS) / sizeof(ARG_REGS[0])) ? ARG_REGS[index] : X86_NO_REG;
+}
+
+/*
+    Reads made by the tile of root instruction `k`, a covered instruction's operands are read where its root is generated.
+*/
+static void touch_uses(Interval *intervals, const X86_Selection *sel, const int k, const int pos, const float weight) {
+    int uses[IR_MAX_USES];
+    const int use_count = ir_instruction_uses(sel->instructions[k], uses);
+    for (int u = 0; u < use_count; u++) {
+        if (sel->child[u][k] != -1) {
+            touch_uses(intervals, sel, sel->child[u][k], pos, weight);
+            continue;
+        }
+        touch(&intervals[uses[u]], pos);
+        intervals[uses[u]].weight += weight;
+    }
+}
+
+/*
+    One interval per IR register, from the first to the last position it is live at in block order.
+    Values covered by their reader's tile get none.
+*/
+static Interval *build_intervals(const IR_Function *func, const X86_Selection *sel) {
+    Interval *intervals = malloc(sizeof(Interval) * (func->next_reg + 1));
+    int *calls = NULL;
+    int call_count = 0;
+    int call_capacity = 0;
+    if (intervals == NULL) {
+        printf("Failed to allocate live intervals\n");
+        exit(1);
+    }
+    for (int r = 0; r < func->next_reg; r++) {
+        intervals[r] = (Interval){r, INT_MAX, -1, 0.0f, false, -1, X86_NO_REG, X86_NO_REG};
+    }
+
+    IR_CFG *cfg = ir_cfg_build(func);
+    IR_Liveness *live = ir_liveness_build(func, cfg);
+    int k = 0;
+    for (int b = 0; b < func->block_count; b++) {
+        const IR_Block *block = &func->blocks[b];
+        const float weight = loop_weight(cfg, b);
+        const int block_start = 2 * k;
+        for (int r = 0; r < func->next_reg; r++) {
+            if (ir_live_in(live, b, r)) {
+                touch(&intervals[r], block_start);
+            }
+        }
+        for (int i = 0; i < block->count; i++, k++) {
+            const IR_Instruction *instr = &block->instructions[i];
+            if (sel->parent[k] != -1) {
+                continue;
+            }
+            touch_uses(intervals, sel, k, 2 * k, weight);
+            const int def = ir_instruction_def(instr);
+            if (def != -1) {
+                // Parameters are all moved in by the first IR_PARAM, so they have to be live together from there
+                touch(&intervals[def], instr->op == IR_PARAM ? 1 : 2 * k + 1);
+                intervals[def].weight += weight;
+                if (intervals[def].hint == -1 && is_two_address(instr->op) && sel->child[0][k] == -1) {
+                    intervals[def].hint = instr->a;
+                }
+                if (instr->op == IR_PARAM) {
+                    intervals[def].arrives_in = param_reg(instr->a);
+                }
+            }
+            if (x86_is_call(instr->op)) {
+                if (call_count >= call_capacity) {
+                    call_capacity = call_capacity == 0 ? 4 : call_capacity * 2;
+                    calls = realloc(calls, sizeof(int) * call_capacity);
+                    if (calls == NULL) {
+                        printf("Failed to allocate call positions\n");
+                        exit(1);
+                    }
+                }
+                calls[call_count++] = 2 * k;
+            }
+        }
+        const int block_end = block->count == 0 ? block_start : 2 * k - 1;
+        for (int r = 0; r < func->next_reg; r++) {
+            if (ir_live_out(live, b, r)) {
+                touch(&intervals[r], block_end);
+            }
+        }
+    }
+    ir_liveness_free(live);
+    ir_cfg_free(cfg);
+
+    for (int r = 0; r < func->next_reg; r++) {
+        Interval *interval = &intervals[r];
+        // Values only read by the call or written by it do not need to survive it
+        for (int c = 0; c < call_count; c++) {
+            if (interval->start < calls[c] && interval->end > calls[c] + 1) {
+                interval->crosses_call = true;
+            }
+        }
+        if (interval->end >= interval->start) {
+            interval->weight /= (float)(interval->end - interval->start + 1);
+        }
+    }
+    free(calls);
+    return intervals;
+}
+
+static int compare_start(const void *a, const void *b) {
+    const Interval *x = *(Interval *const *)a;
+    const Interval *y = *(Interval *const *)b;
+    if (x->start != y->start) {
+        return x->start < y->start ? -1 : 1;
+    }
+    // Parameters take the register they arrive in before the others starting with them pick one
+    if ((x->arrives_in == X86_NO_REG) != (y->arrives_in == X86_NO_REG)) {
+        return x->arrives_in != X86_NO_REG ? -1 : 1;
+    }
+    return x->reg - y->reg;
+}
+
+/*
+    Intervals in order of their start, leaving out registers that never appear.
+*/
+static Interval **sort_intervals(const IR_Function *func, Interval *intervals, int *count) {
+    Interval **order = malloc(sizeof(Interval *) * (func->next_reg + 1));
+    if (order == NULL) {
+        printf("Failed to allocate interval order\n");
+        exit(1);
+    }
+    *count = 0;
+    for (int r = 0; r < func->next_reg; r++) {
+        if (intervals[r].end >= 0) {
+            order[(*count)++] = &intervals[r];
+        }
+    }
+    qsort(order, *count, sizeof(Interval *), compare_start);
+    return order;
+}
+
+/*
+    Colors the intervals left in memory onto 4 byte slots, two intervals share a slot when they do not overlap.
+    Intervals are interval graphs so taking the first free slot in order of start uses the fewest slots.
+    Registers that never appear get no slot.
+*/
+static void assign_slots(X86_RegAlloc *alloc, Interval **order, const int count) {
+    int *slot_end = malloc(sizeof(int) * (count + 1)); // Last position of each slot's current occupant
+    if (slot_end == NULL) {
+        printf("Failed to allocate stack slots\n");
+        exit(1);
+    }
+    int slot_count = 0;
+    for (int i = 0; i < count; i++) {
+        const Interval *interval = order[i];
+        if (interval->location != X86_NO_REG) {
+            continue;
+        }
+        int slot = 0;
+        while (slot < slot_count && slot_end[slot] >= interval->start) {
+            slot++;
+        }
+        if (slot == slot_count) {
+            slot_count++;
+        }
+        slot_end[slot] = interval->end;
+        alloc->slot_offset[interval->reg] = (slot + 1) * 4;
+    }
+    alloc->slots_size = slot_count * 4;
+    free(slot_end);
+}
+
+X86_RegAlloc *x86_alloc_stack(const IR_Function *func, const X86_Selection *sel) {
+    X86_RegAlloc *alloc = new_alloc(func);
+    Interval *intervals = build_intervals(func, sel);
+    int count;
+    Interval **order = sort_intervals(func, intervals, &count);
+    assign_slots(alloc, order, count);
+    free(order);
+    free(intervals);
+    return alloc;
+}
+
+static bool allowed(const Interval *interval, const X86_Reg reg) {
+    return !interval->crosses_call || x86_is_callee_saved(reg);
+}
+
+X86_RegAlloc *x86_alloc_registers(const IR_Function *func, const X86_Selection *sel) {
+    X86_RegAlloc *alloc = new_alloc(func);
+    Interval *intervals = build_intervals(func, sel);
+    int count;
+    Interval **order = sort_intervals(func, intervals, &count);
+
+    // The interval occupying each register, caller saved registers are tried first as they cost no save
+    Interval *active[X86_REG_COUNT] = {0};
+    for (int i = 0; i < count; i++) {
+        Interval *current = order[i];
+        for (int reg = 0; reg < X86_REG_COUNT; reg++) {
+            if (active[reg] != NULL && active[reg]->end < current->start) {
+                active[reg] = NULL;
+            }
+        }
+        int chosen = X86_NO_REG;
+        if (current->hint != -1) {
+            const int hinted = intervals[current->hint].location;
+            if (hinted != X86_NO_REG && active[hinted] == NULL && allowed(current, hinted)) {
+                chosen = hinted;
+            }
+        }
+        // Leaving a parameter where it arrives saves moving it out
+        const int arrived = current->arrives_in;
+        if (chosen == X86_NO_REG && arrived != X86_NO_REG && active[arrived] == NULL && allowed(current, arrived)) {
+            chosen = arrived;
+        }
+        for (int reg = 0; reg < X86_REG_COUNT && chosen == X86_NO_REG; reg++) {
+            if (active[reg] == NULL && allowed(current, reg)) {
+                chosen = reg;
+            }
+        }
+        if (chosen == X86_NO_REG) {
+            // Spill whichever of the current and the conflicting intervals is cheapest to keep in memory
+            int cheapest = X86_NO_REG;
+            for (int reg = 0; reg < X86_REG_COUNT; reg++) {
+                if (allowed(current, reg) && (cheapest == X86_NO_REG || active[reg]->weight < active[cheapest]->weight)) {
+                    cheapest = reg;
+                }
+            }
+            if (cheapest != X86_NO_REG && active[cheapest]->weight < current->weight) {
+                active[cheapest]->location = X86_NO_REG;
+                chosen = cheapest;
+            }
+            alloc->spill_count++;
+        }
+        if (chosen != X86_NO_REG) {
+            current->location = chosen;
+            active[chosen] = current;
+            alloc->used[chosen] = true;
+        }
+    }
+
+    for (int r = 0; r < func->next_reg; r++) {
+        alloc->location[r] = intervals[r].location;
+    }
+    assign_slots(alloc, order, count);
+    free(order);
+    free(intervals);
+    return alloc;
+}
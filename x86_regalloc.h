@@ -0,0 +1,64 @@
+#ifndef COMPILER_C_X86_REGALLOC_H
+#define COMPILER_C_X86_REGALLOC_H
+
+#include <stdbool.h>
+
+#include "ir.h"
+#include "mir.h"
+#include "x86_select.h"
+
+/*
+    Linear scan register allocation (Poletto and Sarkar) for x86-64.
+
+    Every IR register gets one live interval spanning all of its uses across the function,
+    Intervals are handed registers in order of their start, and when none is free
+    the interval with the lowest spill weight (uses weighted by loop depth over its length) lives in its stack slot instead.
+
+    %eax and %edx are never handed out, instruction templates use them to reload spilled values
+    and for the fixed operands of idiv and one operand imul.
+*/
+
+typedef enum {
+    // Caller saved
+    X86_RCX,
+    X86_RSI,
+    X86_RDI,
+    X86_R8,
+    X86_R9,
+    X86_R10,
+    X86_R11,
+    // Callee saved
+    X86_RBX,
+    X86_R12,
+    X86_R13,
+    X86_R14,
+    X86_R15,
+    X86_REG_COUNT
+} X86_Reg;
+
+#define X86_NO_REG (-1)
+
+typedef struct {
+    int *location;    // X86_Reg holding each IR register, X86_NO_REG if it lives in its stack slot
+    int *slot_offset; // Offset down from the top of the frame's slots, of each IR register left in memory
+    int slots_size;   // Bytes used by the stack slots, slots are shared by registers which are never live at once
+    bool used[X86_REG_COUNT];
+    int spill_count; // Intervals which did not get a register
+} X86_RegAlloc;
+
+MIR_PReg x86_preg(X86_Reg reg);
+bool x86_is_callee_saved(X86_Reg reg);
+
+/*
+    Instructions that call out, clobbering every caller saved register.
+*/
+bool x86_is_call(IR_OP op);
+
+/*
+    Every IR register in a stack slot, used without -O1.
+*/
+X86_RegAlloc *x86_alloc_stack(const IR_Function *func, const X86_Selection *sel);
+X86_RegAlloc *x86_alloc_registers(const IR_Function *func, const X86_Selection *sel);
+void x86_free_alloc(X86_RegAlloc *alloc);
+
+#endif // COMPILER_C_X86_REGALLOC_H
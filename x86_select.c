@@ -0,0 +1,182 @@
+#include "x86_select.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ir_cfg.h"
+
+/*
+    Operands with an immediate form, `slot` in `ir_instruction_uses()` order.
+    idivl and one operand imull only take registers or memory, the templates load the other operand into %eax.
+*/
+static bool takes_immediate(const X86_Selection *sel, const int reader, const int slot) {
+    switch (sel->instructions[reader]->op) {
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_SHL:
+    case IR_SAR:
+    case IR_SHR:
+    case IR_LEA:
+    case IR_POW:
+    case IR_CMP_EQ:
+    case IR_CMP_NE:
+    case IR_CMP_LT:
+    case IR_CMP_LE:
+    case IR_CMP_GT:
+    case IR_CMP_GE:
+    case IR_STORE:
+    case IR_RET:
+    case IR_ARG:
+        return true;
+    case IR_DIV:
+        return slot == 0;
+    case IR_MULH:
+        return sel->child[1 - slot][reader] == -1;
+    default:
+        return false;
+    }
+}
+
+static bool can_cover(const X86_Selection *sel, const int def, const int reader, const int slot) {
+    const IR_Instruction *instr = sel->instructions[def];
+    const IR_OP reader_op = sel->instructions[reader]->op;
+    switch (instr->op) {
+    case IR_LOAD:
+        // Readers covered themselves are generated elsewhere, except compares which the branch generates in place
+        return (sel->parent[reader] == -1 || ir_is_compare(reader_op)) && takes_immediate(sel, reader, slot);
+    case IR_SHL:
+        return reader_op == IR_ADD && instr->b >= 1 && instr->b <= 3 && sel->child[1 - slot][reader] == -1;
+    case IR_CMP_EQ:
+    case IR_CMP_NE:
+    case IR_CMP_LT:
+    case IR_CMP_LE:
+    case IR_CMP_GT:
+    case IR_CMP_GE:
+        return reader_op == IR_BR_EQ || (reader_op == IR_SELECT && slot == 0);
+    default:
+        return false;
+    }
+}
+
+/*
+    The only instruction reading the value written at `def`, -1 if it is read more than once,
+    Outside the block, or the operands it was computed from change before the read.
+    `slot` is set to the operand the reader reads it as.
+*/
+static int single_reader(const IR_Function *func, const IR_Liveness *live, const X86_Selection *sel, const int block,
+                         const int def, int *slot) {
+    const IR_Instruction *instr = sel->instructions[def];
+    int operands[IR_MAX_USES];
+    const int operand_count = ir_instruction_uses(instr, operands);
+    const int end = sel->block_start[block] + func->blocks[block].count;
+    int reader = -1;
+    *slot = -1;
+    for (int k = def + 1; k < end; k++) {
+        int uses[IR_MAX_USES];
+        const int use_count = ir_instruction_uses(sel->instructions[k], uses);
+        for (int u = 0; u < use_count; u++) {
+            if (uses[u] != instr->dst) {
+                continue;
+            }
+            if (reader != -1) {
+                return -1;
+            }
+            reader = k;
+            *slot = u;
+        }
+        const int redefined = ir_instruction_def(sel->instructions[k]);
+        if (redefined == instr->dst) {
+            return reader;
+        }
+        if (ir_is_terminator(sel->instructions[k]->op)) {
+            break;
+        }
+        for (int o = 0; o < operand_count; o++) {
+            if (reader == -1 && redefined == operands[o]) {
+                return -1;
+            }
+        }
+    }
+    if (ir_live_out(live, block, instr->dst)) {
+        return -1;
+    }
+    return reader;
+}
+
+static void cover_pass(const IR_Function *func, const IR_Liveness *live, X86_Selection *sel, const bool constants) {
+    for (int b = 0; b < func->block_count; b++) {
+        const int start = sel->block_start[b];
+        for (int k = start; k < start + func->blocks[b].count; k++) {
+            const IR_OP op = sel->instructions[k]->op;
+            if ((op == IR_LOAD) != constants || sel->parent[k] != -1) {
+                continue;
+            }
+            int slot = -1;
+            const int reader = single_reader(func, live, sel, b, k, &slot);
+            if (reader != -1 && can_cover(sel, k, reader, slot)) {
+                sel->parent[k] = reader;
+                sel->child[slot][reader] = k;
+            }
+            if (ir_is_terminator(op)) {
+                break;
+            }
+        }
+    }
+}
+
+X86_Selection *x86_select(const IR_Function *func) {
+    X86_Selection *sel = malloc(sizeof(X86_Selection));
+    if (sel == NULL) {
+        printf("Failed to allocate instruction selection\n");
+        exit(1);
+    }
+    sel->count = 0;
+    for (int b = 0; b < func->block_count; b++) {
+        sel->count += func->blocks[b].count;
+    }
+    sel->instructions = malloc(sizeof(IR_Instruction *) * (sel->count + 1));
+    sel->block_start = malloc(sizeof(int) * (func->block_count + 1));
+    sel->parent = malloc(sizeof(int) * (sel->count + 1));
+    if (sel->instructions == NULL || sel->block_start == NULL || sel->parent == NULL) {
+        printf("Failed to allocate instruction selection\n");
+        exit(1);
+    }
+    for (int slot = 0; slot < IR_MAX_USES; slot++) {
+        sel->child[slot] = malloc(sizeof(int) * (sel->count + 1));
+        if (sel->child[slot] == NULL) {
+            printf("Failed to allocate instruction selection\n");
+            exit(1);
+        }
+    }
+    int k = 0;
+    for (int b = 0; b < func->block_count; b++) {
+        sel->block_start[b] = k;
+        for (int i = 0; i < func->blocks[b].count; i++, k++) {
+            sel->instructions[k] = &func->blocks[b].instructions[i];
+            sel->parent[k] = -1;
+            for (int slot = 0; slot < IR_MAX_USES; slot++) {
+                sel->child[slot][k] = -1;
+            }
+        }
+    }
+
+    IR_CFG *cfg = ir_cfg_build(func);
+    IR_Liveness *live = ir_liveness_build(func, cfg);
+    // Shifts and compares first, so constants know whether their reader is generated on its own
+    cover_pass(func, live, sel, false);
+    cover_pass(func, live, sel, true);
+    ir_liveness_free(live);
+    ir_cfg_free(cfg);
+    return sel;
+}
+
+void x86_free_selection(X86_Selection *sel) {
+    free(sel->instructions);
+    free(sel->block_start);
+    free(sel->parent);
+    for (int slot = 0; slot < IR_MAX_USES; slot++) {
+        free(sel->child[slot]);
+    }
+    free(sel);
+}
@@ -0,0 +1,32 @@
+#ifndef COMPILER_C_X86_SELECT_H
+#define COMPILER_C_X86_SELECT_H
+
+#include <stdio.h>
+
+#include "ir.h"
+
+/*
+    Tree tiling instruction selection.
+
+    A value read exactly once, by a later instruction of the same block, can be covered by its reader's tile
+    instead of being generated on its own:
+    Constants become immediate operands, `a + (x << 1..3)` becomes one lea,
+    and a comparison read by a branch or select becomes cmpl and jcc or cmovcc.
+
+    Covering happens before register allocation, so covered values never need a register.
+    Which tile generates each remaining instruction is picked from a cost table once locations are known.
+*/
+
+typedef struct {
+    int count;
+    const IR_Instruction **instructions; // Numbered in block order
+    int *block_start;                    // Number of each block's first instruction
+    int *parent;                         // The instruction whose tile covers each instruction, -1 if it is generated on its own
+    // The covered instruction producing each operand, in `ir_instruction_uses()` order, -1 if none
+    int *child[IR_MAX_USES];
+} X86_Selection;
+
+X86_Selection *x86_select(const IR_Function *func);
+void x86_free_selection(X86_Selection *sel);
+
+#endif // COMPILER_C_X86_SELECT_H